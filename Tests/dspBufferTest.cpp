@@ -7,6 +7,8 @@
 #include "catch.hpp"
 #include "testUtils.h"
 #include "MLDSPBuffer.h"
+#include "MLDSPFilters.h"
+#include "MLDSPMirroredBuffer.h"
 #include "MLDSPUtils.h"
 #include "MLDSPFunctional.h"
 
@@ -154,7 +156,7 @@ TEST_CASE("madronalib/core/dspbuffer/threads", "[dspbuffer][threads]")
 TEST_CASE("madronalib/core/dspbuffer/overlap", "[dspbuffer][overlap]")
 {
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kFloatsPerDSPVector * 4);
 
   DSPVector outputVec, outputVec2;
   int overlap = kFloatsPerDSPVector / 2;
@@ -186,7 +188,7 @@ TEST_CASE("madronalib/core/dspbuffer/overlap", "[dspbuffer][overlap]")
 TEST_CASE("madronalib/core/dspbuffer/vectors", "[dspbuffer][vectors]")
 {
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kFloatsPerDSPVector * 4);
 
   constexpr size_t kRows = 3;
   DSPVectorArray<kRows> inputVec, outputVec;
@@ -211,14 +213,16 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
 {
   // buffer should be next larger power-of-two size
   DSPBuffer buf;
-  buf.resize(256);
+  const int bufSize = kFloatsPerDSPVector * 4;
+  buf.resize(bufSize);
 
   // write to near end
+  const int nearEnd = bufSize - 53;
   std::vector<float> nines;
-  nines.resize(256);
+  nines.resize(bufSize);
   std::fill(nines.begin(), nines.end(), 9.f);
-  buf.write(nines.data(), 203);
-  buf.read(nines.data(), 203);
+  buf.write(nines.data(), nearEnd);
+  buf.read(nines.data(), nearEnd);
 
   // write DSPVectors with wrap
   DSPVector v1(columnIndex());
@@ -227,7 +231,7 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   buf.write(v1);
 
   // write one more sample
-  float f{128};
+  float f = kFloatsPerDSPVector * 2;
   buf.write(&f, 1);
 
   // peek data regions to buffer
@@ -235,8 +239,8 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   floatVec.resize(200);
   buf.peekMostRecent(floatVec.data(), 20);
 
-  REQUIRE(floatVec[0] == 109);
-  REQUIRE(floatVec[19] == 128);
+  REQUIRE(floatVec[0] == kFloatsPerDSPVector * 2 - 19);
+  REQUIRE(floatVec[19] == kFloatsPerDSPVector * 2);
 }
 
 TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
@@ -248,4 +252,125 @@ TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
   DSPVectorDynamic dv;
 }
 
+TEST_CASE("madronalib/core/dspbuffer/process", "[dspbuffer][process]")
+{
+  // pass a ramp through a VectorProcessBuffer in chunks of sizes unrelated
+  // to the DSP vector size. The output should be the input delayed by the
+  // reported latency.
+  const int maxFrames = kFloatsPerDSPVector * 4;
+  VectorProcessBuffer processBuffer(1, 1, maxFrames);
+  auto passThrough = [](MainInputs ins, MainOutputs outs, void*) { outs[0] = ins[0]; };
+
+  std::vector<int> chunkSizes{37, 5, maxFrames, 1, kFloatsPerDSPVector + 3};
+  std::vector<float> inputs, outputs, chunkOut(maxFrames);
+  float ramp{1.f};
+  for (int i = 0; i < 20; ++i)
+  {
+    int frames = chunkSizes[i % chunkSizes.size()];
+    std::vector<float> chunkIn(frames);
+    for (auto& f : chunkIn)
+    {
+      f = ramp++;
+    }
+    const float* ins[1]{chunkIn.data()};
+    float* outs[1]{chunkOut.data()};
+    processBuffer.process(ins, outs, frames, passThrough);
+    outputs.insert(outputs.end(), chunkOut.begin(), chunkOut.begin() + frames);
+  }
+
+  size_t latency = 0;
+  while ((latency < outputs.size()) && (outputs[latency] == 0.f)) latency++;
+
+  bool delayedRamp{latency == VectorProcessBuffer::getLatency()};
+  for (size_t i = latency; i < outputs.size(); ++i)
+  {
+    delayedRamp &= (outputs[i] == i - latency + 1);
+  }
+  REQUIRE(delayedRamp);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/mirrored", "[dspbuffer][mirrored]")
+{
+  // the mirrored copy should alias the first.
+  MirroredBuffer<float> mem;
+  size_t memSize = mem.resize(64);
+  REQUIRE(memSize >= 64);
+  REQUIRE(mem.data()[memSize - 1] == 0.f);
+  if (mem.isMirrored())
+  {
+    mem.data()[3] = 3.f;
+    mem.data()[memSize + 5] = 5.f;
+    REQUIRE(mem.data()[memSize + 3] == 3.f);
+    REQUIRE(mem.data()[5] == 5.f);
+  }
+
+  // a copy should have its own memory.
+  MirroredBuffer<float> memCopy(mem);
+  memCopy.data()[3] = 7.f;
+  REQUIRE(memCopy.size() == memSize);
+  REQUIRE(mem.data()[3] != 7.f);
+
+  // if allocation fails, the previous memory should be kept.
+  float* oldData = mem.data();
+  REQUIRE(mem.resize(size_t(1) << 60) == 0);
+  REQUIRE(mem.size() == memSize);
+  REQUIRE(mem.data() == oldData);
+
+  // the capacity of a DSPBuffer doesn't depend on its memory. Pass a ramp
+  // through in chunks unrelated to the size, wrapping many times.
+  DSPBuffer buf;
+  REQUIRE(buf.resize(300) == 512);
+  std::vector<float> in(97), out(97);
+  float ramp{0.f};
+  bool rampOK{true};
+  for (int i = 0; i < 100; ++i)
+  {
+    for (auto& f : in)
+    {
+      f = ramp++;
+    }
+    buf.write(in.data(), in.size());
+    buf.write(in.data(), in.size());
+    REQUIRE(buf.getWriteAvailable() == 512 - 2 * in.size());
+    buf.read(out.data(), out.size());
+    rampOK &= (out == in);
+    buf.read(out.data(), out.size());
+  }
+  REQUIRE(rampOK);
+
+  // an IntegerDelay should give the input delayed, through many wraps.
+  constexpr int kDelay = 300;
+  IntegerDelay delay(kDelay);
+  DSPVector x{columnIndex()};
+  bool delayOK{true};
+  for (int i = 0; i < 100; ++i)
+  {
+    DSPVector y = delay(x + DSPVector(i * kFloatsPerDSPVector));
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      int t = i * kFloatsPerDSPVector + n;
+      delayOK &= (y[n] == ((t >= kDelay) ? t - kDelay : 0.f));
+    }
+  }
+  REQUIRE(delayOK);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dspbuffer/mirrored_timing", "[dspbuffer][mirrored][.timing]")
+{
+  // time an IntegerDelay, which uses mirrored memory where the platform allows.
+  MirroredBuffer<float> mem;
+  mem.resize(64);
+  IntegerDelay delay(300);
+  DSPVector x{columnIndex()};
+  auto delayFn = [&]() { return delay(x); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto delayTime = testUtils::timeIterationsInThread<DSPVector>(delayFn);
+#else
+  auto delayTime = testUtils::timeIterations<DSPVector>(delayFn);
+#endif
+  std::cout << "IntegerDelay, mirrored " << mem.isMirrored() << ", ns per vector: "
+            << delayTime.ns << "\n";
+}
+
 }  // namespace dspBufferTest
@@ -0,0 +1,163 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <vector>
+
+#include "catch.hpp"
+#include "testUtils.h"
+#include "MLDSPConvolver.h"
+#include "MLDSPFunctional.h"
+#include "MLDSPUtils.h"
+
+using namespace ml;
+using namespace testUtils;
+
+namespace
+{
+// a decaying noise impulse response of the given length.
+Sample makeImpulse(size_t frames, RandomScalarSource& noise)
+{
+  Sample ir;
+  ir.sampleRate = 48000;
+  resize(ir, frames);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    ir[i] = noise.getFloat() * expf(-4.f * i / frames);
+  }
+  return ir;
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/convolver", "[convolver]")
+{
+  RandomScalarSource noise;
+
+  // long enough to use all three stages.
+  constexpr size_t kImpulseFrames = 10000;
+  constexpr int kFrames = 16384;
+  Sample ir = makeImpulse(kImpulseFrames, noise);
+  std::vector<float> input(kFrames);
+  for (auto& x : input)
+  {
+    x = noise.getFloat();
+  }
+
+  // direct convolution, for reference.
+  std::vector<float> expected(kFrames);
+  float maxExpected{0.f};
+  for (int t = 0; t < kFrames; ++t)
+  {
+    double sum{0.};
+    for (int n = 0; n < std::min(t + 1, (int)kImpulseFrames); ++n)
+    {
+      sum += ir[n] * input[t - n];
+    }
+    expected[t] = sum;
+    maxExpected = std::max(maxExpected, fabsf(expected[t]));
+  }
+
+  // run the convolver from a VectorProcessBuffer in chunks of varying sizes,
+  // with and without the worker thread.
+  for (bool useWorker : {false, true})
+  {
+    Convolver convolver;
+    convolver.setImpulse(ir, 0, useWorker);
+
+    constexpr int kMaxChunk = 300;
+    VectorProcessBuffer processBuffer(1, 1, kMaxChunk);
+    auto processFn = [&](MainInputs ins, MainOutputs outs, void*) {
+      outs[0] = convolver(ins[0]);
+    };
+
+    std::vector<float> output(kFrames);
+    int chunkSizes[] = {kMaxChunk, 1, 64, 17, 255};
+    int chunk{0};
+    for (int t = 0; t < kFrames;)
+    {
+      int frames = std::min(chunkSizes[chunk++ % 5], kFrames - t);
+      const float* ins[1] = {input.data() + t};
+      float* outs[1] = {output.data() + t};
+      processBuffer.process(ins, outs, frames, processFn);
+      t += frames;
+    }
+
+    // compare, allowing for the latency of the VectorProcessBuffer.
+    size_t latency = VectorProcessBuffer::getLatency() + Convolver::getLatency();
+    float maxError{0.f};
+    for (int t = latency; t < kFrames; ++t)
+    {
+      maxError = std::max(maxError, fabsf(output[t] - expected[t - latency]));
+    }
+    REQUIRE(maxError / maxExpected < 1e-5f);
+  }
+}
+
+TEST_CASE("madronalib/core/convolver/reset", "[convolver]")
+{
+  RandomScalarSource noise;
+  Sample ir = makeImpulse(10000, noise);
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+
+  // change the impulse response mid-stream, just after jobs are posted to the
+  // worker, then run without the worker. The output should match that of a
+  // new Convolver, before and after clearing.
+  for (int vectors : {8, 9, 64, 65})
+  {
+    Convolver convolver;
+    convolver.setImpulse(ir, 0, true);
+    for (int i = 0; i < vectors; ++i)
+    {
+      convolver(input);
+    }
+    convolver.setImpulse(ir, 0, false);
+
+    Convolver reference;
+    reference.setImpulse(ir, 0, false);
+    float maxDifference{0.f};
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      for (int i = 0; i < 200; ++i)
+      {
+        DSPVector difference = convolver(input) - reference(input);
+        for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+        {
+          maxDifference = std::max(maxDifference, fabsf(difference[n]));
+        }
+      }
+      convolver.clear();
+      reference.clear();
+    }
+    REQUIRE(maxDifference == 0.f);
+  }
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/convolver/timing", "[convolver][.timing]")
+{
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+
+  // time the total work per DSPVector for impulse responses of 1, 2, 4 and 8
+  // seconds, with all of the stages computed on the calling thread.
+  for (int seconds : {1, 2, 4, 8})
+  {
+    Sample ir = makeImpulse(48000 * seconds, noise);
+    Convolver convolver;
+    convolver.setImpulse(ir, 0, false);
+    auto convolveFn = [&]() { return convolver(input); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+    auto totalTime = timeIterationsInThread<DSPVector>(convolveFn);
+#else
+    auto totalTime = timeIterations<DSPVector>(convolveFn);
+#endif
+
+    // the fraction of one core used per second of impulse response at 48kHz.
+    double nsPerSecond = totalTime.ns * 48000. / kFloatsPerDSPVector;
+    double cpuPerImpulseSecond = nsPerSecond * 1e-9 / seconds;
+    std::cout << seconds << "s impulse: " << totalTime.ns << " ns per vector, "
+              << cpuPerImpulseSecond * 100. << "% CPU per impulse second\n";
+  }
+}
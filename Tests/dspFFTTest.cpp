@@ -0,0 +1,236 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <cmath>
+#include <vector>
+
+#include "catch.hpp"
+#include "testUtils.h"
+#include "MLDSPFFT.h"
+#include "MLDSPFunctional.h"
+
+using namespace ml;
+using namespace testUtils;
+
+namespace
+{
+// a naive DFT of n complex points, for reference.
+void naiveDFT(const float* pxr, const float* pxi, float* pyr, float* pyi, int n)
+{
+  std::vector<float> cosTable(n), sinTable(n);
+  for (int i = 0; i < n; ++i)
+  {
+    double omega = kTwoPi * i / n;
+    cosTable[i] = static_cast<float>(cos(omega));
+    sinTable[i] = static_cast<float>(sin(omega));
+  }
+  for (int k = 0; k < n; ++k)
+  {
+    float re{0.f}, im{0.f};
+    for (int t = 0; t < n; ++t)
+    {
+      int i = (k * t) % n;
+      re += pxr[t] * cosTable[i] + pxi[t] * sinTable[i];
+      im += pxi[t] * cosTable[i] - pxr[t] * sinTable[i];
+    }
+    pyr[k] = re;
+    pyi[k] = im;
+  }
+}
+
+template <size_t ROWS>
+float maxDifference(const DSPVectorArray<ROWS>& a, const DSPVectorArray<ROWS>& b)
+{
+  float d{0.f};
+  for (size_t i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  {
+    d = std::max(d, fabsf(a[i] - b[i]));
+  }
+  return d;
+}
+
+// time the FFT of each size from ROWS DSPVectors up to 16384 points, and
+// the naive DFT of sizes up to maxDFTSize.
+template <size_t ROWS>
+void timeTransforms(RandomScalarSource& noise, int maxDFTSize)
+{
+  constexpr int kSize = kFloatsPerDSPVector * ROWS;
+  FFT<ROWS> fft;
+  DSPVectorArray<ROWS> x, y;
+  x = map([&]() { return noise.getFloat(); }, x);
+
+  auto fftFn = [&]() {
+    fft.forward(x, y);
+    return y[1];
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto fftTime = timeIterationsInThread<float>(fftFn);
+#else
+  auto fftTime = timeIterations<float>(fftFn);
+#endif
+  std::cout << "size " << kSize << " ns: fft " << fftTime.ns << "\n";
+
+  // the naive DFT is too slow to repeat at the larger sizes, so time one run.
+  if (kSize <= maxDFTSize)
+  {
+    std::vector<float> zeros(kSize), dftReal(kSize), dftImag(kSize);
+    auto start = high_resolution_clock::now();
+    naiveDFT(x.getConstBuffer(), zeros.data(), dftReal.data(), dftImag.data(), kSize);
+    auto end = high_resolution_clock::now();
+    auto dftNanos = duration_cast<nanoseconds>(end - start).count();
+    std::cout << "size " << kSize << " ns: naive DFT " << dftNanos << "\n";
+  }
+
+  if constexpr (kSize < 16384)
+  {
+    timeTransforms<ROWS * 2>(noise, maxDFTSize);
+  }
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/dsp_fft", "[dsp_fft]")
+{
+  constexpr size_t kRows = 4;
+  constexpr int kSize = kFloatsPerDSPVector * kRows;
+  RandomScalarSource noise;
+  FFT<kRows> fft;
+
+  // compare spectra to the naive DFT, relative to the largest bin.
+  auto spectrumError = [&](const float* pyr, const float* pyi, const float* pxr,
+                           const float* pxi) {
+    std::vector<float> dftReal(kSize), dftImag(kSize);
+    naiveDFT(pxr, pxi, dftReal.data(), dftImag.data(), kSize);
+    float maxBin{0.f}, maxError{0.f};
+    for (int k = 0; k < kSize; ++k)
+    {
+      maxBin = std::max(maxBin, std::hypot(dftReal[k], dftImag[k]));
+      maxError = std::max(maxError, std::hypot(pyr[k] - dftReal[k], pyi[k] - dftImag[k]));
+    }
+    return maxError / maxBin;
+  };
+
+  // real transforms. The bins of the packed spectrum above N/2 are the
+  // conjugates of those below.
+  DSPVectorArray<kRows> x, y, z;
+  x = map([&]() { return noise.getFloat(); }, x);
+  fft.forward(x, y);
+  std::vector<float> zeros(kSize), re(kSize), im(kSize);
+  for (int k = 0; k <= kSize / 2; ++k)
+  {
+    re[k] = y[k];
+    im[k] = (k > 0 && k < kSize / 2) ? y[kSize / 2 + k] : 0.f;
+  }
+  for (int k = kSize / 2 + 1; k < kSize; ++k)
+  {
+    re[k] = re[kSize - k];
+    im[k] = -im[kSize - k];
+  }
+  REQUIRE(spectrumError(re.data(), im.data(), x.getConstBuffer(), zeros.data()) < 1e-5f);
+
+  fft.inverse(y, z);
+  REQUIRE(maxDifference(z, x) < 1e-5f);
+
+  // complex transforms.
+  DSPVectorArray<kRows * 2> cx, cy, cz;
+  cx = map([&]() { return noise.getFloat(); }, cx);
+  fft.forwardComplex(cx, cy);
+  const float* px = cx.getConstBuffer();
+  const float* py = cy.getConstBuffer();
+  REQUIRE(spectrumError(py, py + kSize, px, px + kSize) < 1e-5f);
+
+  fft.inverseComplex(cy, cz);
+  REQUIRE(maxDifference(cz, cx) < 1e-5f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_fft/timing", "[dsp_fft][.timing]")
+{
+  RandomScalarSource noise;
+  timeTransforms<1>(noise, 1024);
+}
+
+// the same with the naive DFT at the larger sizes, which takes seconds.
+TEST_CASE("madronalib/core/dsp_fft/timing_naive", "[dsp_fft][.timing]")
+{
+  RandomScalarSource noise;
+  timeTransforms<1>(noise, 16384);
+}
+
+TEST_CASE("madronalib/core/dsp_fft/overlap_add", "[dsp_fft][overlap_add]")
+{
+  constexpr int kLength = kFloatsPerDSPVector * 4;
+  constexpr int kVectors = 32;
+  RandomScalarSource noise;
+  std::vector<DSPVectorArray<2>> inputs(kVectors);
+  for (auto& x : inputs)
+  {
+    x = map([&]() { return noise.getFloat(); }, x);
+  }
+
+  // compare the output samples to the input delayed by the latency.
+  auto delayError = [&](const std::vector<DSPVector>& outputs, int latency, auto inputFn) {
+    float maxError{0.f};
+    for (int t = latency; t < kVectors * static_cast<int>(kFloatsPerDSPVector); ++t)
+    {
+      int u = t - latency;
+      float x = inputFn(inputs[u / kFloatsPerDSPVector], u % kFloatsPerDSPVector);
+      float y = outputs[t / kFloatsPerDSPVector][t % kFloatsPerDSPVector];
+      maxError = std::max(maxError, fabsf(y - x));
+    }
+    return maxError;
+  };
+
+  // copying frames at 75% overlap should reconstruct the input.
+  OverlapAddFunction<kLength, 4, 1, 1> overlapAdd;
+  auto copyFn = [](const auto& in, auto& out) { out = in; };
+  std::vector<DSPVector> outputs;
+  for (auto& x : inputs)
+  {
+    outputs.push_back(overlapAdd(copyFn, x.constRow(0)));
+  }
+  auto row0 = [](const DSPVectorArray<2>& x, int n) { return x[n]; };
+  REQUIRE(delayError(outputs, overlapAdd.getLatency(), row0) < 1e-5f);
+
+  // summing the spectra of two rows at 50% overlap should give the sum of the
+  // rows.
+  SpectralFunction<kLength, 2, 2, 1> spectral;
+  constexpr int kFrameRows = kLength / kFloatsPerDSPVector;
+  auto sumFn = [&](const DSPVectorArray<kFrameRows * 2>& in, DSPVectorArray<kFrameRows>& out) {
+    const float* px = in.getConstBuffer();
+    float* py = out.getBuffer();
+    for (int k = 0; k < kLength; ++k)
+    {
+      py[k] = px[k] + px[kLength + k];
+    }
+  };
+  outputs.clear();
+  for (auto& x : inputs)
+  {
+    outputs.push_back(spectral(sumFn, x));
+  }
+  auto sumRows = [](const DSPVectorArray<2>& x, int n) {
+    return x[n] + x[kFloatsPerDSPVector + n];
+  };
+  REQUIRE(delayError(outputs, spectral.getLatency(), sumRows) < 1e-5f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_fft/overlap_add_timing", "[dsp_fft][overlap_add][.timing]")
+{
+  // time a 1024-point STFT at 75% overlap.
+  SpectralFunction<1024, 4, 1, 1> stft;
+  auto identityFn = [](const DSPVectorArray<1024 / kFloatsPerDSPVector>& in,
+                       DSPVectorArray<1024 / kFloatsPerDSPVector>& out) { out = in; };
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+  auto stftFn = [&]() { return stft(identityFn, input); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto stftTime = timeIterationsInThread<DSPVector>(stftFn);
+#else
+  auto stftTime = timeIterations<DSPVector>(stftFn);
+#endif
+  std::cout << "1024-point STFT at 75% overlap, ns per vector: " << stftTime.ns << "\n";
+}
@@ -7,9 +7,13 @@
 #include "catch.hpp"
 #include "testUtils.h"
 #include "MLDSPFilters.h"
+#include "MLDSPBlockFilters.h"
+#include "MLDSPFilterBanks.h"
+#include "MLDSPFunctional.h"
 #include "MLDSPSample.h"
 
 using namespace ml;
+using namespace testUtils;
 
 TEST_CASE("madronalib/core/dsp_filters", "[dsp_filters]")
 {
@@ -59,3 +63,937 @@ TEST_CASE("madronalib/core/dsp_filters", "[dsp_filters]")
     DSPVector sineOut = downer.read();
   }
 }
+
+TEST_CASE("madronalib/core/dsp_filters/banks", "[dsp_filters][banks]")
+{
+  // use a number of voices that doesn't fill the last SIMD vector.
+  constexpr size_t kVoices{6};
+  auto omegaOfVoice = [](size_t v) { return 0.01f + 0.03f * v; };
+  auto kOfVoice = [](size_t v) { return 0.1f + 0.2f * v; };
+
+  RandomScalarSource noise;
+  DSPVectorArray<kVoices> input{map([&]() { return noise.getFloat(); }, DSPVectorArray<kVoices>())};
+
+  LopassBank<kVoices> lopassBank;
+  BandpassBank<kVoices> bandpassBank;
+  HipassBank<kVoices> hipassBank;
+  std::array<Lopass, kVoices> lopasses;
+  std::array<Bandpass, kVoices> bandpasses;
+  std::array<Hipass, kVoices> hipasses;
+  for (size_t v = 0; v < kVoices; ++v)
+  {
+    lopassBank.setParams(v, omegaOfVoice(v), kOfVoice(v));
+    bandpassBank.setParams(v, omegaOfVoice(v), kOfVoice(v));
+    hipassBank.setParams(v, omegaOfVoice(v), kOfVoice(v));
+    lopasses[v]._coeffs = Lopass::makeCoeffs(omegaOfVoice(v), kOfVoice(v));
+    bandpasses[v].mCoeffs = Bandpass::coeffs(omegaOfVoice(v), kOfVoice(v));
+    hipasses[v].mCoeffs = Hipass::coeffs(omegaOfVoice(v), kOfVoice(v));
+  }
+
+  // the banks should match the scalar filters on each row, over several vectors.
+  bool lopassMatches{true}, bandpassMatches{true}, hipassMatches{true};
+  for (int i = 0; i < 4; ++i)
+  {
+    auto lopassOut = lopassBank(input);
+    auto bandpassOut = bandpassBank(input);
+    auto hipassOut = hipassBank(input);
+    for (size_t v = 0; v < kVoices; ++v)
+    {
+      lopassMatches &= (lopassOut.constRow(v) == lopasses[v](input.constRow(v)));
+      bandpassMatches &= (bandpassOut.constRow(v) == bandpasses[v](input.constRow(v)));
+      hipassMatches &= (hipassOut.constRow(v) == hipasses[v](input.constRow(v)));
+    }
+  }
+  REQUIRE(lopassMatches);
+  REQUIRE(bandpassMatches);
+  REQUIRE(hipassMatches);
+
+  // with parameters at each sample
+  DSPVectorArray<kVoices> omegas{
+      map([&](DSPVector x, int v) { return omegaOfVoice(v) + x * 0.001f; },
+          repeatRows<kVoices>(columnIndex()))};
+  DSPVectorArray<kVoices> ks{map([&](DSPVector x, int v) { return DSPVector(kOfVoice(v)); },
+                                 DSPVectorArray<kVoices>())};
+  auto lopassOut = lopassBank(input, omegas, ks);
+  bool lopassVaryingMatches{true};
+  for (size_t v = 0; v < kVoices; ++v)
+  {
+    auto scalarOut = lopasses[v](input.constRow(v), omegas.constRow(v), ks.constRow(v));
+    lopassVaryingMatches &= (lopassOut.constRow(v) == scalarOut);
+  }
+  REQUIRE(lopassVaryingMatches);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/banks_timing", "[dsp_filters][banks][.timing]")
+{
+  // time 16 voices in a bank against 16 scalar filters
+  constexpr size_t kTimedVoices{16};
+  RandomScalarSource noise;
+  DSPVectorArray<kTimedVoices> timedInput{
+      map([&]() { return noise.getFloat(); }, DSPVectorArray<kTimedVoices>())};
+  LopassBank<kTimedVoices> timedBank;
+  Bank<Lopass, kTimedVoices> timedScalars;
+  for (size_t v = 0; v < kTimedVoices; ++v)
+  {
+    timedBank.setParams(v, 0.1f, 0.5f);
+    timedScalars[v]._coeffs = Lopass::makeCoeffs(0.1f, 0.5f);
+  }
+  auto bankFn = [&]() { return timedBank(timedInput); };
+  auto scalarFn = [&]() { return timedScalars(timedInput); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto bankTime = timeIterationsInThread<DSPVectorArray<kTimedVoices>>(bankFn);
+  auto scalarTime = timeIterationsInThread<DSPVectorArray<kTimedVoices>>(scalarFn);
+#else
+  auto bankTime = timeIterations<DSPVectorArray<kTimedVoices>>(bankFn);
+  auto scalarTime = timeIterations<DSPVectorArray<kTimedVoices>>(scalarFn);
+#endif
+  std::cout << kTimedVoices << " lopass voices: LopassBank " << bankTime.ns
+            << " ns, Bank<Lopass> " << scalarTime.ns << " ns\n";
+}
+
+TEST_CASE("madronalib/core/dsp_filters/adsr_bank", "[dsp_filters][banks]")
+{
+  // use a number of voices that doesn't fill the last SIMD vector.
+  constexpr size_t kVoices{6};
+  constexpr float kSampleRate{48000.f};
+  auto coeffsOfVoice = [&](size_t v) {
+    return ADSR::calcCoeffs(0.001f * (v + 1), 0.002f * (v + 1), 0.2f * v, 0.003f + 0.01f * (v % 2),
+                             kSampleRate);
+  };
+
+  ADSRBank<kVoices> adsrBank;
+  std::array<ADSR, kVoices> adsrs;
+  for (size_t v = 0; v < kVoices; ++v)
+  {
+    adsrBank.setCoeffs(v, coeffsOfVoice(v));
+    adsrs[v].coeffs = coeffsOfVoice(v);
+  }
+
+  // gates of different lengths and amplitudes for each voice, long enough to
+  // reach each segment, and some retriggered before the release ends.
+  auto gateOfVoice = [](int v, int t) {
+    int period = 700 + 150 * v;
+    int phase = (t + 37 * v) % period;
+    return (phase < 300 + 40 * v) ? 0.5f + 0.1f * v + 0.01f * (t / period) : 0.f;
+  };
+
+  bool matches{true};
+  for (int i = 0; i < 64; ++i)
+  {
+    DSPVectorArray<kVoices> gates;
+    for (size_t v = 0; v < kVoices; ++v)
+    {
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        gates.row(v)[n] = gateOfVoice(v, i * kFloatsPerDSPVector + n);
+      }
+    }
+    auto bankOut = adsrBank(gates);
+    for (size_t v = 0; v < kVoices; ++v)
+    {
+      matches &= (bankOut.constRow(v) == adsrs[v](gates.constRow(v)));
+    }
+  }
+  REQUIRE(matches);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/adsr_bank_timing", "[dsp_filters][banks][.timing]")
+{
+  // time 16 voices in a bank against 16 scalar envelopes, all sounding.
+  constexpr size_t kTimedVoices{16};
+  constexpr float kSampleRate{48000.f};
+  auto coeffs = ADSR::calcCoeffs(0.002f, 0.004f, 0.2f, 0.013f, kSampleRate);
+  DSPVectorArray<kTimedVoices> timedGates{1.f};
+  ADSRBank<kTimedVoices> timedBank;
+  std::array<ADSR, kTimedVoices> timedScalars;
+  timedBank.setCoeffs(coeffs);
+  for (auto& adsr : timedScalars)
+  {
+    adsr.coeffs = coeffs;
+  }
+  auto bankFn = [&]() { return timedBank(timedGates); };
+  auto scalarFn = [&]() {
+    DSPVectorArray<kTimedVoices> y;
+    for (size_t v = 0; v < kTimedVoices; ++v)
+    {
+      y.row(v) = timedScalars[v](timedGates.constRow(v));
+    }
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto bankTime = timeIterationsInThread<DSPVectorArray<kTimedVoices>>(bankFn);
+  auto scalarTime = timeIterationsInThread<DSPVectorArray<kTimedVoices>>(scalarFn);
+#else
+  auto bankTime = timeIterations<DSPVectorArray<kTimedVoices>>(bankFn);
+  auto scalarTime = timeIterations<DSPVectorArray<kTimedVoices>>(scalarFn);
+#endif
+  std::cout << kTimedVoices << " envelopes: ADSRBank " << bankTime.ns << " ns, ADSR "
+            << scalarTime.ns << " ns\n";
+}
+
+TEST_CASE("madronalib/core/dsp_filters/coeffs", "[dsp_filters][coeffs]")
+{
+  DSPVector omega{rangeOpen(0.001f, 0.49f)};
+  DSPVector k{rangeOpen(0.01f, 2.f)};
+  DSPVector A{rangeOpen(0.25f, 4.f)};
+
+  // vectorized coefficients should match the scalar ones at each sample.
+  auto lopassCoeffs = Lopass::makeCoeffsVec(omega, k);
+  auto loShelfCoeffs = LoShelf::vcoeffs(omega, k, A);
+  auto bellCoeffs = Bell::vcoeffs(omega, k, A);
+  float maxLopassError{0.f}, maxLoShelfError{0.f}, maxBellError{0.f};
+  for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    auto c = Lopass::makeCoeffs(omega[n], k[n]);
+    for (int i = 0; i < Lopass::nCoeffs; ++i)
+    {
+      maxLopassError = std::max(maxLopassError, std::fabs(lopassCoeffs.constRow(i)[n] - c[i]));
+    }
+    auto cs = LoShelf::coeffs({omega[n], k[n], A[n]});
+    for (size_t i = 0; i < cs.size(); ++i)
+    {
+      float err = std::fabs(loShelfCoeffs.constRow(i)[n] - cs[i]) / std::max(1.f, std::fabs(cs[i]));
+      maxLoShelfError = std::max(maxLoShelfError, err);
+    }
+    auto cb = Bell::coeffs(omega[n], k[n], A[n]);
+    std::array<float, 4> cbArray{cb.a1, cb.a2, cb.a3, cb.m1};
+    for (int i = 0; i < 4; ++i)
+    {
+      float err = std::fabs(bellCoeffs.constRow(i)[n] - cbArray[i]) /
+                  std::max(1.f, std::fabs(cbArray[i]));
+      maxBellError = std::max(maxBellError, err);
+    }
+  }
+  REQUIRE(maxLopassError < 1e-6f);
+  REQUIRE(maxLoShelfError < 1e-5f);
+  REQUIRE(maxBellError < 1e-5f);
+
+  // at control rate with constant parameters, a filter should match one
+  // with fixed coefficients.
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+  Lopass fixedLopass, controlLopass;
+  fixedLopass._coeffs = controlLopass._coeffs = Lopass::makeCoeffs(0.1f, 0.5f);
+  controlLopass.coeffsRate = CoeffsRate::control;
+  REQUIRE(controlLopass(input, DSPVector(0.1f), DSPVector(0.5f)) == fixedLopass(input));
+
+  // control rate starts from the coefficients for the first vector's
+  // parameters, rather than fading in from zero.
+  Lopass newLopass;
+  newLopass.coeffsRate = CoeffsRate::control;
+  fixedLopass.clear();
+  REQUIRE(newLopass(input, DSPVector(0.1f), DSPVector(0.5f)) == fixedLopass(input));
+  Hipass fixedHipass, newHipass;
+  fixedHipass.mCoeffs = Hipass::coeffs(0.1f, 0.5f);
+  newHipass.coeffsRate = CoeffsRate::control;
+  REQUIRE(newHipass(input, DSPVector(0.1f), DSPVector(0.5f)) == fixedHipass(input));
+  Bandpass fixedBandpass, newBandpass;
+  fixedBandpass.mCoeffs = Bandpass::coeffs(0.1f, 0.5f);
+  newBandpass.coeffsRate = CoeffsRate::control;
+  REQUIRE(newBandpass(input, DSPVector(0.1f), DSPVector(0.5f)) == fixedBandpass(input));
+
+  // parameters out of range are clamped to omega <= 0.5 and k >= 0.01 at
+  // either rate.
+  for (auto rate : {CoeffsRate::audio, CoeffsRate::control})
+  {
+    Hipass hipass, clampedHipass;
+    Bandpass bandpass, clampedBandpass;
+    hipass.coeffsRate = clampedHipass.coeffsRate = rate;
+    bandpass.coeffsRate = clampedBandpass.coeffsRate = rate;
+    for (int i = 0; i < 4; ++i)
+    {
+      REQUIRE(hipass(input, DSPVector(0.8f), DSPVector(0.f)) ==
+              clampedHipass(input, DSPVector(0.5f), DSPVector(0.01f)));
+      REQUIRE(bandpass(input, DSPVector(0.8f), DSPVector(0.f)) ==
+              clampedBandpass(input, DSPVector(0.5f), DSPVector(0.01f)));
+    }
+  }
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/coeffs_timing", "[dsp_filters][coeffs][.timing]")
+{
+  DSPVector omega{rangeOpen(0.001f, 0.49f)};
+  DSPVector k{rangeOpen(0.01f, 2.f)};
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+  Lopass fixedLopass, controlLopass;
+  fixedLopass._coeffs = controlLopass._coeffs = Lopass::makeCoeffs(0.1f, 0.5f);
+  controlLopass.coeffsRate = CoeffsRate::control;
+
+  // time coefficients at audio rate, against the per-sample sinf computation
+  // they replaced, and against filtering with fixed coefficients.
+  auto scalarCoeffsFn = [&]() {
+    Lopass::coeffsVec vy;
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      auto c = Lopass::makeCoeffs(omega[n], k[n]);
+      for (int i = 0; i < Lopass::nCoeffs; ++i)
+      {
+        vy.row(i)[n] = c[i];
+      }
+    }
+    return vy;
+  };
+  auto vectorCoeffsFn = [&]() { return Lopass::makeCoeffsVec(omega, k); };
+  auto filterFn = [&]() { return fixedLopass(input); };
+  auto audioRateFn = [&]() { return fixedLopass(input, omega, k); };
+  auto controlRateFn = [&]() { return controlLopass(input, omega, k); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto scalarCoeffsTime = timeIterationsInThread<Lopass::coeffsVec>(scalarCoeffsFn);
+  auto vectorCoeffsTime = timeIterationsInThread<Lopass::coeffsVec>(vectorCoeffsFn);
+  auto filterTime = timeIterationsInThread<DSPVector>(filterFn);
+  auto audioRateTime = timeIterationsInThread<DSPVector>(audioRateFn);
+  auto controlRateTime = timeIterationsInThread<DSPVector>(controlRateFn);
+#else
+  auto scalarCoeffsTime = timeIterations<Lopass::coeffsVec>(scalarCoeffsFn);
+  auto vectorCoeffsTime = timeIterations<Lopass::coeffsVec>(vectorCoeffsFn);
+  auto filterTime = timeIterations<DSPVector>(filterFn);
+  auto audioRateTime = timeIterations<DSPVector>(audioRateFn);
+  auto controlRateTime = timeIterations<DSPVector>(controlRateFn);
+#endif
+  std::cout << "lopass coeffs ns: scalar " << scalarCoeffsTime.ns << ", vector "
+            << vectorCoeffsTime.ns << "\n";
+  std::cout << "lopass ns: fixed " << filterTime.ns << ", audio rate " << audioRateTime.ns
+            << ", control rate " << controlRateTime.ns << "\n";
+}
+
+TEST_CASE("madronalib/core/dsp_filters/block", "[dsp_filters][block]")
+{
+  RandomScalarSource noise;
+  auto makeInput = [&]() { return map([&]() { return noise.getFloat(); }, DSPVector()); };
+
+  OnePole onePole;
+  DCBlocker dcBlocker;
+  Lopass lopass;
+  Bandpass bandpass;
+  Hipass hipass;
+  BlockOnePole blockOnePole;
+  BlockDCBlocker blockDCBlocker;
+  BlockLopass blockLopass;
+  BlockBandpass blockBandpass;
+  BlockHipass blockHipass;
+
+  const float omega{0.05f}, k{0.3f};
+  onePole.mCoeffs = OnePole::coeffs(omega);
+  dcBlocker.mCoeffs = DCBlocker::coeffs(omega);
+  lopass._coeffs = Lopass::makeCoeffs(omega, k);
+  bandpass.mCoeffs = Bandpass::coeffs(omega, k);
+  hipass.mCoeffs = Hipass::coeffs(omega, k);
+  blockOnePole.setParams(omega);
+  blockDCBlocker.setParams(omega);
+  blockLopass.setParams(omega, k);
+  blockBandpass.setParams(omega, k);
+  blockHipass.setParams(omega, k);
+
+  // the block filters should match the scalar ones to within float rounding,
+  // relative to the size of the output, over enough vectors for the state to
+  // build up.
+  float maxError{0.f};
+  auto compare = [&](const DSPVector& a, const DSPVector& b) {
+    float e = max(abs(a - b)) / std::max(1.f, max(abs(b)));
+    maxError = std::max(maxError, e);
+  };
+  for (int i = 0; i < 16; ++i)
+  {
+    DSPVector x{makeInput()};
+    compare(blockOnePole(x), onePole(x));
+    compare(blockDCBlocker(x), dcBlocker(x));
+    compare(blockLopass(x), lopass(x));
+    compare(blockBandpass(x), bandpass(x));
+    compare(blockHipass(x), hipass(x));
+  }
+  REQUIRE(maxError < 1e-5f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/block_timing", "[dsp_filters][block][.timing]")
+{
+  // time a chain of cascaded filters, block against scalar.
+  OnePole onePole;
+  DCBlocker dcBlocker;
+  Lopass lopass;
+  Hipass hipass;
+  BlockOnePole blockOnePole;
+  BlockDCBlocker blockDCBlocker;
+  BlockLopass blockLopass;
+  BlockHipass blockHipass;
+
+  const float omega{0.05f}, k{0.3f};
+  onePole.mCoeffs = OnePole::coeffs(omega);
+  dcBlocker.mCoeffs = DCBlocker::coeffs(omega);
+  lopass._coeffs = Lopass::makeCoeffs(omega, k);
+  hipass.mCoeffs = Hipass::coeffs(omega, k);
+  blockOnePole.setParams(omega);
+  blockDCBlocker.setParams(omega);
+  blockLopass.setParams(omega, k);
+  blockHipass.setParams(omega, k);
+
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+  auto scalarFn = [&]() { return hipass(lopass(dcBlocker(onePole(input)))); };
+  auto blockFn = [&]() { return blockHipass(blockLopass(blockDCBlocker(blockOnePole(input)))); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto scalarTime = timeIterationsInThread<DSPVector>(scalarFn);
+  auto blockTime = timeIterationsInThread<DSPVector>(blockFn);
+#else
+  auto scalarTime = timeIterations<DSPVector>(scalarFn);
+  auto blockTime = timeIterations<DSPVector>(blockFn);
+#endif
+  std::cout << "filter chain ns: scalar " << scalarTime.ns << ", block " << blockTime.ns
+            << "\n";
+}
+
+TEST_CASE("madronalib/core/dsp_filters/resampling", "[dsp_filters][resampling]")
+{
+  RandomScalarSource noise;
+  auto makeInput = [&]() { return map([&]() { return noise.getFloat(); }, DSPVector()); };
+
+  // in-place upsampling and downsampling through pointers should match the
+  // DSPVector versions, to within differences in float rounding.
+  HalfBandFilter hbVector, hbPointer;
+  DSPVectorArray<2> buffer;
+  float maxError{0.f};
+  for (int i = 0; i < 4; ++i)
+  {
+    DSPVector x{makeInput()};
+    auto y = hbVector.upsample(x);
+    buffer.row(1) = x;
+    hbPointer.upsample(buffer.getConstBuffer() + kFloatsPerDSPVector, buffer.getBuffer());
+    for (int j = 0; j < 2; ++j)
+    {
+      maxError = std::max(maxError, max(abs(buffer.constRow(j) - y.constRow(j))));
+    }
+
+    DSPVector z = hbVector.downsample(y.constRow(0), y.constRow(1));
+    hbPointer.downsample(buffer.getConstBuffer(), buffer.getBuffer());
+    maxError = std::max(maxError, max(abs(buffer.constRow(0) - z)));
+  }
+  REQUIRE(maxError < 1e-6f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/resampling_timing", "[dsp_filters][resampling][.timing]")
+{
+  // time oversampling by 2, 4 and 8 around a nonlinearity.
+  RandomScalarSource noise;
+  DSPVector input{map([&]() { return noise.getFloat(); }, DSPVector())};
+  for (int octaves = 1; octaves <= 3; ++octaves)
+  {
+    Upsampler upper(octaves);
+    Downsampler downer(octaves);
+    int ratio = 1 << octaves;
+    auto resampleFn = [&]() {
+      upper.write(input);
+      for (int i = 0; i < ratio; ++i)
+      {
+        downer.write(tanhApprox(upper.read()));
+      }
+      return downer.read();
+    };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+    auto resampleTime = timeIterationsInThread<DSPVector>(resampleFn);
+#else
+    auto resampleTime = timeIterations<DSPVector>(resampleFn);
+#endif
+    std::cout << ratio << "x oversampled tanhApprox ns: " << resampleTime.ns << "\n";
+  }
+}
+
+TEST_CASE("madronalib/core/dsp_filters/oversample", "[dsp_filters][oversample]")
+{
+  RandomScalarSource noise;
+  auto makeInput = [&]() { return map([&]() { return noise.getFloat(); }, DSPVector()); };
+  auto identity = [](const DSPVectorArray<1>& x) { return x; };
+
+  // at 2x, the result should match Upsample2xFunction.
+  OversampleFunction<2, 1, 1> over2;
+  Upsample2xFunction<1> upper;
+  float maxError{0.f};
+  for (int i = 0; i < 4; ++i)
+  {
+    DSPVector x{makeInput()};
+    maxError = std::max(maxError, max(abs(over2(identity, x) - upper(identity, x))));
+  }
+  REQUIRE(maxError < 1e-6f);
+
+  // the centroid of the impulse response should match the reported latency.
+  auto measureLatency = [&](auto& over) {
+    float sum{0.f}, weightedSum{0.f};
+    for (int i = 0; i < 8; ++i)
+    {
+      DSPVector x{0.f};
+      if (i == 0) x[0] = 1.f;
+      DSPVector y = over(identity, x);
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        sum += y[n];
+        weightedSum += y[n] * (i * kFloatsPerDSPVector + n);
+      }
+    }
+    return weightedSum / sum;
+  };
+  OversampleFunction<2, 1, 1> over2b;
+  OversampleFunction<4, 1, 1> over4;
+  OversampleFunction<8, 1, 1> over8;
+  REQUIRE(fabs(measureLatency(over2b) - over2b.getLatency()) < 0.01f);
+  REQUIRE(fabs(measureLatency(over4) - over4.getLatency()) < 0.01f);
+  REQUIRE(fabs(measureLatency(over8) - over8.getLatency()) < 0.01f);
+
+  // each row should be resampled independently: a stereo wrapper making three
+  // rows of output should match mono wrappers on each row. Since the filters
+  // are linear, the sum row should match the sum of the others.
+  OversampleFunction<4, 2, 3> overStereo;
+  OversampleFunction<4, 1, 1> overLeft, overRight;
+  auto stereoFn = [](const DSPVectorArray<2>& x) {
+    return concatRows(x.constRow(0), x.constRow(1), x.constRow(0) + x.constRow(1));
+  };
+  maxError = 0.f;
+  for (int i = 0; i < 4; ++i)
+  {
+    DSPVectorArray<2> x{concatRows(makeInput(), makeInput())};
+    auto y = overStereo(stereoFn, x);
+    DSPVector left = overLeft(identity, x.constRow(0));
+    DSPVector right = overRight(identity, x.constRow(1));
+    maxError = std::max(maxError, max(abs(y.constRow(0) - left)));
+    maxError = std::max(maxError, max(abs(y.constRow(1) - right)));
+    maxError = std::max(maxError, max(abs(y.constRow(2) - (left + right))));
+  }
+  REQUIRE(maxError < 1e-5f);
+}
+
+TEST_CASE("madronalib/core/dsp_filters/multitap", "[dsp_filters][multitap]")
+{
+  constexpr int kVectors = 20;
+  constexpr float kOmega = 0.05f;
+  auto sine = [&](float t) { return sinf(kTwoPi * kOmega * t); };
+
+  // run a sine through the taps, with delays for the given number of rows
+  // from the function delayFn, and return the largest error of the taps.
+  auto tapError = [&](auto& delay, int rows, auto delayFn) {
+    using Delays = std::decay_t<decltype(delayFn(0))>;
+    float maxError{0.f};
+    for (int i = 0; i < kVectors; ++i)
+    {
+      DSPVector x, t{columnIndex() + DSPVector(i * kFloatsPerDSPVector)};
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        x[n] = sine(t[n]);
+      }
+      Delays d = delayFn(i);
+      Delays y = delay(x, d);
+      for (size_t n = 0; n < kFloatsPerDSPVector * rows; ++n)
+      {
+        // skip outputs that would interpolate the silence before the input.
+        float u = t[n % kFloatsPerDSPVector] - d[n];
+        if (u < 2.f) continue;
+        float expected = sine(u);
+        maxError = std::max(maxError, fabsf(y[n] - expected));
+      }
+    }
+    return maxError;
+  };
+
+  // whole delays, including ones shorter than a vector, should be exact.
+  auto wholeDelays = [](int) {
+    return DSPVectorArray<3>(concatRows(DSPVector(1.f), DSPVector(50.f), DSPVector(300.f)));
+  };
+  MultiTapDelay<3> linearWhole(400.f);
+  MultiTapDelay<3, TapInterpolation::cubic> cubicWhole(400.f);
+  MultiTapDelay<3, TapInterpolation::lagrange> lagrangeWhole(400.f);
+  REQUIRE(tapError(linearWhole, 3, wholeDelays) < 1e-6f);
+  REQUIRE(tapError(cubicWhole, 3, wholeDelays) < 1e-6f);
+  REQUIRE(tapError(lagrangeWhole, 3, wholeDelays) < 1e-6f);
+
+  // fractional delays, modulated every sample. The four point interpolators
+  // should be more accurate than linear interpolation.
+  auto modulatedDelays = [](int i) {
+    DSPVector t{columnIndex() + DSPVector(i * kFloatsPerDSPVector)};
+    DSPVector d1 = DSPVector(10.5f) + sin(t * DSPVector(0.01f)) * DSPVector(5.f);
+    DSPVector d2 = DSPVector(200.25f) + t * DSPVector(0.1f);
+    return DSPVectorArray<2>(concatRows(d1, d2));
+  };
+  MultiTapDelay<2> linear(600.f);
+  MultiTapDelay<2, TapInterpolation::cubic> cubic(600.f);
+  MultiTapDelay<2, TapInterpolation::lagrange> lagrange(600.f);
+  float linearError = tapError(linear, 2, modulatedDelays);
+  float cubicError = tapError(cubic, 2, modulatedDelays);
+  float lagrangeError = tapError(lagrange, 2, modulatedDelays);
+  REQUIRE(linearError < 0.02f);
+  REQUIRE(cubicError < linearError * 0.2f);
+  REQUIRE(lagrangeError < linearError * 0.2f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/multitap_timing", "[dsp_filters][multitap][.timing]")
+{
+  // time eight modulated taps of each kind against eight FractionalDelays.
+  DSPVector x{columnIndex()};
+  DSPVectorArray<8> delays{repeatRows<8>(DSPVector(100.5f) + x)};
+  MultiTapDelay<8, TapInterpolation::cubic> cubic8(1000.f);
+  MultiTapDelay<8, TapInterpolation::linear> linear8(1000.f);
+  auto cubicFn = [&]() { return cubic8(x, delays); };
+  auto linearFn = [&]() { return linear8(x, delays); };
+  std::vector<FractionalDelay> fractionalDelays(8);
+  for (auto& fd : fractionalDelays)
+  {
+    fd.setMaxDelayInSamples(1000.f);
+  }
+  auto fractionalFn = [&]() {
+    DSPVectorArray<8> y;
+    for (int j = 0; j < 8; ++j)
+    {
+      DSPVector yj = fractionalDelays[j](x, DSPVector(delays.getRowDataConst(j)));
+      std::copy(yj.getConstBuffer(), yj.getConstBuffer() + kFloatsPerDSPVector, y.getRowData(j));
+    }
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto cubicTime = timeIterationsInThread<DSPVectorArray<8>>(cubicFn);
+  auto linearTime = timeIterationsInThread<DSPVectorArray<8>>(linearFn);
+  auto fractionalTime = timeIterationsInThread<DSPVectorArray<8>>(fractionalFn);
+#else
+  auto cubicTime = timeIterations<DSPVectorArray<8>>(cubicFn);
+  auto linearTime = timeIterations<DSPVectorArray<8>>(linearFn);
+  auto fractionalTime = timeIterations<DSPVectorArray<8>>(fractionalFn);
+#endif
+  std::cout << "8 taps, ns: cubic " << cubicTime.ns << ", linear " << linearTime.ns
+            << ", 8 FractionalDelays " << fractionalTime.ns << "\n";
+}
+
+namespace
+{
+// PitchbendableDelay as two FractionalDelays that always run, for reference.
+struct TwoFractionalDelays
+{
+  FractionalDelay mDelay1, mDelay2;
+
+  void setMaxDelayInSamples(float d)
+  {
+    mDelay1.setMaxDelayInSamples(d);
+    mDelay2.setMaxDelayInSamples(d);
+  }
+
+  DSPVector operator()(const DSPVector vInput, const DSPVector vDelayInSamples)
+  {
+    using namespace PitchbendableDelayConsts;
+    return lerp(mDelay1(vInput, vDelayInSamples, kvDelay1Changes),
+                mDelay2(vInput, vDelayInSamples, kvDelay2Changes), kvFade);
+  }
+};
+
+// the reverb of examples/rtaudio/reverb.cpp, with delays of type DELAY_TYPE.
+template <typename DELAY_TYPE>
+struct AaltoverbTopology
+{
+  std::array<Allpass<DELAY_TYPE>, 10> allpasses;
+  DELAY_TYPE delayL, delayR;
+  DSPVector feedbackL, feedbackR;
+
+  AaltoverbTopology()
+  {
+    float gains[10]{0.75f, 0.7f, 0.625f, 0.625f, 0.7f, 0.7f, 0.6f, 0.6f, 0.5f, 0.5f};
+    float maxDelays[10]{500, 500, 1000, 1000, 2600, 2600, 8000, 8000, 10000, 10000};
+    for (int i = 0; i < 10; ++i)
+    {
+      allpasses[i].mGain = gains[i];
+      allpasses[i].setMaxDelayInSamples(maxDelays[i]);
+    }
+    delayL.setMaxDelayInSamples(3500.f);
+    delayR.setMaxDelayInSamples(3500.f);
+  }
+
+  // process the input with the delay times scaled by size, in samples.
+  DSPVector operator()(const DSPVector x, const DSPVector size)
+  {
+    float scales[10]{0.00476f, 0.00358f, 0.00973f, 0.0083f, 0.029f,
+                     0.021f,   0.078f,   0.09f,    0.111f,  0.096f};
+    DSPVector t[10];
+    for (int i = 0; i < 10; ++i)
+    {
+      t[i] = max(size * DSPVector(scales[i]), DSPVector(kFloatsPerDSPVector));
+    }
+    auto& ap = allpasses;
+    DSPVector diffused = ap[3](ap[2](ap[1](ap[0](x, t[0]), t[1]), t[2]), t[3]);
+    DSPVector vMin(kFloatsPerDSPVector);
+    DSPVector delayTimeL = max(size * DSPVector(0.0313f) - vMin, DSPVector(0.f));
+    DSPVector delayTimeR = max(size * DSPVector(0.0371f) - vMin, DSPVector(0.f));
+    DSPVector tapL = ap[6](ap[4](diffused + delayL(feedbackL, delayTimeL), t[4]), t[6]);
+    DSPVector tapR = ap[7](ap[5](diffused + delayR(feedbackR, delayTimeR), t[5]), t[7]);
+    feedbackR = ap[8](tapL, t[8]) * DSPVector(0.8f);
+    feedbackL = ap[9](tapR, t[9]) * DSPVector(0.8f);
+    return tapL + tapR;
+  }
+};
+}  // namespace
+
+TEST_CASE("madronalib/core/dsp_filters/pitchbendable", "[dsp_filters][pitchbendable]")
+{
+  // the reverb should match the reference through modulated, static and
+  // modulated again delay times.
+  AaltoverbTopology<PitchbendableDelay> reverb;
+  AaltoverbTopology<TwoFractionalDelays> reference;
+  RandomScalarSource noise;
+  float maxDifference{0.f}, maxOutput{0.f};
+  for (int i = 0; i < 300; ++i)
+  {
+    DSPVector x = map([&]() { return noise.getFloat(); }, DSPVector());
+    DSPVector t = columnIndex() + DSPVector(i * kFloatsPerDSPVector);
+    DSPVector size{24000.f};
+    if ((i < 100) || (i >= 200))
+    {
+      size += sin(t * DSPVector(0.0001f)) * DSPVector(2000.f);
+    }
+    DSPVector y = reverb(x, size);
+    DSPVector yRef = reference(x, size);
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      maxDifference = std::max(maxDifference, fabsf(y[n] - yRef[n]));
+      maxOutput = std::max(maxOutput, fabsf(yRef[n]));
+    }
+  }
+  REQUIRE(maxDifference < maxOutput * 1e-5f);
+
+  // delays of less than two samples have large allpass coefficients, so the
+  // heads converge slowly after the delay time stops changing. Start with a
+  // constant delay of 0, which is the reverb's with 256-sample vectors.
+  PitchbendableDelay shortDelay;
+  TwoFractionalDelays shortReference;
+  shortDelay.setMaxDelayInSamples(100.f);
+  shortReference.setMaxDelayInSamples(100.f);
+  float maxShortDifference{0.f};
+  for (int i = 0; i < 60; ++i)
+  {
+    DSPVector x = map([&]() { return noise.getFloat(); }, DSPVector());
+    DSPVector t = columnIndex() + DSPVector(i * kFloatsPerDSPVector);
+    DSPVector delay{(i < 50) ? 0.f : 0.3f};
+    if ((i >= 20) && (i < 40))
+    {
+      delay += (sin(t * DSPVector(0.7f)) + DSPVector(1.f)) * DSPVector(0.75f);
+    }
+    DSPVector y = shortDelay(x, delay);
+    DSPVector yRef = shortReference(x, delay);
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      maxShortDifference = std::max(maxShortDifference, fabsf(y[n] - yRef[n]));
+    }
+  }
+  REQUIRE(maxShortDifference < 1e-5f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/pitchbendable_timing",
+          "[dsp_filters][pitchbendable][.timing]")
+{
+  // time the reverb with static and modulated delay times.
+  AaltoverbTopology<PitchbendableDelay> reverb;
+  AaltoverbTopology<TwoFractionalDelays> reference;
+  DSPVector x{columnIndex()};
+  DSPVector staticSize{24000.f};
+  float sizeOffset{0.f};
+  auto modulatedSize = [&]() {
+    sizeOffset = (sizeOffset < 1000.f) ? sizeOffset + 0.1f : 0.f;
+    return DSPVector(24000.f + sizeOffset) + columnIndex() * DSPVector(0.001f);
+  };
+  auto staticFn = [&]() { return reverb(x, staticSize); };
+  auto modulatedFn = [&]() { return reverb(x, modulatedSize()); };
+  auto referenceStaticFn = [&]() { return reference(x, staticSize); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto staticTime = timeIterationsInThread<DSPVector>(staticFn);
+  auto modulatedTime = timeIterationsInThread<DSPVector>(modulatedFn);
+  auto referenceTime = timeIterationsInThread<DSPVector>(referenceStaticFn);
+#else
+  auto staticTime = timeIterations<DSPVector>(staticFn);
+  auto modulatedTime = timeIterations<DSPVector>(modulatedFn);
+  auto referenceTime = timeIterations<DSPVector>(referenceStaticFn);
+#endif
+  std::cout << "reverb ns: static " << staticTime.ns << ", modulated " << modulatedTime.ns
+            << ", two fractional delays " << referenceTime.ns << "\n";
+}
+
+namespace
+{
+// a feedback delay network computed one sample at a time, with the matrix
+// multiplied out in full, for reference.
+template <int SIZE, int OUTPUTS>
+struct ReferenceFDN
+{
+  std::array<std::vector<float>, SIZE> lines;
+  std::array<int, SIZE> delays;
+  std::array<float, SIZE> a0, b1, gains, filterState{};
+  std::array<std::array<float, SIZE>, SIZE> matrix;
+  std::array<std::array<float, SIZE>, OUTPUTS> outputGains;
+  int t{0};
+
+  std::array<float, OUTPUTS> operator()(float x)
+  {
+    std::array<float, SIZE> o;
+    for (int n = 0; n < SIZE; ++n)
+    {
+      o[n] = (t >= delays[n]) ? lines[n][t - delays[n]] : 0.f;
+    }
+    std::array<float, OUTPUTS> y{};
+    for (int j = 0; j < OUTPUTS; ++j)
+    {
+      for (int n = 0; n < SIZE; ++n)
+      {
+        y[j] += outputGains[j][n] * o[n];
+      }
+    }
+    for (int m = 0; m < SIZE; ++m)
+    {
+      float mixed{0.f};
+      for (int n = 0; n < SIZE; ++n)
+      {
+        mixed += matrix[m][n] * o[n];
+      }
+      filterState[m] = a0[m] * mixed + b1[m] * filterState[m];
+      lines[m].push_back(filterState[m] * gains[m] + x);
+    }
+    t++;
+    return y;
+  }
+};
+
+// run an FDN and the reference with the same settings, and return the
+// largest difference relative to the largest output.
+template <int SIZE, int OUTPUTS, FDNMatrix MATRIX, typename DELAY_TYPE>
+float compareFDN(FDN<SIZE, DELAY_TYPE, OUTPUTS, MATRIX>& fdn)
+{
+  ReferenceFDN<SIZE, OUTPUTS> ref;
+  std::array<float, SIZE> times, omegas;
+  for (int n = 0; n < SIZE; ++n)
+  {
+    times[n] = ref.delays[n] = kFloatsPerDSPVector + 37 + 29 * n;
+    omegas[n] = 0.05f + 0.01f * n;
+    auto c = OnePole::coeffs(omegas[n]);
+    ref.a0[n] = c.a0;
+    ref.b1[n] = c.b1;
+    ref.gains[n] = fdn.mFeedbackGains[n] = 0.95f - 0.01f * n;
+    for (int m = 0; m < SIZE; ++m)
+    {
+      if (MATRIX == FDNMatrix::householder)
+      {
+        ref.matrix[m][n] = (m == n) - 2.f / SIZE;
+      }
+      else
+      {
+        // the sign of the Hadamard element is the parity of the bits in m & n.
+        int bits = m & n, parity = 0;
+        for (; bits; bits >>= 1) parity ^= (bits & 1);
+        ref.matrix[m][n] = (parity ? -1.f : 1.f) / sqrtf(SIZE);
+      }
+    }
+  }
+  ref.outputGains = fdn.mOutputGains;
+  fdn.setFilterCutoffs(omegas);
+  constexpr bool kConstantDelays = std::is_same<DELAY_TYPE, IntegerDelay>::value;
+  if constexpr (kConstantDelays)
+  {
+    fdn.setDelaysInSamples(times);
+  }
+
+  std::array<DSPVector, SIZE> delayVectors;
+  DSPVectorArray<SIZE> vDelayTimes;
+  for (int n = 0; n < SIZE; ++n)
+  {
+    std::fill(vDelayTimes.getRowData(n), vDelayTimes.getRowData(n) + kFloatsPerDSPVector,
+              times[n]);
+  }
+
+  float maxDifference{0.f}, maxOutput{0.f};
+  for (int i = 0; i < 100; ++i)
+  {
+    DSPVector x;
+    if (i == 0) x[0] = 1.f;
+    DSPVectorArray<OUTPUTS> y;
+    if constexpr (kConstantDelays)
+    {
+      y = fdn(x);
+    }
+    else
+    {
+      y = fdn(x, vDelayTimes);
+    }
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      auto yRef = ref(x[n]);
+      for (int j = 0; j < OUTPUTS; ++j)
+      {
+        float yj = y[j * kFloatsPerDSPVector + n];
+        maxDifference = std::max(maxDifference, fabsf(yj - yRef[j]));
+        maxOutput = std::max(maxOutput, fabsf(yRef[j]));
+      }
+    }
+  }
+  return maxDifference / maxOutput;
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/dsp_filters/fdn", "[dsp_filters][fdn]")
+{
+  // compare the impulse responses of FDNs with both matrices to the reference.
+  FDN<8, IntegerDelay, 3, FDNMatrix::householder> householder8;
+  FDN<8, IntegerDelay, 3, FDNMatrix::hadamard> hadamard8;
+  FDN<5, IntegerDelay, 2, FDNMatrix::householder> householder5;
+  FDN<16, IntegerDelay, 4, FDNMatrix::hadamard> hadamard16;
+  REQUIRE(compareFDN(householder8) < 1e-4f);
+  REQUIRE(compareFDN(hadamard8) < 1e-4f);
+  REQUIRE(compareFDN(householder5) < 1e-4f);
+  REQUIRE(compareFDN(hadamard16) < 1e-4f);
+
+  // with whole delay times, modulatable delays should give the same result.
+  FDN<8, PitchbendableDelay, 2, FDNMatrix::hadamard> pitchbendable8;
+  pitchbendable8.setMaxDelayInSamples(1000.f);
+  REQUIRE(compareFDN(pitchbendable8) < 1e-4f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_filters/fdn_timing", "[dsp_filters][fdn][.timing]")
+{
+  // time 16 and 32 line FDNs with each matrix, and a 16 line FDN with
+  // modulated delays.
+  DSPVector x{columnIndex()};
+  FDN<16, IntegerDelay, 2, FDNMatrix::householder> fdn16;
+  FDN<32, IntegerDelay, 2, FDNMatrix::householder> fdn32;
+  FDN<32, IntegerDelay, 2, FDNMatrix::hadamard> hadamardFdn32;
+  FDN<16, PitchbendableDelay, 2, FDNMatrix::hadamard> modulatedFdn16;
+  std::array<float, 16> times16;
+  std::array<float, 32> times32;
+  for (int n = 0; n < 32; ++n)
+  {
+    if (n < 16) times16[n] = 1000 + 97 * n;
+    times32[n] = 1000 + 97 * n;
+  }
+  fdn16.setDelaysInSamples(times16);
+  fdn32.setDelaysInSamples(times32);
+  hadamardFdn32.setDelaysInSamples(times32);
+  modulatedFdn16.setMaxDelayInSamples(3000.f);
+  float phase{0.f};
+  auto modulatedTimes = [&]() {
+    phase += 0.001f;
+    DSPVectorArray<16> t = repeatRows<16>(DSPVector(1000.f + 10.f * sinf(phase)));
+    return t + map([](DSPVector v, int row) { return v * DSPVector(row); },
+                   repeatRows<16>(DSPVector(97.f)));
+  };
+  auto fdn16Fn = [&]() { return fdn16(x); };
+  auto fdn32Fn = [&]() { return fdn32(x); };
+  auto hadamardFdn32Fn = [&]() { return hadamardFdn32(x); };
+  auto modulatedFdn16Fn = [&]() { return modulatedFdn16(x, modulatedTimes()); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto fdn16Time = timeIterationsInThread<DSPVectorArray<2>>(fdn16Fn);
+  auto fdn32Time = timeIterationsInThread<DSPVectorArray<2>>(fdn32Fn);
+  auto hadamardFdn32Time = timeIterationsInThread<DSPVectorArray<2>>(hadamardFdn32Fn);
+  auto modulatedFdn16Time = timeIterationsInThread<DSPVectorArray<2>>(modulatedFdn16Fn);
+#else
+  auto fdn16Time = timeIterations<DSPVectorArray<2>>(fdn16Fn);
+  auto fdn32Time = timeIterations<DSPVectorArray<2>>(fdn32Fn);
+  auto hadamardFdn32Time = timeIterations<DSPVectorArray<2>>(hadamardFdn32Fn);
+  auto modulatedFdn16Time = timeIterations<DSPVectorArray<2>>(modulatedFdn16Fn);
+#endif
+  std::cout << "FDN ns: 16 lines " << fdn16Time.ns << ", 32 lines " << fdn32Time.ns
+            << ", 32 lines Hadamard " << hadamardFdn32Time.ns << ", 16 modulated lines "
+            << modulatedFdn16Time.ns << "\n";
+}
@@ -6,7 +6,9 @@
 
 #include "catch.hpp"
 #include "testUtils.h"
+#include "opFamilies.h"
 #include "MLDSPOps.h"
+#include "MLDSPExpressions.h"
 #include "MLDSPFunctional.h"
 #include "MLDSPUtils.h"
 #include "MLDSPRouting.h"
@@ -15,6 +17,24 @@
 using namespace ml;
 using namespace testUtils;
 
+// one representative of each op family, with the DSPVector ops of the backend in use.
+// The kernels in opFamilies.h compute the same things with the vec* primitives.
+using OpFamilyFunctions = std::vector<std::pair<std::string, std::function<DSPVector(void)> > >;
+OpFamilyFunctions opFamilyFunctions(const DSPVector& a, const DSPVector& b)
+{
+  return {{"op1", [&]() { return sqrt(abs(a)); }},
+          {"op1 transcendental", [&]() { return sin(a); }},
+          {"op2", [&]() { return a * b + a; }},
+          {"op3",
+           [&]() {
+             return clamp(lerp(a, b, DSPVector(0.5f)), DSPVector(-1.f), DSPVector(1.f));
+           }},
+          {"convert", [&]() { return intToFloat(roundFloatToInt(a * b)); }},
+          {"select", [&]() { return select(a, b, greaterThan(a, b)); }},
+          {"rotate", [&]() { return rotateLeft(a) + rotateRight(b); }},
+          {"horizontal", [&]() { return DSPVector(sum(a * b)); }}};
+}
+
 TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
 {
   DSPVector a(rangeClosed(-kPi, kPi));
@@ -145,6 +165,43 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
     }
   }
 
+  SECTION("op families")
+  {
+    // the op family kernels are timed by the hidden tests "families_timing" and
+    // "families_sse_avx2" below. Here, just check their results.
+    DSPVector b(columnIndex());
+    auto families = opFamilyFunctions(a, b);
+
+    // each backend's kernels should compute the same results as the DSPVector ops.
+    for (auto results : {timeOpFamiliesSSE(), timeOpFamiliesAVX2()})
+    {
+      if (results.empty()) continue;
+      REQUIRE(results.size() == families.size());
+      for (size_t i = 0; i < families.size(); ++i)
+      {
+        DSPVector expected = families[i].second();
+        float maxDiff{0.f};
+        for (size_t j = 0; j < kFloatsPerDSPVector; ++j)
+        {
+          float diff = fabsf(results[i].output[j] - expected[j]);
+          maxDiff = std::max(maxDiff, diff / std::max(fabsf(expected[j]), 1.f));
+        }
+        REQUIRE(maxDiff < 1e-4f);
+      }
+    }
+
+    // the shuffles are backend-specific, so check them here too.
+    DSPVector left = rotateLeft(b);
+    DSPVector right = rotateRight(b);
+    bool rotateOK{true};
+    for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      rotateOK &= (left[i] == (i + 1) % kFloatsPerDSPVector);
+      rotateOK &= (right[i] == (i + kFloatsPerDSPVector - 1) % kFloatsPerDSPVector);
+    }
+    REQUIRE(rotateOK);
+  }
+
   SECTION("lerp")
   {
     // lerp with constant mix value
@@ -186,6 +243,19 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
 
     REQUIRE(c == d);
     REQUIRE(d == e);
+
+    // std::function arguments use the original overloads
+    std::function<float(float)> timesTwo = [](float x) { return x * 2.f; };
+    REQUIRE(map(timesTwo, a) == c);
+  }
+
+  SECTION("map std::function")
+  {
+    // map a cheap function with a template callable and through std::function.
+    DSPVector x{columnIndex()};
+    auto fn = [](float f) { return f * 0.5f + 1.f; };
+    std::function<float(float)> stdFn = fn;
+    REQUIRE(map(fn, x) == map(stdFn, x));
   }
 
   SECTION("row operations")
@@ -293,6 +363,526 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
   }
 }
 
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/map_timing", "[dsp_ops][.timing]")
+{
+  // map a cheap function with a template callable and through std::function.
+  DSPVector x{columnIndex()};
+  auto fn = [](float f) { return f * 0.5f + 1.f; };
+  std::function<float(float)> stdFn = fn;
+
+  auto inlineMap = [&]() { return map(fn, x); };
+  auto stdFunctionMap = [&]() { return map(stdFn, x); };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto inlineTime = timeIterationsInThread<DSPVector>(inlineMap);
+  auto stdFunctionTime = timeIterationsInThread<DSPVector>(stdFunctionMap);
+#else
+  auto inlineTime = timeIterations<DSPVector>(inlineMap);
+  auto stdFunctionTime = timeIterations<DSPVector>(stdFunctionMap);
+#endif
+  std::cout << "map ns per sample: template " << inlineTime.ns / kFloatsPerDSPVector
+            << ", std::function " << stdFunctionTime.ns / kFloatsPerDSPVector << "\n";
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/families_timing", "[dsp_ops][.timing]")
+{
+  // time one representative of each op family with the backend in use.
+  DSPVector a(rangeClosed(-kPi, kPi));
+  DSPVector b(columnIndex());
+  std::cout << "op families, ns per DSPVector, " << kFloatsPerSIMDVector
+            << " floats per SIMD vector:\n";
+  for (auto& family : opFamilyFunctions(a, b))
+  {
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+    TimedResult<DSPVector> fnTime = timeIterationsInThread<DSPVector>(family.second);
+#else
+    TimedResult<DSPVector> fnTime = timeIterations<DSPVector>(family.second);
+#endif
+    std::cout << "  " << family.first << ": " << fnTime.ns << "\n";
+  }
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/families_sse_avx2", "[dsp_ops][.timing]")
+{
+  // time the same op family kernels built for SSE and for AVX2 in this binary,
+  // so the AVX2 speedup can be checked on one machine in one run.
+  auto sse = timeOpFamiliesSSE();
+  auto avx2 = timeOpFamiliesAVX2();
+  if (sse.empty())
+  {
+    std::cout << "op families: SSE is not available on this target.\n";
+    return;
+  }
+  if (avx2.empty())
+  {
+    std::cout << "op families: AVX2 is not available, SSE only.\n";
+  }
+  REQUIRE((avx2.empty() || (avx2.size() == sse.size())));
+
+  std::cout << "op families, ns per DSPVector of " << kFloatsPerDSPVector << " floats:\n";
+  for (size_t i = 0; i < sse.size(); ++i)
+  {
+    std::cout << "  " << sse[i].name << ": SSE " << sse[i].ns;
+    if (!avx2.empty())
+    {
+      std::cout << ", AVX2 " << avx2[i].ns << ", speedup " << sse[i].ns / avx2[i].ns;
+    }
+    std::cout << "\n";
+  }
+}
+
+// error of y in units in the last place of the reference value. References
+// smaller than 2^-10 are measured in ULPs of 2^-10, because near the zeros of
+// sin and cos the absolute error of range reduction dominates.
+inline float ulpError(float y, double ref)
+{
+  float r = std::max(std::fabs((float)ref), 1.f / 1024.f);
+  float ulp = std::nextafter(r, INFINITY) - r;
+  return (float)(std::fabs(y - ref) / ulp);
+}
+
+// a function with a tier for each Accuracy, its reference, and the test points to check.
+struct TieredFunction
+{
+  std::string name;
+  std::function<double(double)> reference;
+  std::function<float(int)> testPoint;
+  std::array<std::function<DSPVector(const DSPVector&)>, 3> tiers;
+  std::array<float, 3> maxUlps;
+};
+
+constexpr int kAccuracyTestVectors = 256;
+constexpr int kAccuracyTestPoints = kAccuracyTestVectors * kFloatsPerDSPVector;
+const char* kTierNames[3]{"low", "medium", "full"};
+
+std::vector<TieredFunction> tieredFunctions()
+{
+  auto linearPoints = [&](float a, float b) {
+    return [=](int i) { return a + (b - a) * i / (kAccuracyTestPoints - 1.f); };
+  };
+  auto logPoints = [&](float a, float b) {
+    return [=](int i) { return a * powf(b / a, i / (kAccuracyTestPoints - 1.f)); };
+  };
+
+  // the tested ranges and maximum ULP errors here match the table in MLDSPMathTiered.h.
+  return {{"sin",
+           [](double x) { return std::sin(x); },
+           linearPoints(-kPi, kPi),
+           {[](const DSPVector& x) { return sin<Accuracy::low>(x); },
+            [](const DSPVector& x) { return sin<Accuracy::medium>(x); },
+            [](const DSPVector& x) { return sin<Accuracy::full>(x); }},
+           {2500, 25, 2}},
+          {"cos",
+           [](double x) { return std::cos(x); },
+           linearPoints(-kPi, kPi),
+           {[](const DSPVector& x) { return cos<Accuracy::low>(x); },
+            [](const DSPVector& x) { return cos<Accuracy::medium>(x); },
+            [](const DSPVector& x) { return cos<Accuracy::full>(x); }},
+           {2500, 25, 2}},
+          {"exp",
+           [](double x) { return std::exp(x); },
+           linearPoints(-20.f, 20.f),
+           {[](const DSPVector& x) { return exp<Accuracy::low>(x); },
+            [](const DSPVector& x) { return exp<Accuracy::medium>(x); },
+            [](const DSPVector& x) { return exp<Accuracy::full>(x); }},
+           {1500, 45, 2}},
+          {"log",
+           [](double x) { return std::log(x); },
+           logPoints(1e-6f, 1e6f),
+           {[](const DSPVector& x) { return log<Accuracy::low>(x); },
+            [](const DSPVector& x) { return log<Accuracy::medium>(x); },
+            [](const DSPVector& x) { return log<Accuracy::full>(x); }},
+           {400, 4, 2}},
+          {"tanh",
+           [](double x) { return std::tanh(x); },
+           linearPoints(-10.f, 10.f),
+           {[](const DSPVector& x) { return tanh<Accuracy::low>(x); },
+            [](const DSPVector& x) { return tanh<Accuracy::medium>(x); },
+            [](const DSPVector& x) { return tanh<Accuracy::full>(x); }},
+           {1500, 50, 2}}};
+}
+
+// return the max ULP error of one tier of fn over all its test points.
+// x is left holding the last DSPVector of test points.
+float maxUlpError(const TieredFunction& fn, int tier, DSPVector& x)
+{
+  float maxUlps{0.f};
+  for (int v = 0; v < kAccuracyTestVectors; ++v)
+  {
+    for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      x[i] = fn.testPoint(v * kFloatsPerDSPVector + i);
+    }
+    DSPVector y = fn.tiers[tier](x);
+    for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      maxUlps = std::max(maxUlps, ulpError(y[i], fn.reference(x[i])));
+    }
+  }
+  return maxUlps;
+}
+
+TEST_CASE("madronalib/core/dsp_ops/accuracy", "[dsp_ops][accuracy]")
+{
+  for (auto& fn : tieredFunctions())
+  {
+    for (int tier = 0; tier < 3; ++tier)
+    {
+      DSPVector x;
+      REQUIRE(maxUlpError(fn, tier, x) <= fn.maxUlps[tier]);
+    }
+  }
+
+  SECTION("pow")
+  {
+    // pow error grows with |y * log(x)|, so just check relative error over a small range.
+    DSPVector x(rangeClosed(0.1f, 10.f));
+    DSPVector y(rangeClosed(-2.f, 2.f));
+    std::array<DSPVector, 3> results{pow<Accuracy::low>(x, y), pow<Accuracy::medium>(x, y),
+                                     pow<Accuracy::full>(x, y)};
+    std::array<float, 3> maxRelErrors{1e-3f, 1e-5f, 1e-6f};
+    for (int tier = 0; tier < 3; ++tier)
+    {
+      float maxRelError{0.f};
+      for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        double ref = std::pow((double)x[i], (double)y[i]);
+        maxRelError = std::max(maxRelError, (float)std::fabs((results[tier][i] - ref) / ref));
+      }
+      REQUIRE(maxRelError < maxRelErrors[tier]);
+    }
+  }
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/accuracy_timing", "[dsp_ops][accuracy][.timing]")
+{
+  // print max ULP error and time per DSPVector for each accuracy tier.
+  std::cout << "accuracy tiers, max error and time per DSPVector:\n";
+  for (auto& fn : tieredFunctions())
+  {
+    std::cout << "  " << fn.name << ":";
+    for (int tier = 0; tier < 3; ++tier)
+    {
+      DSPVector x;
+      float maxUlps = maxUlpError(fn, tier, x);
+      auto timedFn = [&]() { return fn.tiers[tier](x); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+      TimedResult<DSPVector> t = timeIterationsInThread<DSPVector>(timedFn);
+#else
+      TimedResult<DSPVector> t = timeIterations<DSPVector>(timedFn);
+#endif
+      std::cout << "  " << kTierNames[tier] << " " << maxUlps << " ULPs " << t.ns << " ns";
+    }
+    std::cout << "\n";
+  }
+}
+
+TEST_CASE("madronalib/core/dsp_ops/saturators", "[dsp_ops][saturators]")
+{
+  DSPVector x(rangeClosed(-8.f, 8.f));
+  DSPVector yTanh = tanh(x);
+  DSPVector yTanhApprox = tanhApprox(x);
+  DSPVector ySoft = softclip(x);
+  DSPVector yHard = hardclip(x);
+  DSPVector yAsym = asymmetricSoftclip(x, DSPVector(-0.5f), DSPVector(2.f));
+
+  float maxTanhError{0.f}, maxTanhApproxError{0.f};
+  bool softInRange{true}, hardInRange{true}, asymInRange{true};
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    float ref = std::tanh(x[i]);
+    maxTanhError = std::max(maxTanhError, std::fabs(yTanh[i] - ref));
+    maxTanhApproxError = std::max(maxTanhApproxError, std::fabs(yTanhApprox[i] - ref));
+    softInRange &= (std::fabs(ySoft[i]) <= 1.f);
+    hardInRange &= (yHard[i] == ml::clamp(x[i], -1.f, 1.f));
+    asymInRange &= (yAsym[i] >= -0.5f) && (yAsym[i] <= 2.f);
+  }
+  REQUIRE(maxTanhError < 1e-6f);
+  REQUIRE(maxTanhApproxError < 2e-4f);
+  REQUIRE(softInRange);
+  REQUIRE(hardInRange);
+  REQUIRE(asymInRange);
+
+  // soft clips should be smooth through 0 and reach their limits
+  REQUIRE(softclip(DSPVector(1e-3f))[0] == Approx(1.5e-3f));
+  REQUIRE(softclip(DSPVector(-1.f))[0] == -1.f);
+  REQUIRE(asymmetricSoftclip(DSPVector(-4.f), DSPVector(-0.5f), DSPVector(2.f))[0] == -0.5f);
+  REQUIRE(asymmetricSoftclip(DSPVector(4.f), DSPVector(-0.5f), DSPVector(2.f))[0] == 2.f);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/saturators_timing", "[dsp_ops][saturators][.timing]")
+{
+  // compare to std::tanh on each sample
+  DSPVector x(rangeClosed(-8.f, 8.f));
+  auto scalarTanh = [&]() { return map([](float f) { return std::tanh(f); }, x); };
+  auto vectorTanh = [&]() { return tanh(x); };
+  auto vectorTanhApprox = [&]() { return tanhApprox(x); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto scalarTime = timeIterationsInThread<DSPVector>(scalarTanh);
+  auto vectorTime = timeIterationsInThread<DSPVector>(vectorTanh);
+  auto approxTime = timeIterationsInThread<DSPVector>(vectorTanhApprox);
+#else
+  auto scalarTime = timeIterations<DSPVector>(scalarTanh);
+  auto vectorTime = timeIterations<DSPVector>(vectorTanh);
+  auto approxTime = timeIterations<DSPVector>(vectorTanhApprox);
+#endif
+  std::cout << "tanh ns per DSPVector: std::tanh " << scalarTime.ns << ", tanh "
+            << vectorTime.ns << ", tanhApprox " << approxTime.ns << "\n";
+}
+
+// the per-sample scalar multiplexers that the SIMD versions replaced, for comparison.
+template <size_t N>
+inline DSPVector multiplexScalar(const DSPVector& selector, const std::array<DSPVector, N>& inputs)
+{
+  DSPVector y;
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    float s = selector[i];
+    size_t inputSafe = (s - truncf(s)) * N;
+    y[i] = inputs[inputSafe][i];
+  }
+  return y;
+}
+
+template <size_t N>
+inline DSPVector multiplexLinearScalar(const DSPVector& selector,
+                                       const std::array<DSPVector, N>& inputs)
+{
+  DSPVector y;
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    float s = selector[i];
+    float inputReal = (s - truncf(s)) * N;
+    float inputInt = truncf(inputReal);
+    size_t input1Safe = inputInt;
+    size_t input2Safe = (input1Safe + 1) % N;
+    y[i] = lerp(inputs[input1Safe][i], inputs[input2Safe][i], inputReal - inputInt);
+  }
+  return y;
+}
+
+// the SIMD and scalar multiplexers for N inputs, with the same inputs and selector.
+template <size_t N>
+struct MultiplexFunctions
+{
+  std::array<DSPVector, N> inputs;
+  DSPVector selector{rangeOpen(0.f, 3.f)};
+
+  MultiplexFunctions()
+  {
+    for (size_t k = 0; k < N; ++k)
+    {
+      inputs[k] = columnIndex() + DSPVector(k * 100.f);
+    }
+  }
+
+  DSPVector simd()
+  {
+    return std::apply([&](auto&... x) { return multiplex(selector, x...); }, inputs);
+  }
+  DSPVector simdLinear()
+  {
+    return std::apply([&](auto&... x) { return multiplexLinear(selector, x...); }, inputs);
+  }
+  DSPVector scalar() { return multiplexScalar(selector, inputs); }
+  DSPVector scalarLinear() { return multiplexLinearScalar(selector, inputs); }
+};
+
+// check that the SIMD multiplexers match the scalar ones for N inputs.
+template <size_t N>
+inline bool testMultiplex()
+{
+  MultiplexFunctions<N> f;
+  return (f.simd() == f.scalar()) && (f.simdLinear() == f.scalarLinear());
+}
+
+// print the time of the SIMD and scalar multiplexers for N inputs.
+template <size_t N>
+inline void timeMultiplex()
+{
+  MultiplexFunctions<N> f;
+  auto simdMux = [&]() { return f.simd(); };
+  auto simdMuxLinear = [&]() { return f.simdLinear(); };
+  auto scalarMux = [&]() { return f.scalar(); };
+  auto scalarMuxLinear = [&]() { return f.scalarLinear(); };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto simdTime = timeIterationsInThread<DSPVector>(simdMux);
+  auto scalarTime = timeIterationsInThread<DSPVector>(scalarMux);
+  auto simdLinearTime = timeIterationsInThread<DSPVector>(simdMuxLinear);
+  auto scalarLinearTime = timeIterationsInThread<DSPVector>(scalarMuxLinear);
+#else
+  auto simdTime = timeIterations<DSPVector>(simdMux);
+  auto scalarTime = timeIterations<DSPVector>(scalarMux);
+  auto simdLinearTime = timeIterations<DSPVector>(simdMuxLinear);
+  auto scalarLinearTime = timeIterations<DSPVector>(scalarMuxLinear);
+#endif
+  std::cout << "  " << N << " inputs: multiplex " << simdTime.ns << " (scalar "
+            << scalarTime.ns << "), multiplexLinear " << simdLinearTime.ns << " (scalar "
+            << scalarLinearTime.ns << ")\n";
+}
+
+TEST_CASE("madronalib/core/dsp_ops/routing", "[dsp_ops][routing]")
+{
+  REQUIRE(testMultiplex<2>());
+  REQUIRE(testMultiplex<3>());
+  REQUIRE(testMultiplex<4>());
+  REQUIRE(testMultiplex<8>());
+  REQUIRE(testMultiplex<16>());
+
+  // demultiplex, then multiplex with the same selector, over several rows
+  DSPVectorArray<3> input{map([](DSPVector v, int j) { return v + DSPVector(j * 100.f); },
+                              repeatRows<3>(columnIndex()))};
+  DSPVector selector{rangeOpen(0.f, 2.f)};
+  DSPVectorArray<3> a, b, c;
+  demultiplex(selector, input, &a, &b, &c);
+  REQUIRE(multiplex(selector, a, b, c) == input);
+  REQUIRE(add(a, b, c) == input);
+
+  demultiplexLinear(selector, input, &a, &b, &c);
+  auto sum = add(a, b, c);
+  float maxError{0.f};
+  for (size_t i = 0; i < kFloatsPerDSPVector * 3; ++i)
+  {
+    maxError = std::max(maxError, std::fabs(sum[i] - input[i]));
+  }
+  REQUIRE(maxError < 1e-4f);
+
+  // an output may alias the input.
+  DSPVectorArray<3> x{input}, y, z;
+  demultiplex(selector, input, &a, &b, &c);
+  demultiplex(selector, x, &x, &y, &z);
+  REQUIRE(x == a);
+  REQUIRE(y == b);
+  REQUIRE(z == c);
+
+  x = input;
+  demultiplexLinear(selector, input, &a, &b, &c);
+  demultiplexLinear(selector, x, &x, &y, &z);
+  REQUIRE(x == a);
+  REQUIRE(y == b);
+  REQUIRE(z == c);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/routing_timing", "[dsp_ops][routing][.timing]")
+{
+  std::cout << "multiplexers, ns per DSPVector:\n";
+  timeMultiplex<2>();
+  timeMultiplex<3>();
+  timeMultiplex<4>();
+  timeMultiplex<8>();
+  timeMultiplex<16>();
+}
+
+// operands for the expression tests.
+template <size_t ROWS>
+DSPVectorArray<ROWS> randomArray(RandomScalarSource& r)
+{
+  DSPVectorArray<ROWS> v;
+  for (size_t i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  {
+    v[i] = r.getFloat();
+  }
+  return v;
+}
+
+TEST_CASE("madronalib/core/dsp_ops/expressions", "[dsp_ops][expressions]")
+{
+  constexpr size_t kRows = 16;
+  RandomScalarSource r;
+  auto a = randomArray<kRows>(r);
+  auto b = randomArray<kRows>(r);
+  auto c = randomArray<kRows>(r);
+  auto d = randomArray<kRows>(r);
+  auto e = randomArray<kRows>(r);
+
+  SECTION("fused")
+  {
+    // with a lazy operand in each product, the whole chain is one expression
+    // that reads the arrays directly, with no temporary arrays.
+    using namespace expressions;
+    using Fused = decltype(lazy(a) * b + lazy(c) * d - e);
+    using FusedNode = Subtract<Add<Multiply<Vector, Vector>, Multiply<Vector, Vector>>, Vector>;
+    static_assert(std::is_same<Fused, DSPVectorExpression<kRows, FusedNode>>::value,
+                  "expected a fully fused expression");
+
+    // without one, c * d is computed eagerly into a temporary first.
+    using Mixed = decltype(lazy(a) * b + c * d - e);
+    using MixedNode = Subtract<Add<Multiply<Vector, Vector>, Vector>, Vector>;
+    static_assert(std::is_same<Mixed, DSPVectorExpression<kRows, MixedNode>>::value,
+                  "expected c * d to be an eager operand");
+  }
+
+  SECTION("exact")
+  {
+    // lazy results must be identical to the eager operators.
+    DSPVectorArray<kRows> eager = a * b + c * d - e;
+    DSPVectorArray<kRows> fused = lazy(a) * b + lazy(c) * d - e;
+    REQUIRE(fused == eager);
+    DSPVectorArray<kRows> mixed = lazy(a) * b + c * d - e;
+    REQUIRE(mixed == eager);
+
+    eager = (a - 0.5f) / (b + 2) * 3.f;
+    fused = (lazy(a) - 0.5f) / (lazy(b) + 2) * 3.f;
+    REQUIRE(fused == eager);
+
+    DSPVector eager1 = a.constRow(3) * b.constRow(3) + 1.f;
+    DSPVector fused1 = lazy(a.constRow(3)) * b.constRow(3) + 1.f;
+    REQUIRE(fused1 == eager1);
+
+    // assigning to an operand is OK because every operation is elementwise.
+    eager = c * (c + d);
+    c = lazy(c) * (lazy(c) + d);
+    REQUIRE(c == eager);
+  }
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/dsp_ops/expressions_timing", "[dsp_ops][expressions][.timing]")
+{
+  constexpr size_t kRows = 16;
+  RandomScalarSource r;
+  auto a = randomArray<kRows>(r);
+  auto b = randomArray<kRows>(r);
+  auto c = randomArray<kRows>(r);
+  auto d = randomArray<kRows>(r);
+  auto e = randomArray<kRows>(r);
+
+  auto eagerFn = [&]() { return DSPVectorArray<kRows>(a * b + c * d - e); };
+  auto mixedFn = [&]() { return DSPVectorArray<kRows>(lazy(a) * b + c * d - e); };
+  auto fusedFn = [&]() { return DSPVectorArray<kRows>(lazy(a) * b + lazy(c) * d - e); };
+  auto eagerFn1 = [&]() { return DSPVector(a.constRow(0) * b.constRow(0) + c.constRow(0)); };
+  auto fusedFn1 = [&]() {
+    return DSPVector(lazy(a.constRow(0)) * b.constRow(0) + c.constRow(0));
+  };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto eagerTime = timeIterationsInThread<DSPVectorArray<kRows>>(eagerFn);
+  auto mixedTime = timeIterationsInThread<DSPVectorArray<kRows>>(mixedFn);
+  auto fusedTime = timeIterationsInThread<DSPVectorArray<kRows>>(fusedFn);
+  auto eagerTime1 = timeIterationsInThread<DSPVector>(eagerFn1);
+  auto fusedTime1 = timeIterationsInThread<DSPVector>(fusedFn1);
+#else
+  auto eagerTime = timeIterations<DSPVectorArray<kRows>>(eagerFn);
+  auto mixedTime = timeIterations<DSPVectorArray<kRows>>(mixedFn);
+  auto fusedTime = timeIterations<DSPVectorArray<kRows>>(fusedFn);
+  auto eagerTime1 = timeIterations<DSPVector>(eagerFn1);
+  auto fusedTime1 = timeIterations<DSPVector>(fusedFn1);
+#endif
+
+  std::cout << "a*b + c*d - e, " << kRows << " rows, ns: eager " << eagerTime.ns
+            << ", lazy(a)*b + c*d - e " << mixedTime.ns << ", lazy(a)*b + lazy(c)*d - e "
+            << fusedTime.ns << "\n";
+  std::cout << "a*b + c, 1 row, ns: eager " << eagerTime1.ns << ", lazy " << fusedTime1.ns
+            << "\n";
+}
+
 TEST_CASE("madronalib/core/projections", "[projections]")
 {
   {
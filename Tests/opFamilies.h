@@ -0,0 +1,37 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// One representative kernel of each DSPVector op family, built once per x86
+// SIMD backend so that SSE and AVX2 can be timed and compared in the same
+// binary. The backend headers can't share a translation unit, so each backend
+// has its own: opFamiliesSSE.cpp and opFamiliesAVX2.cpp. This header is the
+// backend-neutral interface used by dspOpsTest.cpp.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace testUtils
+{
+struct OpFamilyResult
+{
+  std::string name;
+
+  // best time in nanoseconds for one DSPVector.
+  double ns;
+
+  // one DSPVector of output, to check the backends against each other.
+  std::vector<float> output;
+};
+
+// true if this binary was built with the given backend and the CPU can run it.
+bool haveOpFamiliesSSE();
+bool haveOpFamiliesAVX2();
+
+// time each op family. Returns nothing if the backend is not available.
+std::vector<OpFamilyResult> timeOpFamiliesSSE();
+std::vector<OpFamilyResult> timeOpFamiliesAVX2();
+
+}  // namespace testUtils
@@ -0,0 +1,59 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// the op family kernels from opFamilies.h built with the AVX2 backend, even
+// when the rest of the library is not. Only the functions in this file are
+// compiled for AVX2, so they are only run if the CPU supports it.
+
+#include "opFamilies.h"
+
+#if ((defined __x86_64__) || (defined __i386__)) && (defined __GNUC__)
+
+// include the standard headers before turning on AVX2, so that nothing they
+// define is compiled for AVX2 and shared with the rest of the binary.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <float.h>
+#include <iostream>
+#include <immintrin.h>
+
+#ifndef ML_DSP_VECTOR_BITS
+#define ML_DSP_VECTOR_BITS 6
+#endif
+
+constexpr size_t kFloatsPerDSPVector = 1 << ML_DSP_VECTOR_BITS;
+
+#if (defined __clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "MLDSPMathAVX.h"
+#include "opFamilyKernels.h"
+
+#if (defined __clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+bool testUtils::haveOpFamiliesAVX2() { return __builtin_cpu_supports("avx2"); }
+
+std::vector<testUtils::OpFamilyResult> testUtils::timeOpFamiliesAVX2()
+{
+  if (!haveOpFamiliesAVX2()) return {};
+  return timeOpFamilies();
+}
+
+#else
+
+bool testUtils::haveOpFamiliesAVX2() { return false; }
+
+std::vector<testUtils::OpFamilyResult> testUtils::timeOpFamiliesAVX2() { return {}; }
+
+#endif
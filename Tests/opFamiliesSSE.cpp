@@ -0,0 +1,40 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// the op family kernels from opFamilies.h built with the SSE backend,
+// whichever backend the rest of the library is using.
+
+#include "opFamilies.h"
+
+#if (defined __x86_64__) || (defined __i386__) || (defined _M_X64) || (defined _M_IX86)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#ifndef ML_DSP_VECTOR_BITS
+#define ML_DSP_VECTOR_BITS 6
+#endif
+
+constexpr size_t kFloatsPerDSPVector = 1 << ML_DSP_VECTOR_BITS;
+
+#include "MLDSPMathSSE.h"
+#include "opFamilyKernels.h"
+
+bool testUtils::haveOpFamiliesSSE() { return true; }
+
+std::vector<testUtils::OpFamilyResult> testUtils::timeOpFamiliesSSE()
+{
+  return timeOpFamilies();
+}
+
+#else
+
+bool testUtils::haveOpFamiliesSSE() { return false; }
+
+std::vector<testUtils::OpFamilyResult> testUtils::timeOpFamiliesSSE() { return {}; }
+
+#endif
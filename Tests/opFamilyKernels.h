@@ -0,0 +1,179 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// The op family kernels from opFamilies.h, written with the vec* primitives.
+// Include this once, after defining kFloatsPerDSPVector and including one
+// SIMD backend header. Everything here has internal linkage so that each
+// backend's translation unit gets its own copy.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include "opFamilies.h"
+
+namespace
+{
+using OpFamilyKernel = void (*)(const float*, const float*, float*);
+
+inline SIMDVectorFloat loadVector(const float* p, int n)
+{
+  return vecLoad(p + n * kFloatsPerSIMDVector);
+}
+
+inline void storeVector(float* p, int n, SIMDVectorFloat v)
+{
+  vecStore(p + n * kFloatsPerSIMDVector, v);
+}
+
+// sqrt(abs(a))
+void op1Kernel(const float* pa, const float*, float* py)
+{
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    storeVector(py, n, vecSqrt(vecAbs(loadVector(pa, n))));
+  }
+}
+
+// sin(a)
+void op1TranscendentalKernel(const float* pa, const float*, float* py)
+{
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    storeVector(py, n, vecSin(loadVector(pa, n)));
+  }
+}
+
+// a * b + a
+void op2Kernel(const float* pa, const float* pb, float* py)
+{
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorFloat a = loadVector(pa, n);
+    storeVector(py, n, vecAdd(vecMul(a, loadVector(pb, n)), a));
+  }
+}
+
+// clamp(lerp(a, b, 0.5), -1, 1)
+void op3Kernel(const float* pa, const float* pb, float* py)
+{
+  const SIMDVectorFloat half = vecSet1(0.5f);
+  const SIMDVectorFloat lo = vecSet1(-1.f);
+  const SIMDVectorFloat hi = vecSet1(1.f);
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorFloat a = loadVector(pa, n);
+    SIMDVectorFloat m = vecAdd(a, vecMul(half, vecSub(loadVector(pb, n), a)));
+    storeVector(py, n, vecClamp(m, lo, hi));
+  }
+}
+
+// intToFloat(roundFloatToInt(a * b))
+void convertKernel(const float* pa, const float* pb, float* py)
+{
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorInt i = vecFloatToIntRound(vecMul(loadVector(pa, n), loadVector(pb, n)));
+    storeVector(py, n, vecIntToFloat(i));
+  }
+}
+
+// select(a, b, greaterThan(a, b))
+void selectKernel(const float* pa, const float* pb, float* py)
+{
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorFloat a = loadVector(pa, n);
+    SIMDVectorFloat b = loadVector(pb, n);
+    storeVector(py, n, vecSelect(a, b, vecGreaterThan(a, b)));
+  }
+}
+
+// rotateLeft(a) + rotateRight(b)
+void rotateKernel(const float* pa, const float* pb, float* py)
+{
+  constexpr int v = kSIMDVectorsPerDSPVector;
+  for (int n = 0; n < v; ++n)
+  {
+    SIMDVectorFloat left = vecShuffleLeft(loadVector(pa, n), loadVector(pa, (n + 1) % v));
+    SIMDVectorFloat right = vecShuffleRight(loadVector(pb, (n + v - 1) % v), loadVector(pb, n));
+    storeVector(py, n, vecAdd(left, right));
+  }
+}
+
+// DSPVector(sum(a * b))
+void horizontalKernel(const float* pa, const float* pb, float* py)
+{
+  SIMDVectorFloat acc = vecMul(loadVector(pa, 0), loadVector(pb, 0));
+  for (int n = 1; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    acc = vecAdd(acc, vecMul(loadVector(pa, n), loadVector(pb, n)));
+  }
+  const SIMDVectorFloat sum = vecSet1(vecSumH(acc));
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    storeVector(py, n, sum);
+  }
+}
+
+// return the best time in nanoseconds of one kernel call over a few trials.
+double timeKernel(OpFamilyKernel kernel, const float* pa, const float* pb, float* py)
+{
+  constexpr int kTrials = 16;
+  constexpr int kIterations = 4096;
+  double best{1e30};
+  for (int t = 0; t < kTrials; ++t)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+      kernel(pa, pb, py);
+
+      // keep the compiler from hoisting the kernel out of the loop.
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    best = std::min(best, ns / kIterations);
+  }
+  return best;
+}
+
+std::vector<testUtils::OpFamilyResult> timeOpFamilies()
+{
+  // the same inputs as the "op families" test in dspOpsTest.cpp:
+  // a = rangeClosed(-kPi, kPi), b = columnIndex().
+  alignas(32) float a[kFloatsPerDSPVector];
+  alignas(32) float b[kFloatsPerDSPVector];
+  alignas(32) float y[kFloatsPerDSPVector];
+  const float pi = 3.14159265358979323846f;
+  for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    a[i] = -pi + 2.f * pi * i / (kFloatsPerDSPVector - 1);
+    b[i] = static_cast<float>(i);
+  }
+
+  const std::vector<std::pair<std::string, OpFamilyKernel> > kernels{
+      {"op1", op1Kernel},
+      {"op1 transcendental", op1TranscendentalKernel},
+      {"op2", op2Kernel},
+      {"op3", op3Kernel},
+      {"convert", convertKernel},
+      {"select", selectKernel},
+      {"rotate", rotateKernel},
+      {"horizontal", horizontalKernel}};
+
+  std::vector<testUtils::OpFamilyResult> results;
+  for (const auto& kernel : kernels)
+  {
+    double ns = timeKernel(kernel.second, a, b, y);
+    results.push_back({kernel.first, ns, std::vector<float>(y, y + kFloatsPerDSPVector)});
+  }
+  return results;
+}
+
+}  // namespace
@@ -5,6 +5,9 @@
 // a unit test made using the Catch framework in catch.hpp / tests.cpp.
 
 
+#include <cstring>
+#include <filesystem>
+
 #include "catch.hpp"
 #include "madronalib.h"
 #include "testUtils.h"
@@ -73,23 +76,127 @@ TEST_CASE("madronalib/core/symbol/threads", "[symbol][threads]")
   REQUIRE(theSymbolTable().getSize() == kThreadTestSize + 1);
 }
 
+// a dictionary of names and the IDs of their symbols.
+struct SymbolDictionary
+{
+  std::vector<std::string> names;
+  std::vector<SymbolID> ids;
+
+  SymbolDictionary(int nNames)
+  {
+    textUtils::NameMaker namer;
+    for (int i = 0; i < nNames; ++i)
+    {
+      names.push_back(namer.nextName().getText());
+      ids.push_back(Symbol(names.back().c_str()).getID());
+    }
+  }
+};
+
+// look up existing symbols from nThreads threads. Each lookup hashes the text
+// and compares it, as when making a Symbol from a char*. Returns the number of
+// lookups per second, or 0 if any lookup found the wrong symbol.
+double lookupFromThreads(const SymbolDictionary& dict, int nThreads, int lookupsPerThread)
+{
+  const int nNames = static_cast<int>(dict.names.size());
+  std::atomic<bool> allFound{true};
+  auto lookupFn = [&](int threadID) {
+    bool found{true};
+    for (int i = 0; i < lookupsPerThread; ++i)
+    {
+      int n = (i * 7 + threadID * 131) % nNames;
+      found &= (Symbol(dict.names[n].c_str()).getID() == dict.ids[n]);
+    }
+    if (!found) allFound = false;
+  };
+
+  myTimePoint start = now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nThreads; ++i)
+  {
+    threads.push_back(std::thread(lookupFn, i));
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed = now() - start;
+  return allFound ? nThreads * lookupsPerThread / elapsed.count() : 0.;
+}
+
+TEST_CASE("madronalib/core/symbol/lookup_threads", "[symbol][threads]")
+{
+  constexpr int kNames = 1024;
+  SymbolDictionary dict(kNames);
+  const auto& names = dict.names;
+  const auto& ids = dict.ids;
+
+  // look up existing symbols from each number of threads.
+  for (int nThreads : {1, 2, 4, 8, 16, 32})
+  {
+    REQUIRE(lookupFromThreads(dict, nThreads, kThreadTestSize * 4) > 0.);
+  }
+
+  // add new symbols from some threads while others look up existing ones. Each
+  // adding thread tries to add the same names.
+  size_t sizeBefore = theSymbolTable().getSize();
+  std::atomic<bool> allFound{true};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i)
+  {
+    threads.push_back(std::thread([&]() {
+      for (int j = 0; j < kThreadTestSize; ++j)
+      {
+        Symbol sym(("added" + std::to_string(j)).c_str());
+      }
+    }));
+    threads.push_back(std::thread([&, i]() {
+      for (int j = 0; j < kThreadTestSize * 4; ++j)
+      {
+        int n = (j + i * 131) % kNames;
+        if (Symbol(names[n].c_str()).getID() != ids[n]) allFound = false;
+      }
+    }));
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  REQUIRE(allFound);
+  REQUIRE(theSymbolTable().getSize() == sizeBefore + kThreadTestSize);
+  REQUIRE(theSymbolTable().audit());
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/symbol/lookup_threads_timing", "[symbol][threads][.timing]")
+{
+  constexpr int kLookupsPerThread = 100000;
+  SymbolDictionary dict(1024);
+  std::cout << "symbol lookups from threads:\n";
+  for (int nThreads : {1, 2, 4, 8, 16, 32})
+  {
+    double lookupsPerSecond = lookupFromThreads(dict, nThreads, kLookupsPerThread);
+    REQUIRE(lookupsPerSecond > 0.);
+    std::cout << "  " << nThreads << " threads: " << lookupsPerSecond << " lookups/s\n";
+  }
+}
+
 TEST_CASE("madronalib/core/collision", "[collision]")
 {
-  // nothing is checked here - these are two pairs of colliding symbols for
-  // reference with 12-bit hash:
+  // these are two pairs of colliding symbols with the 12-bit Kernighan &
+  // Ritchie hash used before, and a pair that collided in 16 bits.
+  REQUIRE(hash("KP") != hash("BAZ"));
+  REQUIRE(hash("KL") != hash("mse"));
+  REQUIRE(hash("FB") != hash("hombfbmohqqhombf"));
   Symbol a("KP");
   Symbol aa("BAZ");
-  Symbol b("KL");
-  Symbol bb("mse");
-  // 16-bit hash:
-  Symbol c("FB");
-  Symbol cc("hombfbmohqqhombf");
+  REQUIRE(a != aa);
 }
 
 template <size_t N>
-constexpr int hashTest1(const char (&sym)[N])
+constexpr uint32_t hashTest1(const char (&sym)[N])
 {
-  return krHash1<N>(sym);
+  return hash(sym);
 }
 
 TEST_CASE("madronalib/core/hashes", "[hashes]")
@@ -98,20 +205,201 @@ TEST_CASE("madronalib/core/hashes", "[hashes]")
   const char* str1("hello");
   const char* str2(u8"محمد بن سعيد");
 
-  constexpr int a1 = hashTest1("hello");
-  constexpr int a2 = hashTest1(u8"محمد بن سعيد");
+  constexpr uint32_t a1 = hashTest1("hello");
+  constexpr uint32_t a2 = hashTest1(u8"محمد بن سعيد");
 
-  int b1 = krHash0(str1, strlen(str1));
-  int b2 = krHash0(str2, strlen(str2));
+  uint32_t b1 = symbolHash(str1, strlen(str1));
+  uint32_t b2 = symbolHash(str2, strlen(str2));
 
   REQUIRE(a1 == b1);
   REQUIRE(a2 == b2);
-  
-  
+
+  // a symbol made from a HashedCharArray literal is the same as one made from
+  // its text at runtime.
+  REQUIRE(Symbol(HashedCharArray("hello")) == Symbol(str1));
+  REQUIRE(hash(Symbol(str1)) == b1);
+
   auto h = hash(Symbol());
   //std::cout << "hash of null symbol: " << h << "\n";
 }
 
+// clear the symbol table, then add new symbols until it holds 2^10, 2^15 and
+// 2^20 of them, calling fn(names, size, stats) at each size.
+template <typename Fn>
+void growSymbolTable(Fn fn)
+{
+  constexpr size_t kNumSymbols = 1 << 20;
+  textUtils::NameMaker namer;
+  std::vector<std::string> names;
+  names.reserve(kNumSymbols);
+  for (size_t i = 0; i < kNumSymbols; ++i)
+  {
+    names.push_back(namer.nextName().getText());
+  }
+
+  theSymbolTable().clear();
+  size_t nSymbols{0};
+  for (size_t size : {1 << 10, 1 << 15, 1 << 20})
+  {
+    for (; nSymbols < size; ++nSymbols)
+    {
+      Symbol sym(names[nSymbols].c_str());
+    }
+    fn(names, size, theSymbolTable().getStats());
+  }
+  REQUIRE(theSymbolTable().getSize() == kNumSymbols + 1);
+  theSymbolTable().clear();
+}
+
+// return the mean time in ns to look up an existing symbol from the first size names.
+double timeSymbolLookups(const std::vector<std::string>& names, size_t size)
+{
+  constexpr int kLookups = 100000;
+  RandomScalarSource randSource;
+  size_t idSum{0};
+  myTimePoint start = now();
+  for (int i = 0; i < kLookups; ++i)
+  {
+    size_t n = (randSource.getFloat() * 0.5f + 0.5f) * (size - 1);
+    idSum += Symbol(names[n].c_str()).getID();
+  }
+  std::chrono::duration<double> elapsed = now() - start;
+  REQUIRE(idSum > 0);
+  return elapsed.count() * 1e9 / kLookups;
+}
+
+TEST_CASE("madronalib/core/symbol/scaling", "[symbol][scaling]")
+{
+  // the cost of looking up existing symbols should not grow with the size of
+  // the table, so the probe lengths should stay short.
+  growSymbolTable([](const std::vector<std::string>&, size_t size, SymbolTable::Stats stats) {
+    REQUIRE(stats.symbols == size + 1);
+    REQUIRE(stats.slots >= size * 2);
+    REQUIRE(stats.meanProbeLength < 2.f);
+    REQUIRE(stats.maxProbeLength < 64);
+  });
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/symbol/scaling_timing", "[symbol][scaling][.timing]")
+{
+  growSymbolTable([](const std::vector<std::string>& names, size_t size,
+                     SymbolTable::Stats stats) {
+    std::cout << size << " symbols: " << timeSymbolLookups(names, size)
+              << " ns per lookup, " << stats.collisions << " collisions, "
+              << stats.hashCollisions << " hash collisions, probe length mean "
+              << stats.meanProbeLength << " max " << stats.maxProbeLength << "\n";
+  });
+}
+
+TEST_CASE("madronalib/core/symbol/image", "[symbol][image]")
+{
+  constexpr int kSymbols = 10000;
+  textUtils::NameMaker namer;
+  std::vector<std::string> names;
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    names.push_back(namer.nextName().getText());
+  }
+
+  // make a table, save its image and load it back. The names should have the
+  // same IDs as before.
+  theSymbolTable().clear();
+  std::vector<SymbolID> ids;
+  for (auto& name : names)
+  {
+    ids.push_back(Symbol(name.c_str()).getID());
+  }
+  std::string path = (std::filesystem::temp_directory_path() / "mlSymbolImageTest.bin").string();
+  REQUIRE(theSymbolTable().saveImage(path.c_str()));
+  auto image = theSymbolTable().getImage();
+
+  theSymbolTable().clear();
+  Symbol("notInTheImage");
+  REQUIRE(theSymbolTable().loadImage(path.c_str()));
+  REQUIRE(theSymbolTable().getSize() == kSymbols + 1);
+  bool sameIDs{true};
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    sameIDs &= (Symbol(names[i].c_str()).getID() == ids[i]);
+  }
+  REQUIRE(sameIDs);
+  REQUIRE(theSymbolTable().audit());
+
+  // new symbols are added after the ones in the image.
+  REQUIRE(Symbol("notInTheImage").getID() == kSymbols + 1);
+
+  // a truncated or unknown image is rejected and leaves the table cleared.
+  REQUIRE(!theSymbolTable().loadImage(image.data(), image.size() - 1));
+  REQUIRE(theSymbolTable().getSize() == 1);
+
+  // so is one in which an ID appears twice in the hash index, even though
+  // the number of used slots is right. The slots follow the 24-byte header.
+  std::vector<uint8_t> duplicated(image);
+  SymbolID firstID{0};
+  for (size_t i = 0; i < (1 << kInitialSymbolHashBits); ++i)
+  {
+    uint8_t* pSlot = duplicated.data() + 24 + i * sizeof(uint64_t);
+    uint64_t slot;
+    std::memcpy(&slot, pSlot, sizeof(slot));
+    if (!slot) continue;
+    if (!firstID)
+    {
+      firstID = HashIndex::slotID(slot);
+      continue;
+    }
+    slot = HashIndex::makeSlot(HashIndex::slotHash(slot), firstID);
+    std::memcpy(pSlot, &slot, sizeof(slot));
+    break;
+  }
+  REQUIRE(!theSymbolTable().loadImage(duplicated.data(), duplicated.size()));
+  REQUIRE(theSymbolTable().getSize() == 1);
+
+  image[0] = 'X';
+  REQUIRE(!theSymbolTable().loadImage(image.data(), image.size()));
+  REQUIRE(!theSymbolTable().loadImage("/nonexistent/mlSymbolImageTest.bin"));
+
+  std::filesystem::remove(path);
+  theSymbolTable().clear();
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/symbol/image_timing", "[symbol][image][.timing]")
+{
+  constexpr int kSymbols = 10000;
+  textUtils::NameMaker namer;
+  std::vector<std::string> names;
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    names.push_back(namer.nextName().getText());
+  }
+  theSymbolTable().clear();
+  for (auto& name : names)
+  {
+    Symbol sym(name.c_str());
+  }
+  std::string path = (std::filesystem::temp_directory_path() / "mlSymbolImageTest.bin").string();
+  REQUIRE(theSymbolTable().saveImage(path.c_str()));
+
+  // time loading the image against making the symbols from their names.
+  theSymbolTable().clear();
+  myTimePoint start = now();
+  REQUIRE(theSymbolTable().loadImage(path.c_str()));
+  std::chrono::duration<double> loadTime = now() - start;
+  theSymbolTable().clear();
+  start = now();
+  for (auto& name : names)
+  {
+    Symbol sym(name.c_str());
+  }
+  std::chrono::duration<double> makeTime = now() - start;
+  std::cout << kSymbols << " symbols: load image " << loadTime.count() * 1e6
+            << " us, make symbols " << makeTime.count() * 1e6 << " us\n";
+
+  std::filesystem::remove(path);
+  theSymbolTable().clear();
+}
+
 const char letters[24] = "abcdefghjklmnopqrstuvw";
 
 TEST_CASE("madronalib/core/symbol/maps", "[symbol]")
@@ -396,3 +684,158 @@ TEST_CASE("madronalib/core/symbol/path", "[symbol][path]")
   REQUIRE(!p.beginsWith(q));
   
 }
+
+// a tree of parameters for 16 voices, and a map with the same values from
+// the PathIDs of their paths.
+struct ParamTables
+{
+  std::vector<std::string> paths;
+  Tree<float> tree;
+  std::unordered_map<PathID, float> map;
+
+  ParamTables()
+  {
+    constexpr int kVoices = 16;
+    const char* params[]{"osc/freq", "osc/shape", "env/attack", "env/decay", "filter/cutoff"};
+    for (int v = 0; v < kVoices; ++v)
+    {
+      for (auto param : params)
+      {
+        std::string path = "voices/voice" + std::to_string(v) + "/" + param;
+        tree[Path(path.c_str())] = v;
+        map[PathID(path.c_str())] = v;
+        paths.push_back(path);
+      }
+    }
+  }
+};
+
+TEST_CASE("madronalib/core/symbol/path_id", "[symbol][path]")
+{
+  thePathTable().clear();
+
+  // literal paths are hashed at compile time to the same value as parsed ones.
+  constexpr HashedPath kOscPath("voices/voice1/osc");
+  static_assert(kOscPath.hash == pathTextHash("voices//voice1/osc/", 19));
+  REQUIRE(kOscPath.hash == pathHash(Path("voices/voice1/osc")));
+  REQUIRE(pathTextHash("", 0) == pathHash(Path()));
+
+  // each distinct path is interned once, however it is made.
+  PathID a(Path("voices/voice1/osc"));
+  PathID b(kOscPath);
+  PathID c("/voices//voice1/osc");
+  PathID d(Path(Path("voices"), Path("voice1"), Symbol("osc")));
+  REQUIRE(a);
+  REQUIRE(a == b);
+  REQUIRE(a == c);
+  REQUIRE(a == d);
+  REQUIRE(PathID("voices/voice1") != a);
+  REQUIRE(PathID("voices/voice1/osc/freq") != a);
+  REQUIRE(!PathID(Path()));
+  REQUIRE(!PathID(""));
+  REQUIRE(a.getPath() == Path("voices/voice1/osc"));
+  REQUIRE(thePathTable().getSize() == 4);
+
+  // make a tree of parameters and a map from their PathIDs.
+  ParamTables params;
+  REQUIRE(thePathTable().getSize() == 4 + params.paths.size() - 1);
+
+  // round trip each path through its ID.
+  for (auto& path : params.paths)
+  {
+    PathID id(path.c_str());
+    REQUIRE(id.getPath() == Path(path.c_str()));
+    REQUIRE(params.map[id] == params.tree[id.getPath()]);
+  }
+
+  // a literal path finds the same parameter.
+  constexpr HashedPath kFreqPath("voices/voice3/osc/freq");
+  REQUIRE(params.map[PathID(kFreqPath)] == 3.f);
+
+  thePathTable().clear();
+  REQUIRE(thePathTable().getSize() == 1);
+}
+
+// run with: tests "[.timing]"
+TEST_CASE("madronalib/core/symbol/path_id_timing", "[symbol][path][.timing]")
+{
+  thePathTable().clear();
+  ParamTables params;
+
+  // compare looking up the parameters by Path in the tree and by PathID.
+  constexpr int kLookups = 100000;
+  std::vector<Path> pathsToFind;
+  std::vector<PathID> idsToFind;
+  RandomScalarSource randSource;
+  for (int i = 0; i < kLookups; ++i)
+  {
+    size_t n = (randSource.getFloat() * 0.5f + 0.5f) * (params.paths.size() - 1);
+    pathsToFind.push_back(Path(params.paths[n].c_str()));
+    idsToFind.push_back(PathID(params.paths[n].c_str()));
+  }
+
+  float treeSum{0};
+  myTimePoint start = now();
+  for (auto& p : pathsToFind)
+  {
+    treeSum += params.tree[p];
+  }
+  std::chrono::duration<double> treeTime = now() - start;
+
+  float mapSum{0};
+  start = now();
+  for (auto id : idsToFind)
+  {
+    mapSum += params.map[id];
+  }
+  std::chrono::duration<double> mapTime = now() - start;
+
+  constexpr HashedPath kFreqPath("voices/voice3/osc/freq");
+  float internSum{0};
+  start = now();
+  for (int i = 0; i < kLookups; ++i)
+  {
+    internSum += params.map[PathID(kFreqPath)];
+  }
+  std::chrono::duration<double> internTime = now() - start;
+
+  std::cout << "Tree lookup: " << treeTime.count() * 1e9 / kLookups << " ns, PathID lookup: "
+            << mapTime.count() * 1e9 / kLookups << " ns, literal PathID lookup: "
+            << internTime.count() * 1e9 / kLookups << " ns\n";
+  REQUIRE(treeSum == mapSum);
+  REQUIRE(internSum == 3.f * kLookups);
+
+  thePathTable().clear();
+}
+
+TEST_CASE("madronalib/core/symbol/path_id_full", "[symbol][path]")
+{
+  // once the table is full, new paths get the null ID and existing ones are
+  // still found.
+  thePathTable().clear();
+  constexpr int kSide = 1 << 10;
+  static_assert(kSide * kSide >= kMaxPaths, "too few paths to fill the table");
+  std::vector<Path> heads, tails;
+  for (int i = 0; i < kSide; ++i)
+  {
+    heads.push_back(Path(("head" + std::to_string(i)).c_str()));
+    tails.push_back(Path(("tail" + std::to_string(i)).c_str()));
+  }
+  size_t nulls{0};
+  for (int i = 0; i < kSide; ++i)
+  {
+    for (int j = 0; j < kSide; ++j)
+    {
+      nulls += !PathID(Path(heads[i], tails[j]));
+    }
+  }
+  REQUIRE(thePathTable().getSize() == kMaxPaths);
+  REQUIRE(nulls == kSide * kSide - (kMaxPaths - 1));
+  REQUIRE(!PathID("another/path"));
+  REQUIRE(PathID(Path(heads[0], tails[1])).getPath() == Path("head0/tail1"));
+
+  // the paths hold symbols, so clearing the symbols clears the paths.
+  theSymbolTable().clear();
+  REQUIRE(thePathTable().getSize() == 1);
+  REQUIRE(PathID("head0/tail1").getID() == 1);
+}
@@ -5,9 +5,15 @@
 #pragma once
 
 #include "MLDSPOps.h"
+#include "MLDSPExpressions.h"
 #include "MLDSPFilters.h"
+#include "MLDSPFilterBanks.h"
+#include "MLDSPBlockFilters.h"
+#include "MLDSPFFT.h"
+#include "MLDSPConvolver.h"
 #include "MLDSPGens.h"
 #include "MLDSPBuffer.h"
+#include "MLDSPMirroredBuffer.h"
 #include "MLDSPFunctional.h"
 #include "MLDSPUtils.h"
 #include "MLDSPProjections.h"
@@ -0,0 +1,337 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPBlockFilters.h
+// Single-channel filters that compute each DSPVector of their recursion with
+// SIMD, for use in place of the scalar filters in MLDSPFilters.h.
+//
+// A linear filter with fixed coefficients can be written in state space form:
+//   y[n] = C s[n] + D x[n]
+//   s[n + 1] = A s[n] + B x[n]
+// BlockRecursion splits each DSPVector into one segment per SIMD lane and
+// runs the recursion for all of the segments at once, each starting from a
+// zero state. The true state at the start of each segment is then found by a
+// short serial pass over the segments, and its contribution C A^m s is added
+// to the output at each time m in the segment.
+//
+// The outputs match those of the scalar filters to within float rounding, but
+// are not bit-identical to them.
+
+#pragma once
+
+#include "MLDSPFilters.h"
+
+namespace ml
+{
+template <size_t ORDER>
+class BlockRecursion
+{
+ public:
+  using StateVector = std::array<float, ORDER>;
+  using StateMatrix = std::array<StateVector, ORDER>;
+
+ private:
+  static constexpr size_t kSegments = kFloatsPerSIMDVector;
+  static constexpr size_t kSegmentLength = kFloatsPerDSPVector / kSegments;
+
+  // the segments are moved in and out of SIMD lanes by transposing square
+  // blocks. When a segment is too short for that, use the scalar recursion.
+  static constexpr bool kUseSegments = (kSegmentLength % kFloatsPerSIMDVector == 0);
+
+  StateMatrix _a{};
+  StateVector _b{};
+  StateVector _c{};
+  float _d{0.f};
+
+  // A^kSegmentLength, used to carry the state from one segment to the next.
+  StateMatrix _aToSegmentLength{};
+
+  // the coefficients (C A^m) that give the output at each time m in a
+  // segment from the state at the start of the segment.
+  SIMDVectorFloat _outputFromState[kSegmentLength][ORDER];
+
+  StateVector _state{};
+
+  inline void processScalar(const float* px, float* py)
+  {
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float y = _d * px[n];
+      StateVector next{};
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        y += _c[i] * _state[i];
+        next[i] = _b[i] * px[n];
+        for (size_t j = 0; j < ORDER; ++j)
+        {
+          next[i] += _a[i][j] * _state[j];
+        }
+      }
+      _state = next;
+      py[n] = y;
+    }
+  }
+
+  inline void processSegments(const float* px, float* py)
+  {
+    // transpose the input so that x[m] has the sample at time m in each
+    // segment.
+    SIMDVectorFloat x[kSegmentLength];
+    for (size_t t = 0; t < kSegmentLength; t += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat* block = x + t;
+      for (size_t l = 0; l < kSegments; ++l)
+      {
+        block[l] = vecLoad(px + l * kSegmentLength + t);
+      }
+      vecTranspose(block);
+    }
+
+    // run the recursion from a zero state in each segment, writing the
+    // outputs over the inputs.
+    SIMDVectorFloat a[ORDER][ORDER], b[ORDER], c[ORDER], s[ORDER];
+    SIMDVectorFloat d = vecSet1(_d);
+    for (size_t i = 0; i < ORDER; ++i)
+    {
+      for (size_t j = 0; j < ORDER; ++j)
+      {
+        a[i][j] = vecSet1(_a[i][j]);
+      }
+      b[i] = vecSet1(_b[i]);
+      c[i] = vecSet1(_c[i]);
+      s[i] = vecZeros();
+    }
+    for (size_t m = 0; m < kSegmentLength; ++m)
+    {
+      SIMDVectorFloat xm = x[m];
+      SIMDVectorFloat y = vecMul(d, xm);
+      SIMDVectorFloat next[ORDER];
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        y = vecAdd(y, vecMul(c[i], s[i]));
+        next[i] = vecMul(b[i], xm);
+        for (size_t j = 0; j < ORDER; ++j)
+        {
+          next[i] = vecAdd(next[i], vecMul(a[i][j], s[j]));
+        }
+      }
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        s[i] = next[i];
+      }
+      x[m] = y;
+    }
+
+    // find the true state at the start of each segment, from the stored state
+    // and the zero-state end of each segment before it.
+    SIMDVectorFloat start[ORDER];
+    const float* zeroStateEnd[ORDER];
+    float* segmentStart[ORDER];
+    for (size_t i = 0; i < ORDER; ++i)
+    {
+      zeroStateEnd[i] = reinterpret_cast<const float*>(s + i);
+      segmentStart[i] = reinterpret_cast<float*>(start + i);
+    }
+    for (size_t l = 0; l < kSegments; ++l)
+    {
+      StateVector next{};
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        segmentStart[i][l] = _state[i];
+        next[i] = zeroStateEnd[i][l];
+        for (size_t j = 0; j < ORDER; ++j)
+        {
+          next[i] += _aToSegmentLength[i][j] * _state[j];
+        }
+      }
+      _state = next;
+    }
+
+    // add the response to the start state of each segment.
+    for (size_t m = 0; m < kSegmentLength; ++m)
+    {
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        x[m] = vecAdd(x[m], vecMul(_outputFromState[m][i], start[i]));
+      }
+    }
+
+    // transpose the output back.
+    for (size_t t = 0; t < kSegmentLength; t += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat* block = x + t;
+      vecTranspose(block);
+      for (size_t l = 0; l < kSegments; ++l)
+      {
+        vecStore(py + l * kSegmentLength + t, block[l]);
+      }
+    }
+  }
+
+ public:
+  BlockRecursion() { setCoeffs({}, {}, {}, 0.f); }
+
+  // set the matrices A, B, C and D of the recursion, and precompute the
+  // responses to the state at the start of a segment. The state is kept.
+  void setCoeffs(const StateMatrix& a, const StateVector& b, const StateVector& c, float d)
+  {
+    _a = a;
+    _b = b;
+    _c = c;
+    _d = d;
+
+    // accumulate the powers of A in double precision.
+    std::array<std::array<double, ORDER>, ORDER> p{}, q;
+    for (size_t i = 0; i < ORDER; ++i)
+    {
+      p[i][i] = 1.0;
+    }
+    for (size_t m = 0; m < kSegmentLength; ++m)
+    {
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        double ci{0.};
+        for (size_t j = 0; j < ORDER; ++j)
+        {
+          ci += _c[j] * p[j][i];
+        }
+        _outputFromState[m][i] = vecSet1(static_cast<float>(ci));
+      }
+      for (size_t i = 0; i < ORDER; ++i)
+      {
+        for (size_t j = 0; j < ORDER; ++j)
+        {
+          q[i][j] = 0.;
+          for (size_t k = 0; k < ORDER; ++k)
+          {
+            q[i][j] += p[i][k] * _a[k][j];
+          }
+        }
+      }
+      p = q;
+    }
+    for (size_t i = 0; i < ORDER; ++i)
+    {
+      for (size_t j = 0; j < ORDER; ++j)
+      {
+        _aToSegmentLength[i][j] = static_cast<float>(p[i][j]);
+      }
+    }
+  }
+
+  void clear() { _state.fill(0.f); }
+
+  StateVector getState() const { return _state; }
+  void setState(const StateVector& s) { _state = s; }
+
+  inline DSPVector operator()(const DSPVector& vx)
+  {
+    DSPVector vy;
+    if constexpr (kUseSegments)
+    {
+      processSegments(vx.getConstBuffer(), vy.getBuffer());
+    }
+    else
+    {
+      processScalar(vx.getConstBuffer(), vy.getBuffer());
+    }
+    return vy;
+  }
+};
+
+// BlockOnePole: a OnePole computed with BlockRecursion.
+
+class BlockOnePole
+{
+  BlockRecursion<1> _recursion;
+
+ public:
+  // set the coefficients for the cutoff omega, the frequency divided by the
+  // sample rate.
+  void setParams(float omega)
+  {
+    auto c = OnePole::coeffs(omega);
+    _recursion.setCoeffs({{{c.b1}}}, {c.a0}, {c.b1}, c.a0);
+  }
+
+  // jump to the new output value f without slewing there.
+  void reset(float f) { _recursion.setState({f}); }
+
+  void clear() { _recursion.clear(); }
+
+  inline DSPVector operator()(const DSPVector& vx) { return _recursion(vx); }
+};
+
+// BlockDCBlocker: a DCBlocker computed with BlockRecursion.
+
+class BlockDCBlocker
+{
+  // the state is the previous input and output.
+  BlockRecursion<2> _recursion;
+
+ public:
+  BlockDCBlocker() { setParams(0.045f); }
+
+  void setParams(float omega)
+  {
+    float r = DCBlocker::coeffs(omega);
+    _recursion.setCoeffs({{{0.f, 0.f}, {-1.f, r}}}, {1.f, 1.f}, {-1.f, r}, 1.f);
+  }
+
+  void clear() { _recursion.clear(); }
+
+  inline DSPVector operator()(const DSPVector& vx) { return _recursion(vx); }
+};
+
+// BlockSVF: a state variable filter with the coefficients of Lopass, giving
+// the output OUTPUT, computed with BlockRecursion.
+
+template <SVFOutput OUTPUT>
+class BlockSVF
+{
+  // the state is ic1eq and ic2eq of the scalar filters.
+  BlockRecursion<2> _recursion;
+
+ public:
+  // set the coefficients for a given omega and k. omega: the frequency
+  // divided by the sample rate. k: 1/Q, where k=0 is maximum resonance.
+  void setParams(float omega, float k)
+  {
+    auto c = Lopass::makeCoeffs(omega, k);
+    float g0 = c[Lopass::g0];
+    float g1 = c[Lopass::g1];
+    float g2 = c[Lopass::g2];
+
+    // v1 and v2 of the scalar filters, as functions of the state and input.
+    BlockRecursion<2>::StateVector c1{1.f + g1, -g0}, c2{g0, 1.f - g2};
+    float d1{g0}, d2{g2};
+
+    BlockRecursion<2>::StateMatrix a{{{1.f + 2.f * g1, -2.f * g0}, {2.f * g0, 1.f - 2.f * g2}}};
+    BlockRecursion<2>::StateVector b{2.f * g0, 2.f * g2};
+    if constexpr (OUTPUT == SVFOutput::lopass)
+    {
+      _recursion.setCoeffs(a, b, c2, d2);
+    }
+    else if constexpr (OUTPUT == SVFOutput::bandpass)
+    {
+      _recursion.setCoeffs(a, b, c1, d1);
+    }
+    else
+    {
+      // x - k * v1 - v2
+      BlockRecursion<2>::StateVector ch{-k * c1[0] - c2[0], -k * c1[1] - c2[1]};
+      _recursion.setCoeffs(a, b, ch, 1.f - k * d1 - d2);
+    }
+  }
+
+  void clear() { _recursion.clear(); }
+
+  inline DSPVector operator()(const DSPVector& vx) { return _recursion(vx); }
+};
+
+using BlockLopass = BlockSVF<SVFOutput::lopass>;
+using BlockBandpass = BlockSVF<SVFOutput::bandpass>;
+using BlockHipass = BlockSVF<SVFOutput::hipass>;
+
+}  // namespace ml
@@ -6,6 +6,11 @@
 // audio. Some nice implementation details are borrowed from Portaudio's
 // pa_ringbuffer by Phil Burk and others. C++11 atomics are used to implement
 // the lockfree algorithm.
+//
+// Where the platform allows, the data is mirrored in memory (see
+// MirroredBuffer), so that every read and write is to a single contiguous
+// region. The memory may then be larger than the capacity, but only the
+// capacity returned by resize() is ever used for data.
 
 #pragma once
 
@@ -13,6 +18,7 @@
 #include <atomic>
 #include <vector>
 
+#include "MLDSPMirroredBuffer.h"
 #include "MLDSPOps.h"
 
 namespace ml
@@ -20,7 +26,7 @@ namespace ml
 class DSPBuffer
 {
  private:
-  std::vector<float> mData;
+  MirroredBuffer<float> mData;
   float *mDataBuffer{nullptr};
   size_t mSize{0};
   size_t mDataMask{0};
@@ -57,9 +63,10 @@ class DSPBuffer
   inline DataRegions getDataRegions(size_t currentIdx, size_t elems) const
   {
     size_t startIdx = currentIdx & mDataMask;
-    if (startIdx + elems > mSize)
+    size_t dataSize = mDataMask + 1;
+    if (!mData.isMirrored() && (startIdx + elems > dataSize))
     {
-      size_t firstHalf = mSize - startIdx;
+      size_t firstHalf = dataSize - startIdx;
       size_t secondHalf = elems - firstHalf;
       return DataRegions{mDataBuffer + startIdx, firstHalf, mDataBuffer, secondHalf};
     }
@@ -75,21 +82,14 @@ class DSPBuffer
 
   DSPBuffer(const DSPBuffer &b)
   {
-    mSize = b.mSize;
-
-    try
-    {
-      mData = b.mData;
-    }
-    catch (const std::bad_alloc &)
-    {
-      mSize = mDataMask = mDistanceMask = 0;
-      return;
-    }
+    // on allocation failure, leave the buffer empty.
+    mData = b.mData;
+    if (!mData.size() || (mData.size() != b.mData.size())) return;
 
+    mSize = b.mSize;
     mDataBuffer = mData.data();
-    mDataMask = mSize - 1;
-    mDistanceMask = mSize * 2 - 1;
+    mDataMask = mData.size() - 1;
+    mDistanceMask = mData.size() * 2 - 1;
   }
 
   // clear the buffer.
@@ -108,18 +108,17 @@ class DSPBuffer
     int sizeBits = (int)ml::bitsToContain(sizeInSamples);
     mSize = std::max((1 << sizeBits), (int)kFloatsPerDSPVector);
 
-    try
-    {
-      mData.resize(mSize);
-    }
-    catch (const std::bad_alloc &)
+    // mirrored memory may be rounded up past mSize. The indices wrap at the
+    // size of the memory, while mSize limits the data in the buffer.
+    size_t dataSize = mData.resize(mSize);
+    if (!dataSize)
     {
       mSize = mDataMask = mDistanceMask = 0;
       return 0;
     }
 
     mDataBuffer = mData.data();
-    mDataMask = mSize - 1;
+    mDataMask = dataSize - 1;
 
     // The distance mask idea is based on code from PortAudio's ringbuffer by
     // Phil Burk. By keeping the read and write indices constrained to size*2
@@ -127,7 +126,7 @@ class DSPBuffer
     // distinguished from the empty state (write - read = 0).
     // getDataRegions() is always used to generate the raw data pointers for
     // reading / writing.
-    mDistanceMask = mSize * 2 - 1;
+    mDistanceMask = dataSize * 2 - 1;
 
     return mSize;
   }
@@ -0,0 +1,364 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPConvolver.h
+// Convolution with long impulse responses, using FFTs of partitions of the
+// impulse response.
+//
+// PartitionedConvolution convolves blocks of input with an impulse response
+// split into partitions of the block length, by the uniformly partitioned
+// overlap-save method: the spectrum of each input block is kept in a delay
+// line, and the spectrum of each output block is the sum of the products of
+// the spectra of the past input blocks with those of the partitions.
+//
+// Convolver splits the impulse response into three stages of increasing
+// partition size. The head, with partitions of one DSPVector, is computed on
+// the audio thread with each call. The two later stages have partitions of
+// 8 and 64 DSPVectors. Each stage starts at twice its partition length into
+// the impulse response, which gives each block of the later stages a whole
+// block period to be computed on a background worker thread. So the work on
+// the audio thread for each DSPVector is bounded by the head, no matter how
+// long the impulse response is.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MLDSPFFT.h"
+#include "MLDSPSample.h"
+
+namespace ml
+{
+// PartitionedConvolution: uniformly partitioned convolution with blocks of
+// ROWS / 2 DSPVectors.
+
+template <size_t ROWS>
+class PartitionedConvolution
+{
+  static_assert(ROWS >= 2, "PartitionedConvolution needs at least two rows");
+
+  static constexpr int kFFTSize = kFloatsPerDSPVector * ROWS;
+  static constexpr int kHalf = kFFTSize / 2;
+
+  using Spectrum = DSPVectorArray<ROWS>;
+
+  FFT<ROWS> _fft;
+
+  // the spectra of the partitions, and of the most recent input blocks.
+  std::vector<Spectrum> _partitions;
+  std::vector<Spectrum> _inputSpectra;
+  size_t _newestInput{0};
+
+  // the last two blocks of input, and work space.
+  Spectrum _window;
+  Spectrum _sum;
+  Spectrum _output;
+
+  // add the product of the packed spectra a and b to the packed spectrum y.
+  static inline void multiplyAdd(const Spectrum& a, const Spectrum& b, Spectrum& y)
+  {
+    const float* pa = a.getConstBuffer();
+    const float* pb = b.getConstBuffer();
+    float* py = y.getBuffer();
+
+    // bins 0 and N/2 are real, and are stored in place of the real and
+    // imaginary parts of bin 0. Compute them separately after the rest.
+    float dc = py[0] + pa[0] * pb[0];
+    float nyquist = py[kHalf] + pa[kHalf] * pb[kHalf];
+    for (int k = 0; k < kHalf; k += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat ar = vecLoad(pa + k);
+      SIMDVectorFloat ai = vecLoad(pa + kHalf + k);
+      SIMDVectorFloat br = vecLoad(pb + k);
+      SIMDVectorFloat bi = vecLoad(pb + kHalf + k);
+      SIMDVectorFloat re = vecSub(vecMul(ar, br), vecMul(ai, bi));
+      SIMDVectorFloat im = vecAdd(vecMul(ar, bi), vecMul(ai, br));
+      vecStore(py + k, vecAdd(vecLoad(py + k), re));
+      vecStore(py + kHalf + k, vecAdd(vecLoad(py + kHalf + k), im));
+    }
+    py[0] = dc;
+    py[kHalf] = nyquist;
+  }
+
+ public:
+  // the number of samples in each block of input and output.
+  static constexpr int kBlockLength = kHalf;
+
+  // set the impulse response to the length samples at ph. The input history is
+  // cleared. Allocates memory.
+  void setImpulse(const float* ph, size_t length)
+  {
+    size_t nPartitions = (length + kBlockLength - 1) / kBlockLength;
+    _partitions.resize(nPartitions);
+    _inputSpectra.resize(nPartitions);
+    Spectrum segment;
+    for (size_t p = 0; p < nPartitions; ++p)
+    {
+      // each partition is zero-padded to the FFT size.
+      size_t start = p * kBlockLength;
+      size_t end = std::min(start + kBlockLength, length);
+      segment = 0.f;
+      std::copy(ph + start, ph + end, segment.getBuffer());
+      _fft.forward(segment, _partitions[p]);
+    }
+    clear();
+  }
+
+  size_t getPartitions() const { return _partitions.size(); }
+
+  void clear()
+  {
+    for (auto& s : _inputSpectra)
+    {
+      s = 0.f;
+    }
+    _window = 0.f;
+    _newestInput = 0;
+  }
+
+  // convolve the next kBlockLength samples of input at px, writing the
+  // kBlockLength samples of output at the same times to py.
+  void process(const float* px, float* py)
+  {
+    size_t nPartitions = _partitions.size();
+    if (!nPartitions)
+    {
+      std::fill(py, py + kBlockLength, 0.f);
+      return;
+    }
+
+    // slide the new block into the window and store its spectrum.
+    float* pWindow = _window.getBuffer();
+    std::copy(pWindow + kBlockLength, pWindow + kFFTSize, pWindow);
+    std::copy(px, px + kBlockLength, pWindow + kBlockLength);
+    _newestInput = (_newestInput + 1) % nPartitions;
+    _fft.forward(_window, _inputSpectra[_newestInput]);
+
+    // sum the products of the input spectra with the partitions, pairing the
+    // newest input with the first partition.
+    _sum = 0.f;
+    size_t i = _newestInput;
+    for (size_t p = 0; p < nPartitions; ++p)
+    {
+      multiplyAdd(_inputSpectra[i], _partitions[p], _sum);
+      i = (i > 0) ? i - 1 : nPartitions - 1;
+    }
+
+    // the second half of the circular convolution is the valid output.
+    _fft.inverse(_sum, _output);
+    const float* pOutput = _output.getConstBuffer();
+    std::copy(pOutput + kBlockLength, pOutput + kFFTSize, py);
+  }
+};
+
+// Convolver: non-uniformly partitioned convolution of DSPVectors with an
+// impulse response, with no latency beyond the DSPVector.
+
+class Convolver
+{
+  // a later stage of the convolution, computed one block at a time either on
+  // the worker thread or, without a worker, on the calling thread.
+  template <size_t ROWS>
+  struct Stage
+  {
+    using Convolution = PartitionedConvolution<ROWS>;
+    static constexpr int kBlockLength = Convolution::kBlockLength;
+
+    Convolution convolution;
+
+    // the block of input being written and the block of output being read
+    // by the audio thread, and the blocks the current job reads and writes.
+    std::vector<float> input, output, jobInput, jobOutput;
+
+    // set by the audio thread when a job is posted, cleared by the worker
+    // when it is done.
+    std::atomic<bool> pending{false};
+
+    void setImpulse(const float* ph, size_t length)
+    {
+      convolution.setImpulse(ph, length);
+      for (auto* b : {&input, &output, &jobInput, &jobOutput})
+      {
+        b->assign(kBlockLength, 0.f);
+      }
+    }
+
+    void clear()
+    {
+      convolution.clear();
+      for (auto* b : {&input, &output, &jobInput, &jobOutput})
+      {
+        std::fill(b->begin(), b->end(), 0.f);
+      }
+    }
+
+    bool active() const { return convolution.getPartitions() > 0; }
+
+    void runJob() { convolution.process(jobInput.data(), jobOutput.data()); }
+
+    void waitForJob()
+    {
+      while (pending.load(std::memory_order_acquire))
+      {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  static constexpr size_t kHeadRows = 2;
+  static constexpr size_t kStage1Rows = kHeadRows * 8;
+  static constexpr size_t kStage2Rows = kStage1Rows * 8;
+
+  PartitionedConvolution<kHeadRows> _head;
+  Stage<kStage1Rows> _stage1;
+  Stage<kStage2Rows> _stage2;
+  uint64_t _vectorCount{0};
+
+  bool _useWorker{false};
+  std::thread _worker;
+  std::atomic<bool> _running{false};
+  std::mutex _workerMutex;
+  std::condition_variable _workerCondition;
+
+  void runWorker()
+  {
+    while (_running.load(std::memory_order_acquire))
+    {
+      // the smaller stage has the sooner deadline, so run its jobs first.
+      if (_stage1.pending.load(std::memory_order_acquire))
+      {
+        _stage1.runJob();
+        _stage1.pending.store(false, std::memory_order_release);
+      }
+      else if (_stage2.pending.load(std::memory_order_acquire))
+      {
+        _stage2.runJob();
+        _stage2.pending.store(false, std::memory_order_release);
+      }
+      else
+      {
+        // the audio thread notifies without taking the lock, so a wakeup can
+        // be missed. The timeout bounds the delay when that happens.
+        std::unique_lock<std::mutex> lock(_workerMutex);
+        _workerCondition.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+          return !_running.load() || _stage1.pending.load() || _stage2.pending.load();
+        });
+      }
+    }
+  }
+
+  // stop the worker thread. It may exit with jobs still posted, which are
+  // dropped so that the audio thread does not wait for them.
+  void stopWorker()
+  {
+    if (_worker.joinable())
+    {
+      _running.store(false, std::memory_order_release);
+      _workerCondition.notify_one();
+      _worker.join();
+    }
+    _stage1.pending.store(false, std::memory_order_release);
+    _stage2.pending.store(false, std::memory_order_release);
+  }
+
+  // at the start of each block period of the stage, collect the output of
+  // the job posted at the start of the last period, and post a job for the
+  // block of input just completed. Then add the output for this vector to y.
+  template <typename S>
+  inline void processStage(S& stage, const DSPVector& x, DSPVector& y)
+  {
+    if (!stage.active()) return;
+
+    size_t start = (_vectorCount * kFloatsPerDSPVector) % S::kBlockLength;
+    if (start == 0 && _vectorCount > 0)
+    {
+      stage.waitForJob();
+      std::swap(stage.output, stage.jobOutput);
+      std::swap(stage.input, stage.jobInput);
+      if (_useWorker)
+      {
+        stage.pending.store(true, std::memory_order_release);
+        _workerCondition.notify_one();
+      }
+      else
+      {
+        stage.runJob();
+      }
+    }
+
+    const float* px = x.getConstBuffer();
+    std::copy(px, px + kFloatsPerDSPVector, stage.input.data() + start);
+    y += DSPVector(stage.output.data() + start);
+  }
+
+ public:
+  Convolver() = default;
+  ~Convolver() { stopWorker(); }
+
+  // set the impulse response to one channel of the Sample ir. If useWorker is
+  // true, the later stages are computed on a worker thread. Otherwise they are
+  // computed on the calling thread, in a burst at the start of each of their
+  // blocks. Not real-time safe: this allocates memory and starts the thread.
+  void setImpulse(const Sample& ir, size_t channel = 0, bool useWorker = true)
+  {
+    stopWorker();
+
+    size_t frames = getFrames(ir);
+    std::vector<float> h(frames);
+    for (size_t i = 0; i < frames; ++i)
+    {
+      h[i] = ir[i * ir.channels + channel];
+    }
+
+    // stage n starts at twice its block length.
+    size_t stage1Start = 2 * Stage<kStage1Rows>::kBlockLength;
+    size_t stage2Start = 2 * Stage<kStage2Rows>::kBlockLength;
+    auto segmentLength = [&](size_t start, size_t end) {
+      return (frames > start) ? std::min(frames, end) - start : 0;
+    };
+    _head.setImpulse(h.data(), segmentLength(0, stage1Start));
+    _stage1.setImpulse(h.data() + stage1Start, segmentLength(stage1Start, stage2Start));
+    _stage2.setImpulse(h.data() + stage2Start, segmentLength(stage2Start, frames));
+    _vectorCount = 0;
+
+    _useWorker = useWorker && _stage1.active();
+    if (_useWorker)
+    {
+      _running.store(true, std::memory_order_release);
+      _worker = std::thread([this]() { runWorker(); });
+    }
+  }
+
+  // clear the input history. Waits for the worker to finish any jobs.
+  void clear()
+  {
+    _stage1.waitForJob();
+    _stage2.waitForJob();
+    _head.clear();
+    _stage1.clear();
+    _stage2.clear();
+    _vectorCount = 0;
+  }
+
+  // the output of each call is the convolution up to and including the
+  // input vector x, so there is no latency beyond the DSPVector.
+  static constexpr size_t getLatency() { return 0; }
+
+  inline DSPVector operator()(const DSPVector& x)
+  {
+    DSPVector y;
+    _head.process(x.getConstBuffer(), y.getBuffer());
+    processStage(_stage1, x, y);
+    processStage(_stage2, x, y);
+    _vectorCount++;
+    return y;
+  }
+};
+
+}  // namespace ml
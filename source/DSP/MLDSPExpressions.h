@@ -0,0 +1,236 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPExpressions.h
+// Lazy elementwise expressions over DSPVectorArrays.
+//
+// Each operator in MLDSPOps.h makes a full pass over its operands and returns a
+// new DSPVectorArray. An operator with a lazy() operand builds an expression
+// instead. Assigning the expression to a DSPVectorArray then runs all of its
+// operations in a single SIMD loop. To avoid all temporary arrays, each
+// operator must have a lazy operand, or an expression as one:
+//
+//   DSPVectorArray<8> y = lazy(a) * b + lazy(c) * d - e;
+//
+// In lazy(a) * b + c * d - e, c * d has no lazy operand, so the eager operator
+// computes it into a temporary array first. Only the rest is fused.
+//
+// Each node uses the same vec* primitive as the corresponding eager operator,
+// so the results are identical. This assumes the compiler does not contract
+// multiplies and adds into FMA instructions, which it may do when FMA is
+// enabled (-mfma, -march=native) unless -ffp-contract=off is also given.
+//
+// Expressions hold pointers to their operands. Assign them in the statement
+// where they are made, and don't store them with auto.
+
+#pragma once
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+namespace expressions
+{
+// leaf nodes
+
+struct Vector
+{
+  const float* p;
+  inline SIMDVectorFloat eval(size_t i) const { return vecLoad(p + i); }
+};
+
+struct Scalar
+{
+  SIMDVectorFloat k;
+  inline SIMDVectorFloat eval(size_t) const { return k; }
+};
+
+// operation nodes
+
+#define DEFINE_EXPRESSION_OP2(nodeName, opComputation)                       \
+  template <typename A, typename B>                                          \
+  struct nodeName                                                            \
+  {                                                                          \
+    A a;                                                                     \
+    B b;                                                                     \
+    inline SIMDVectorFloat eval(size_t i) const                              \
+    {                                                                        \
+      SIMDVectorFloat x1 = a.eval(i);                                        \
+      SIMDVectorFloat x2 = b.eval(i);                                        \
+      return (opComputation);                                                \
+    }                                                                        \
+  };
+
+DEFINE_EXPRESSION_OP2(Add, vecAdd(x1, x2));
+DEFINE_EXPRESSION_OP2(Subtract, vecSub(x1, x2));
+DEFINE_EXPRESSION_OP2(Multiply, vecMul(x1, x2));
+DEFINE_EXPRESSION_OP2(Divide, vecDiv(x1, x2));
+
+}  // namespace expressions
+
+// ----------------------------------------------------------------
+// DSPVectorExpression: a lazy expression with the shape of a
+// DSPVectorArray<ROWS>.
+
+template <size_t ROWS, typename E>
+class DSPVectorExpression
+{
+ public:
+  E node;
+
+  // compute every element of the expression into the aligned buffer pDest.
+  inline void evaluate(float* pDest) const
+  {
+    for (size_t i = 0; i < kFloatsPerDSPVector * ROWS; i += kFloatsPerSIMDVector)
+    {
+      vecStore(pDest + i, node.eval(i));
+    }
+  }
+};
+
+// start a lazy expression from a DSPVectorArray.
+template <size_t ROWS>
+inline DSPVectorExpression<ROWS, expressions::Vector> lazy(const DSPVectorArray<ROWS>& x)
+{
+  return {{x.getConstBuffer()}};
+}
+
+// return the result of an expression as a DSPVectorArray.
+template <size_t ROWS, typename E>
+inline DSPVectorArray<ROWS> evaluate(const DSPVectorExpression<ROWS, E>& x)
+{
+  return DSPVectorArray<ROWS>(x);
+}
+
+namespace expressions
+{
+// make an expression node from any operand.
+
+template <size_t ROWS, typename E>
+inline E operand(const DSPVectorExpression<ROWS, E>& x)
+{
+  return x.node;
+}
+
+template <size_t ROWS>
+inline Vector operand(const DSPVectorArray<ROWS>& x)
+{
+  return {x.getConstBuffer()};
+}
+
+template <size_t ROWS>
+inline Scalar operand(float k)
+{
+  return {vecSet1(k)};
+}
+
+// the type of the expression node made from an operand of type T.
+template <size_t ROWS, typename T>
+using OperandNode = decltype(operand<ROWS>(std::declval<T>()));
+
+// is T an expression or array with ROWS rows, or a scalar?
+template <size_t ROWS, typename T>
+struct IsOperand : std::is_arithmetic<T>
+{
+};
+template <size_t ROWS, typename E>
+struct IsOperand<ROWS, DSPVectorExpression<ROWS, E>> : std::true_type
+{
+};
+template <size_t ROWS>
+struct IsOperand<ROWS, DSPVectorArray<ROWS>> : std::true_type
+{
+};
+
+// is T a lazy expression?
+template <typename T>
+struct IsExpression : std::false_type
+{
+};
+template <size_t ROWS, typename E>
+struct IsExpression<DSPVectorExpression<ROWS, E>> : std::true_type
+{
+};
+
+// the number of rows of an expression, or 0 if T is not an expression.
+template <typename T>
+struct ExpressionRows : std::integral_constant<size_t, 0>
+{
+};
+template <size_t ROWS, typename E>
+struct ExpressionRows<DSPVectorExpression<ROWS, E>> : std::integral_constant<size_t, ROWS>
+{
+};
+
+template <typename T>
+using Plain = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+// the rows of the first expression among the arguments.
+template <typename... Ts>
+constexpr size_t firstExpressionRows()
+{
+  size_t rows[] = {ExpressionRows<Plain<Ts>>::value...};
+  for (size_t r : rows)
+  {
+    if (r) return r;
+  }
+  return 0;
+}
+
+// enable an operator if one or more of its arguments is an expression and
+// all of them are operands with matching rows.
+template <typename... Ts>
+constexpr bool anyExpression()
+{
+  bool e[] = {IsExpression<Plain<Ts>>::value...};
+  for (bool b : e)
+  {
+    if (b) return true;
+  }
+  return false;
+}
+
+template <size_t ROWS, typename... Ts>
+constexpr bool allOperands()
+{
+  bool e[] = {IsOperand<ROWS, Plain<Ts>>::value...};
+  for (bool b : e)
+  {
+    if (!b) return false;
+  }
+  return true;
+}
+
+template <typename... Ts>
+using EnableIfExpression =
+    typename std::enable_if<anyExpression<Ts...>() &&
+                                allOperands<firstExpressionRows<Ts...>(), Ts...>(),
+                            int>::type;
+
+}  // namespace expressions
+
+// ----------------------------------------------------------------
+// operators on expressions. Each one is enabled if at least one argument is an
+// expression, so the eager operators on DSPVectorArrays are unaffected.
+//
+// Only the arithmetic operators are lazy. Named functions like min() and
+// lerp() would be ambiguous with the scalar templates in MLDSPScalarMath.h.
+// To use them, evaluate() the expression first.
+
+#define DEFINE_EXPRESSION_OPERATOR(opName, nodeName)                                      \
+  template <typename T1, typename T2, expressions::EnableIfExpression<T1, T2> = 0>       \
+  inline auto opName(const T1& x1, const T2& x2)                                         \
+  {                                                                                      \
+    constexpr size_t ROWS = expressions::firstExpressionRows<T1, T2>();                  \
+    using namespace expressions;                                                         \
+    using Node = nodeName<OperandNode<ROWS, const T1&>, OperandNode<ROWS, const T2&>>;   \
+    return DSPVectorExpression<ROWS, Node>{Node{operand<ROWS>(x1), operand<ROWS>(x2)}}; \
+  }
+
+DEFINE_EXPRESSION_OPERATOR(operator+, Add);
+DEFINE_EXPRESSION_OPERATOR(operator-, Subtract);
+DEFINE_EXPRESSION_OPERATOR(operator*, Multiply);
+DEFINE_EXPRESSION_OPERATOR(operator/, Divide);
+
+}  // namespace ml
@@ -0,0 +1,141 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPFFT.h
+// Fast Fourier transforms of DSPVectorArrays, computed with FFTReal from the
+// ffft library in external/ffft.
+//
+// FFT<ROWS> transforms N = kFloatsPerDSPVector * ROWS points, where N must be
+// a power of two. The bit reversal and twiddle factor tables are made on
+// construction, after which the transforms read their inputs and write their
+// outputs directly, without copying or allocating. The input and output of a
+// transform must be different objects.
+//
+// Spectra follow the convention X[k] = sum over n of x[n] e^(-2 pi i k n / N).
+// Inverse transforms are scaled by 1/N, so that they give back the input to
+// the forward transforms.
+//
+// The spectrum of N real points is packed into N floats as in FFTReal, but
+// with the imaginary parts following the convention above:
+//   y[k], k = 0 ... N/2: the real part of X[k].
+//   y[N/2 + k], k = 1 ... N/2 - 1: the imaginary part of X[k].
+// N complex points are stored in a DSPVectorArray<ROWS * 2>, with the real
+// parts in the first ROWS rows and the imaginary parts in the last ROWS rows.
+
+#pragma once
+
+#include <algorithm>
+
+#include "FFTReal.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+template <size_t ROWS>
+class FFT
+{
+  static constexpr int kSize = kFloatsPerDSPVector * ROWS;
+  static constexpr int kHalf = kSize / 2;
+  static_assert((kSize & (kSize - 1)) == 0, "FFT size must be a power of two");
+
+  ffft::FFTReal<float> _fft{kSize};
+
+  static inline void scale(float* px, float k)
+  {
+    for (int n = 0; n < kSize; ++n)
+    {
+      px[n] *= k;
+    }
+  }
+
+  // the spectrum of the complex points with real parts at pxr and imaginary
+  // parts at pxi, written in the same way to pyr and pyi.
+  inline void forwardComplex(const float* pxr, const float* pxi, float* pyr, float* pyi)
+  {
+    // transform the real and imaginary parts separately, in FFTReal's format.
+    // The spectra P and Q of the two parts make X = P + iQ, where the bins
+    // above N/2 are found from the conjugate symmetry of P and Q.
+    _fft.do_fft(pyr, pxr);
+    _fft.do_fft(pyi, pxi);
+
+    // bins 0 and N/2 are already in place. Bins k, N/2 - k, N/2 + k and N - k
+    // are read from and written to the same four locations, so compute them
+    // together.
+    for (int k = 1; k <= kHalf / 2; ++k)
+    {
+      int m = kHalf - k;
+      float ak = pyr[k], bk = -pyr[kHalf + k], ck = pyi[k], dk = -pyi[kHalf + k];
+      float am = pyr[m], bm = -pyr[kHalf + m], cm = pyi[m], dm = -pyi[kHalf + m];
+
+      pyr[k] = ak - dk;
+      pyi[k] = bk + ck;
+      pyr[kHalf + m] = ak + dk;
+      pyi[kHalf + m] = ck - bk;
+
+      pyr[m] = am - dm;
+      pyi[m] = bm + cm;
+      pyr[kHalf + k] = am + dm;
+      pyi[kHalf + k] = cm - bm;
+    }
+  }
+
+ public:
+  // the number of points in each transform.
+  static constexpr int size() { return kSize; }
+
+  // transform the N real samples at px to the packed spectrum at py.
+  inline void forward(const float* px, float* py)
+  {
+    // FFTReal's imaginary parts have the opposite sign.
+    _fft.do_fft(py, px);
+    for (int k = kHalf + 1; k < kSize; ++k)
+    {
+      py[k] = -py[k];
+    }
+  }
+
+  // transform the packed spectrum at py back to N real samples at px.
+  inline void inverse(const float* py, float* px)
+  {
+    // FFTReal reads the imaginary parts with the opposite sign, and so returns
+    // the signal reversed in time around x[0].
+    _fft.do_ifft(py, px);
+    std::reverse(px + 1, px + kSize);
+    scale(px, 1.f / kSize);
+  }
+
+  // transform the real signal x to the packed spectrum y.
+  inline void forward(const DSPVectorArray<ROWS>& x, DSPVectorArray<ROWS>& y)
+  {
+    forward(x.getConstBuffer(), y.getBuffer());
+  }
+
+  // transform the packed spectrum y back to the real signal x.
+  inline void inverse(const DSPVectorArray<ROWS>& y, DSPVectorArray<ROWS>& x)
+  {
+    inverse(y.getConstBuffer(), x.getBuffer());
+  }
+
+  // transform the complex signal x to the complex spectrum y.
+  inline void forwardComplex(const DSPVectorArray<ROWS * 2>& x, DSPVectorArray<ROWS * 2>& y)
+  {
+    const float* px = x.getConstBuffer();
+    float* py = y.getBuffer();
+    forwardComplex(px, px + kSize, py, py + kSize);
+  }
+
+  // transform the complex spectrum y back to the complex signal x.
+  inline void inverseComplex(const DSPVectorArray<ROWS * 2>& y, DSPVectorArray<ROWS * 2>& x)
+  {
+    // the inverse transform is the forward transform with the real and
+    // imaginary parts swapped at the input and output.
+    const float* py = y.getConstBuffer();
+    float* px = x.getBuffer();
+    forwardComplex(py + kSize, py, px + kSize, px);
+    scale(px, 1.f / kSize);
+    scale(px + kSize, 1.f / kSize);
+  }
+};
+
+}  // namespace ml
@@ -0,0 +1,438 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPFilterBanks.h
+// Banks of filters and envelopes that process one voice in each SIMD lane.
+//
+// Bank<Lopass, N> in MLDSPFunctional.h runs the recursion of each filter in
+// turn, one sample at a time, so the speed is limited by the latency of each
+// step. The banks here keep the state of kFloatsPerSIMDVector voices in each
+// SIMD register and run the recursion for all of them at once. As with Bank,
+// the input and output of voice i are on row i of a DSPVectorArray.
+//
+// Each call transposes the rows of its inputs into a voice-interleaved buffer,
+// and the results back out again. Each bank gives the same results as the
+// corresponding scalar filter or envelope on each row.
+
+#pragma once
+
+#include <utility>
+
+#include "MLDSPFilters.h"
+
+namespace ml
+{
+// VoiceLanes: the layout shared by the banks. Voice v is in lane
+// v % kFloatsPerSIMDVector of group v / kFloatsPerSIMDVector.
+
+template <size_t VOICES>
+class VoiceLanes
+{
+ protected:
+  static constexpr size_t kGroups = (VOICES + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector;
+  static constexpr size_t kLanes = kGroups * kFloatsPerSIMDVector;
+
+  // one SIMD vector per group, for the coefficients and state of the voices.
+  // A struct around a C array, because a std::array of SIMD vectors drops the
+  // vector type's attributes. Copy it to a local to keep it in registers.
+  struct GroupVectors
+  {
+    SIMDVectorFloat v[kGroups];
+
+    inline SIMDVectorFloat& operator[](size_t g) { return v[g]; }
+    inline const SIMDVectorFloat& operator[](size_t g) const { return v[g]; }
+  };
+
+  // copy the rows of px, one per voice, to the interleaved layout in y, by
+  // transposing square blocks of kFloatsPerSIMDVector voices and samples.
+  static inline void interleave(const float* px, DSPVectorArray<kLanes>& y)
+  {
+    float* py = y.getBuffer();
+    SIMDVectorFloat block[kFloatsPerSIMDVector];
+    for (size_t g = 0; g < kGroups; ++g)
+    {
+      for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+      {
+        for (size_t l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          size_t voice = g * kFloatsPerSIMDVector + l;
+          block[l] = (voice < VOICES) ? vecLoad(px + voice * kFloatsPerDSPVector + t) : vecZeros();
+        }
+        vecTranspose(block);
+        for (size_t l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          vecStore(py + (g * kFloatsPerDSPVector + t + l) * kFloatsPerSIMDVector, block[l]);
+        }
+      }
+    }
+  }
+
+  // copy the interleaved layout in x back to rows in py.
+  static inline void deinterleave(const DSPVectorArray<kLanes>& x, float* py)
+  {
+    const float* px = x.getConstBuffer();
+    SIMDVectorFloat block[kFloatsPerSIMDVector];
+    for (size_t g = 0; g < kGroups; ++g)
+    {
+      for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+      {
+        for (size_t l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          block[l] = vecLoad(px + (g * kFloatsPerDSPVector + t + l) * kFloatsPerSIMDVector);
+        }
+        vecTranspose(block);
+        for (size_t l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          size_t voice = g * kFloatsPerSIMDVector + l;
+          if (voice < VOICES)
+          {
+            vecStore(py + voice * kFloatsPerDSPVector + t, block[l]);
+          }
+        }
+      }
+    }
+  }
+
+  // call f(g) for each group g, unrolled so that the state of each group can
+  // stay in registers.
+  template <typename F, size_t... G>
+  static inline void forEachGroup(F&& f, std::index_sequence<G...>)
+  {
+    (f(G), ...);
+  }
+
+  template <typename F>
+  static inline void forEachGroup(F&& f)
+  {
+    forEachGroup(f, std::make_index_sequence<kGroups>());
+  }
+
+  static inline void setLane(GroupVectors& a, size_t voice, float f)
+  {
+    reinterpret_cast<float*>(a.v)[voice] = f;
+  }
+
+};
+
+// SVFBank: a bank of VOICES state variable filters with the coefficients of
+// Lopass, giving the output OUTPUT.
+
+template <size_t VOICES, SVFOutput OUTPUT>
+class SVFBank : private VoiceLanes<VOICES>
+{
+  using Lanes = VoiceLanes<VOICES>;
+  using typename Lanes::GroupVectors;
+  using Lanes::kGroups;
+  using Lanes::kLanes;
+  using Lanes::interleave;
+  using Lanes::deinterleave;
+  using Lanes::forEachGroup;
+  using Lanes::setLane;
+
+  // coefficients and state, with voice v in group v / kFloatsPerSIMDVector.
+  GroupVectors _g0{}, _g1{}, _g2{}, _k{};
+  GroupVectors _ic1eq{}, _ic2eq{};
+
+  // buffers in the interleaved layout, which has the samples at each time of
+  // the voices in a group in one SIMD vector. Lanes past VOICES stay 0.
+  DSPVectorArray<kLanes> _x, _y;
+  DSPVectorArray<kLanes> _vg0, _vg1, _vg2, _vk;
+
+  // one step of the SVF for one group of voices.
+  static inline SIMDVectorFloat tick(SIMDVectorFloat v0, SIMDVectorFloat g0, SIMDVectorFloat g1,
+                                     SIMDVectorFloat g2, SIMDVectorFloat k, SIMDVectorFloat& ic1eq,
+                                     SIMDVectorFloat& ic2eq)
+  {
+    SIMDVectorFloat t0 = vecSub(v0, ic2eq);
+    SIMDVectorFloat t1 = vecAdd(vecMul(g0, t0), vecMul(g1, ic1eq));
+    SIMDVectorFloat t2 = vecAdd(vecMul(g2, t0), vecMul(g0, ic1eq));
+    SIMDVectorFloat v1 = vecAdd(t1, ic1eq);
+    SIMDVectorFloat v2 = vecAdd(t2, ic2eq);
+    SIMDVectorFloat two = vecSet1(2.0f);
+    ic1eq = vecAdd(ic1eq, vecMul(two, t1));
+    ic2eq = vecAdd(ic2eq, vecMul(two, t2));
+
+    if constexpr (OUTPUT == SVFOutput::lopass)
+    {
+      return v2;
+    }
+    else if constexpr (OUTPUT == SVFOutput::bandpass)
+    {
+      return v1;
+    }
+    else
+    {
+      return vecSub(vecSub(v0, vecMul(k, v1)), v2);
+    }
+  }
+
+ public:
+  inline void clear()
+  {
+    _ic1eq = GroupVectors{};
+    _ic2eq = GroupVectors{};
+  }
+
+  // set the coefficients of one voice for a given omega and k, used by
+  // operator()(x). omega: the frequency divided by the sample rate. k: 1/Q,
+  // where k=0 is maximum resonance.
+  inline void setParams(size_t voice, float omega, float k)
+  {
+    auto c = Lopass::makeCoeffs(omega, k);
+    setLane(_g0, voice, c[Lopass::g0]);
+    setLane(_g1, voice, c[Lopass::g1]);
+    setLane(_g2, voice, c[Lopass::g2]);
+    setLane(_k, voice, k);
+  }
+
+  // filter each voice of the input vx with the stored coefficients.
+  inline DSPVectorArray<VOICES> operator()(const DSPVectorArray<VOICES>& vx)
+  {
+    interleave(vx.getConstBuffer(), _x);
+    const float* px = _x.getConstBuffer();
+    float* py = _y.getBuffer();
+
+    // keep the state in registers, and step each group at each time so that
+    // the recursions of the groups can overlap.
+    auto ic1eq = _ic1eq;
+    auto ic2eq = _ic2eq;
+    for (size_t t = 0; t < kFloatsPerDSPVector; ++t)
+    {
+      forEachGroup([&](size_t g) {
+        size_t i = (g * kFloatsPerDSPVector + t) * kFloatsPerSIMDVector;
+        vecStore(py + i, tick(vecLoad(px + i), _g0[g], _g1[g], _g2[g], _k[g], ic1eq[g], ic2eq[g]));
+      });
+    }
+    _ic1eq = ic1eq;
+    _ic2eq = ic2eq;
+
+    DSPVectorArray<VOICES> vy;
+    deinterleave(_y, vy.getBuffer());
+    return vy;
+  }
+
+  // filter each voice of the input vx with coefficients generated from the
+  // parameters omega and k for that voice at each sample.
+  inline DSPVectorArray<VOICES> operator()(const DSPVectorArray<VOICES>& vx,
+                                           const DSPVectorArray<VOICES>& omega,
+                                           const DSPVectorArray<VOICES>& k)
+  {
+    DSPVectorArray<VOICES> g0, g1, g2;
+    for (size_t v = 0; v < VOICES; ++v)
+    {
+      auto vc = Lopass::makeCoeffsVec(omega.constRow(v), k.constRow(v));
+      g0.row(v) = vc.constRow(Lopass::g0);
+      g1.row(v) = vc.constRow(Lopass::g1);
+      g2.row(v) = vc.constRow(Lopass::g2);
+    }
+    interleave(vx.getConstBuffer(), _x);
+    interleave(g0.getConstBuffer(), _vg0);
+    interleave(g1.getConstBuffer(), _vg1);
+    interleave(g2.getConstBuffer(), _vg2);
+    if constexpr (OUTPUT == SVFOutput::hipass)
+    {
+      interleave(k.getConstBuffer(), _vk);
+    }
+
+    const float* px = _x.getConstBuffer();
+    float* py = _y.getBuffer();
+    auto ic1eq = _ic1eq;
+    auto ic2eq = _ic2eq;
+    for (size_t t = 0; t < kFloatsPerDSPVector; ++t)
+    {
+      forEachGroup([&](size_t g) {
+        size_t i = (g * kFloatsPerDSPVector + t) * kFloatsPerSIMDVector;
+        SIMDVectorFloat g0 = vecLoad(_vg0.getConstBuffer() + i);
+        SIMDVectorFloat g1 = vecLoad(_vg1.getConstBuffer() + i);
+        SIMDVectorFloat g2 = vecLoad(_vg2.getConstBuffer() + i);
+        SIMDVectorFloat k = vecLoad(_vk.getConstBuffer() + i);
+        vecStore(py + i, tick(vecLoad(px + i), g0, g1, g2, k, ic1eq[g], ic2eq[g]));
+      });
+    }
+    _ic1eq = ic1eq;
+    _ic2eq = ic2eq;
+
+    DSPVectorArray<VOICES> vy;
+    deinterleave(_y, vy.getBuffer());
+    return vy;
+  }
+};
+
+template <size_t VOICES>
+using LopassBank = SVFBank<VOICES, SVFOutput::lopass>;
+
+template <size_t VOICES>
+using BandpassBank = SVFBank<VOICES, SVFOutput::bandpass>;
+
+template <size_t VOICES>
+using HipassBank = SVFBank<VOICES, SVFOutput::hipass>;
+
+// ADSRBank: a bank of VOICES ADSR envelopes. The input of each voice is its
+// gate and amplitude, as for ADSR. The segments of the voices are advanced
+// together, with the transitions that ADSR makes with branches made instead
+// by selecting between values with masks.
+
+template <size_t VOICES>
+class ADSRBank : private VoiceLanes<VOICES>
+{
+  using Lanes = VoiceLanes<VOICES>;
+  using typename Lanes::GroupVectors;
+  using Lanes::kGroups;
+  using Lanes::kLanes;
+  using Lanes::interleave;
+  using Lanes::deinterleave;
+  using Lanes::forEachGroup;
+  using Lanes::setLane;
+
+  // the state of ADSR for one group of voices, with the segment as a float.
+  struct State
+  {
+    SIMDVectorFloat y, y1, x1, threshold, target, k, amp, segment;
+  };
+
+  GroupVectors _ka{}, _kd{}, _s{}, _kr{};
+  std::array<State, kGroups> _state;
+
+  DSPVectorArray<kLanes> _x, _y;
+
+  // one step of ADSR::processSample for one group of voices, where any of
+  // them may change segments.
+  static SIMDVectorFloat transitionTick(SIMDVectorFloat x, SIMDVectorFloat ka, SIMDVectorFloat kd,
+                                        SIMDVectorFloat s, SIMDVectorFloat kr, State& st)
+  {
+    SIMDVectorFloat zero = vecZeros();
+    SIMDVectorFloat one = vecSet1(1.f);
+    SIMDVectorFloat off = vecSet1(float(ADSR::off));
+
+    // voices that are off with no input are left as they are.
+    SIMDVectorFloat xIsZero = vecEqual(x, zero);
+    SIMDVectorFloat idle = vecAnd(vecEqual(st.segment, off), xIsZero);
+
+    // crossing the threshold advances to the next segment.
+    SIMDVectorFloat crossed =
+        vecXor(vecGreaterThan(st.y1, st.threshold), vecGreaterThan(st.y, st.threshold));
+    SIMDVectorFloat advance = vecAnd(crossed, vecLessThan(st.segment, off));
+    SIMDVectorFloat segment = vecAdd(st.segment, vecAnd(advance, one));
+
+    // a trigger on starts the attack at the new amplitude, and a trigger off
+    // starts the release. They can't both happen at once.
+    SIMDVectorFloat trigOn = vecAnd(vecEqual(st.x1, zero), vecGreaterThan(x, zero));
+    SIMDVectorFloat trigOff = vecAnd(vecGreaterThan(st.x1, zero), xIsZero);
+    segment = vecSelect(zero, segment, trigOn);
+    segment = vecSelect(vecSet1(float(ADSR::R)), segment, trigOff);
+    SIMDVectorFloat amp = vecSelect(x, st.amp, trigOn);
+    SIMDVectorFloat recalc = vecOr(vecOr(advance, trigOn), trigOff);
+
+    // the start, end and rate of the segment each voice is now in.
+    SIMDVectorFloat isA = vecEqual(segment, zero);
+    SIMDVectorFloat isD = vecEqual(segment, one);
+    SIMDVectorFloat isS = vecEqual(segment, vecSet1(float(ADSR::S)));
+    SIMDVectorFloat isR = vecEqual(segment, vecSet1(float(ADSR::R)));
+    SIMDVectorFloat isOff = vecEqual(segment, off);
+    SIMDVectorFloat startEnv = vecOr(vecAnd(isD, one), vecAnd(vecOr(isS, isR), s));
+    SIMDVectorFloat endEnv = vecOr(vecAnd(isA, one), vecAnd(vecOr(isD, isS), s));
+    SIMDVectorFloat k = vecOr(vecOr(vecAnd(isA, ka), vecAnd(isD, kd)), vecAnd(isR, kr));
+    SIMDVectorFloat segmentBias = vecMul(vecSub(endEnv, startEnv), vecSet1(ADSR::bias));
+
+    k = vecSelect(k, st.k, recalc);
+    SIMDVectorFloat threshold = vecSelect(endEnv, st.threshold, recalc);
+    SIMDVectorFloat target = vecSelect(vecAdd(endEnv, segmentBias), st.target, recalc);
+
+    // the sustain and off segments hold the output at their ends.
+    SIMDVectorFloat hold = vecAnd(recalc, vecOr(isS, isOff));
+    SIMDVectorFloat y = vecSelect(endEnv, st.y, hold);
+
+    // history and IIR filter
+    SIMDVectorFloat y1 = y;
+    y = vecAdd(y, vecMul(k, vecSub(target, y)));
+
+    st.y = vecSelect(st.y, y, idle);
+    st.y1 = vecSelect(st.y1, y1, idle);
+    st.x1 = vecSelect(st.x1, x, idle);
+    st.threshold = vecSelect(st.threshold, threshold, idle);
+    st.target = vecSelect(st.target, target, idle);
+    st.k = vecSelect(st.k, k, idle);
+    st.amp = vecSelect(st.amp, amp, idle);
+    st.segment = vecSelect(st.segment, segment, idle);
+
+    // scale by amp
+    return vecSelect(zero, vecMul(y, amp), idle);
+  }
+
+  // one step of ADSR::processSample for one group of voices. A voice can only
+  // change segments when its input changes or its output crosses the
+  // threshold. Otherwise, only the filter runs. This is also true of voices
+  // that are off, because their k and output are kept at 0.
+  static inline SIMDVectorFloat tick(SIMDVectorFloat x, SIMDVectorFloat ka, SIMDVectorFloat kd,
+                                     SIMDVectorFloat s, SIMDVectorFloat kr, State& st)
+  {
+    SIMDVectorFloat crossed =
+        vecXor(vecGreaterThan(st.y1, st.threshold), vecGreaterThan(st.y, st.threshold));
+    if (vecAnyTrue(vecOr(vecNotEqual(x, st.x1), crossed)))
+    {
+      return transitionTick(x, ka, kd, s, kr, st);
+    }
+    st.x1 = x;
+    st.y1 = st.y;
+    st.y = vecAdd(st.y, vecMul(st.k, vecSub(st.target, st.y)));
+    return vecMul(st.y, st.amp);
+  }
+
+ public:
+  ADSRBank() { clear(); }
+
+  // set all of the voices off, as ADSR::clear() does, and zero the rest of the
+  // state.
+  inline void clear()
+  {
+    for (auto& st : _state)
+    {
+      st = State{vecZeros(), vecZeros(), vecZeros(), vecZeros(),
+                 vecZeros(), vecZeros(), vecZeros(), vecSet1(float(ADSR::off))};
+    }
+  }
+
+  // set the coefficients of one voice, made by ADSR::calcCoeffs().
+  inline void setCoeffs(size_t voice, const ADSR::_coeffs& c)
+  {
+    setLane(_ka, voice, c.ka);
+    setLane(_kd, voice, c.kd);
+    setLane(_s, voice, c.s);
+    setLane(_kr, voice, c.kr);
+  }
+
+  // set the coefficients of all the voices.
+  inline void setCoeffs(const ADSR::_coeffs& c)
+  {
+    for (size_t v = 0; v < VOICES; ++v)
+    {
+      setCoeffs(v, c);
+    }
+  }
+
+  // run the envelope of each voice for the gate and amplitude inputs vx,
+  // returning the envelope times the amplitude.
+  inline DSPVectorArray<VOICES> operator()(const DSPVectorArray<VOICES>& vx)
+  {
+    interleave(vx.getConstBuffer(), _x);
+    const float* px = _x.getConstBuffer();
+    float* py = _y.getBuffer();
+
+    auto state = _state;
+    for (size_t t = 0; t < kFloatsPerDSPVector; ++t)
+    {
+      forEachGroup([&](size_t g) {
+        size_t i = (g * kFloatsPerDSPVector + t) * kFloatsPerSIMDVector;
+        vecStore(py + i, tick(vecLoad(px + i), _ka[g], _kd[g], _s[g], _kr[g], state[g]));
+      });
+    }
+    _state = state;
+
+    DSPVectorArray<VOICES> vy;
+    deinterleave(_y, vy.getBuffer());
+    return vy;
+  }
+};
+
+}  // namespace ml
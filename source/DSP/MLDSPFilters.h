@@ -20,6 +20,7 @@
 
 #include <vector>
 
+#include "MLDSPMirroredBuffer.h"
 #include "MLDSPOps.h"
 #include "MLDSPScalarMath.h"
 #include <cmath>
@@ -43,6 +44,66 @@ DSPVectorArray<COEFFS_SIZE> interpolateCoeffsLinear(const std::array<float, COEF
   return vy;
 }
 
+// Filters with parameters given as DSPVectors can compute their coefficients at
+// each sample (audio rate), or at the end of each DSPVector, interpolating
+// linearly from the coefficients at the end of the previous one (control rate).
+// Control rate is much cheaper and is fine for slowly changing parameters.
+enum class CoeffsRate
+{
+  audio,
+  control
+};
+
+// the outputs of a state variable filter, for filters that can produce any
+// of them.
+enum class SVFOutput
+{
+  lopass,
+  bandpass,
+  hipass
+};
+
+// the coefficients g0, g1 and g2 of the SVF filters below for each sample of
+// omega and k. omega should be in [0, 0.5].
+inline DSPVectorArray<3> makeSVFCoeffsVec(const DSPVector& omega, const DSPVector& k)
+{
+  DSPVectorArray<3> vy;
+  const float* pOmega = omega.getConstBuffer();
+  const float* pK = k.getConstBuffer();
+  float* pg0 = vy.row(0).getBuffer();
+  float* pg1 = vy.row(1).getBuffer();
+  float* pg2 = vy.row(2).getBuffer();
+  for (size_t n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+  {
+    // s2 = sin(2 pi omega) = 2 sin(pi omega) cos(pi omega)
+    SIMDVectorFloat s1, c1;
+    vecSinCos(vecMul(vecSet1(kPi), vecLoad(pOmega + n)), &s1, &c1);
+    SIMDVectorFloat s2 = vecMul(vecSet1(2.f), vecMul(s1, c1));
+    SIMDVectorFloat vk = vecLoad(pK + n);
+    SIMDVectorFloat nrm = vecDiv(vecSet1(1.f), vecAdd(vecSet1(2.f), vecMul(vk, s2)));
+    SIMDVectorFloat twoS1Squared = vecMul(vecSet1(2.f), vecMul(s1, s1));
+    vecStore(pg0 + n, vecMul(s2, nrm));
+    vecStore(pg1 + n, vecMul(vecSub(vecSub(vecZeros(), twoS1Squared), vecMul(vk, s2)), nrm));
+    vecStore(pg2 + n, vecMul(twoS1Squared, nrm));
+  }
+  return vy;
+}
+
+// tan(pi * omega) for each sample of omega, for the shelf and bell filters.
+inline DSPVector tanPiOmega(const DSPVector& omega)
+{
+  DSPVector vy;
+  const float* pOmega = omega.getConstBuffer();
+  float* py = vy.getBuffer();
+  for (size_t n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+  {
+    SIMDVectorFloat s, c;
+    vecSinCos(vecMul(vecSet1(kPi), vecLoad(pOmega + n)), &s, &c);
+    vecStore(py + n, vecDiv(s, c));
+  }
+  return vy;
+}
+
 // --------------------------------------------------------------------------------
 // utility filters implemented as SVF variations
 // Thanks to Andrew Simper [www.cytomic.com] for sharing his work over the
@@ -95,25 +156,25 @@ struct Lopass
   
   static coeffsVec makeCoeffsVec(DSPVector omega, DSPVector k)
   {
-    coeffsVec vy;
-    // TODO SIMD
     omega = min(omega, DSPVector(0.5f));
     k = max(k, DSPVector(0.01f));
-    
-    
-    for (int n = 0; n < kFloatsPerDSPVector; ++n)
-    {
-      float piOmega = kPi * omega[n];
-      float s1 = sinf(piOmega);
-      float s2 = sinf(2.0f * piOmega);
-      float nrm = 1.0f / (2.f + k[n] * s2);
-      vy.row(g0)[n] = s2 * nrm;
-      vy.row(g1)[n] = (-2.f * s1 * s1 - k[n] * s2) * nrm;
-      vy.row(g2)[n] = (2.0f * s1 * s1) * nrm;
-    }
-    return vy;
+    return makeSVFCoeffsVec(omega, k);
   }
-  
+
+  // get coefficients interpolated linearly over a DSPVector, from just after
+  // those for p0 to those for p1 at the end.
+  static coeffsVec makeCoeffsVec(params p0, params p1)
+  {
+    return interpolateCoeffsLinear(makeCoeffs(p0[omega], p0[k]), makeCoeffs(p1[omega], p1[k]));
+  }
+
+  // the rate at which operator()(vx, omega, k) computes coefficients. At
+  // control rate it interpolates from the stored coefficients to those at the
+  // end of the vector, then stores them. On the first vector at control rate
+  // there is nothing to interpolate from, so the new coefficients are used.
+  CoeffsRate coeffsRate{CoeffsRate::audio};
+  CoeffsRate _lastCoeffsRate{CoeffsRate::audio};
+
   // filter the input vector vx with the stored coefficients.
   inline DSPVector operator()(const DSPVector vx)
   {
@@ -136,7 +197,23 @@ struct Lopass
   inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
   {
     DSPVector vy;
-    auto vc = makeCoeffsVec(omega, k);
+    coeffsVec vc;
+    if (coeffsRate == CoeffsRate::control)
+    {
+      auto c1 = makeCoeffs(ml::min(omega[kFloatsPerDSPVector - 1], 0.5f),
+                           ml::max(k[kFloatsPerDSPVector - 1], 0.01f));
+      if (_lastCoeffsRate != CoeffsRate::control)
+      {
+        _coeffs = c1;
+      }
+      vc = interpolateCoeffsLinear(_coeffs, c1);
+      _coeffs = c1;
+    }
+    else
+    {
+      vc = makeCoeffsVec(omega, k);
+    }
+    _lastCoeffsRate = coeffsRate;
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
@@ -163,6 +240,7 @@ class Hipass
 
   float ic1eq{0};
   float ic2eq{0};
+  CoeffsRate mLastCoeffsRate{CoeffsRate::audio};
 
  public:
   _coeffs mCoeffs{0};
@@ -179,6 +257,12 @@ class Hipass
     return {g0, g1, g2, k};
   }
 
+  // the rate at which operator()(vx, omega, k) computes coefficients. At
+  // control rate it interpolates from mCoeffs to those at the end of the
+  // vector, then stores them in mCoeffs. On the first vector at control rate
+  // there is nothing to interpolate from, so the new coefficients are used.
+  CoeffsRate coeffsRate{CoeffsRate::audio};
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -196,6 +280,46 @@ class Hipass
     }
     return vy;
   }
+
+  // filter the input vector vx with the coefficients generated from parameters omega and k.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
+  {
+    DSPVectorArray<3> vc;
+    DSPVector vk;
+    if (coeffsRate == CoeffsRate::control)
+    {
+      _coeffs c1 = coeffs(ml::min(omega[kFloatsPerDSPVector - 1], 0.5f),
+                          ml::max(k[kFloatsPerDSPVector - 1], 0.01f));
+      if (mLastCoeffsRate != CoeffsRate::control)
+      {
+        mCoeffs = c1;
+      }
+      vc = interpolateCoeffsLinear<3>({mCoeffs.g0, mCoeffs.g1, mCoeffs.g2}, {c1.g0, c1.g1, c1.g2});
+      vk = interpolateDSPVectorLinear(mCoeffs.k, c1.k);
+      mCoeffs = c1;
+    }
+    else
+    {
+      vk = max(k, DSPVector(0.01f));
+      vc = makeSVFCoeffsVec(min(omega, DSPVector(0.5f)), vk);
+    }
+    mLastCoeffsRate = coeffsRate;
+
+    DSPVector vy;
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float t0 = v0 - ic2eq;
+      float t1 = vc.constRow(0)[n] * t0 + vc.constRow(1)[n] * ic1eq;
+      float t2 = vc.constRow(2)[n] * t0 + vc.constRow(0)[n] * ic1eq;
+      float v1 = t1 + ic1eq;
+      float v2 = t2 + ic2eq;
+      ic1eq += 2.0f * t1;
+      ic2eq += 2.0f * t2;
+      vy[n] = v0 - vk[n] * v1 - v2;
+    }
+    return vy;
+  }
 };
 
 class Bandpass
@@ -207,6 +331,7 @@ class Bandpass
 
   float ic1eq{0};
   float ic2eq{0};
+  CoeffsRate mLastCoeffsRate{CoeffsRate::audio};
 
  public:
   _coeffs mCoeffs{0};
@@ -223,6 +348,12 @@ class Bandpass
     return {g0, g1, g2};
   }
 
+  // the rate at which operator()(vx, omega, k) computes coefficients. At
+  // control rate it interpolates from mCoeffs to those at the end of the
+  // vector, then stores them in mCoeffs. On the first vector at control rate
+  // there is nothing to interpolate from, so the new coefficients are used.
+  CoeffsRate coeffsRate{CoeffsRate::audio};
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -239,6 +370,42 @@ class Bandpass
     }
     return vy;
   }
+
+  // filter the input vector vx with the coefficients generated from parameters omega and k.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
+  {
+    DSPVectorArray<3> vc;
+    if (coeffsRate == CoeffsRate::control)
+    {
+      _coeffs c1 = coeffs(ml::min(omega[kFloatsPerDSPVector - 1], 0.5f),
+                          ml::max(k[kFloatsPerDSPVector - 1], 0.01f));
+      if (mLastCoeffsRate != CoeffsRate::control)
+      {
+        mCoeffs = c1;
+      }
+      vc = interpolateCoeffsLinear<3>({mCoeffs.g0, mCoeffs.g1, mCoeffs.g2}, {c1.g0, c1.g1, c1.g2});
+      mCoeffs = c1;
+    }
+    else
+    {
+      vc = makeSVFCoeffsVec(min(omega, DSPVector(0.5f)), max(k, DSPVector(0.01f)));
+    }
+    mLastCoeffsRate = coeffsRate;
+
+    DSPVector vy;
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float t0 = v0 - ic2eq;
+      float t1 = vc.constRow(0)[n] * t0 + vc.constRow(1)[n] * ic1eq;
+      float t2 = vc.constRow(2)[n] * t0 + vc.constRow(0)[n] * ic1eq;
+      float v1 = t1 + ic1eq;
+      ic1eq += 2.0f * t1;
+      ic2eq += 2.0f * t2;
+      vy[n] = v1;
+    }
+    return vy;
+  }
 };
 
 class LoShelf
@@ -287,6 +454,19 @@ class LoShelf
     return interpolateCoeffsLinear(coeffs(p0), coeffs(p1));
   }
 
+  // get coefficients for each sample of the parameters omega, k and A.
+  static _vcoeffs vcoeffs(const DSPVector vOmega, const DSPVector vK, const DSPVector vA)
+  {
+    _vcoeffs vc;
+    DSPVector g = tanPiOmega(vOmega) / sqrt(vA);
+    vc.row(a1) = DSPVector(1.f) / (DSPVector(1.f) + g * (g + vK));
+    vc.row(a2) = g * vc.constRow(a1);
+    vc.row(a3) = g * vc.constRow(a2);
+    vc.row(m1) = vK * (vA - DSPVector(1.f));
+    vc.row(m2) = vA * vA - DSPVector(1.f);
+    return vc;
+  }
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -368,6 +548,20 @@ class HiShelf
     return interpolateCoeffsLinear(coeffs(p0), coeffs(p1));
   }
 
+  // get coefficients for each sample of the parameters omega, k and A.
+  static _vcoeffs vcoeffs(const DSPVector vOmega, const DSPVector vK, const DSPVector vA)
+  {
+    _vcoeffs vc;
+    DSPVector g = tanPiOmega(vOmega) * sqrt(vA);
+    vc.row(a1) = DSPVector(1.f) / (DSPVector(1.f) + g * (g + vK));
+    vc.row(a2) = g * vc.constRow(a1);
+    vc.row(a3) = g * vc.constRow(a2);
+    vc.row(m0) = vA * vA;
+    vc.row(m1) = vK * (DSPVector(1.f) - vA) * vA;
+    vc.row(m2) = DSPVector(1.f) - vA * vA;
+    return vc;
+  }
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -426,6 +620,20 @@ class Bell
     return {a1, a2, a3, m1};
   }
 
+  // get coefficients for each sample of the parameters omega, k and A, in
+  // the rows a1, a2, a3 and m1.
+  static DSPVectorArray<4> vcoeffs(const DSPVector vOmega, const DSPVector vK, const DSPVector vA)
+  {
+    DSPVectorArray<4> vc;
+    DSPVector kc = vK / vA;
+    DSPVector g = tanPiOmega(vOmega);
+    vc.row(0) = DSPVector(1.f) / (DSPVector(1.f) + g * (g + kc));
+    vc.row(1) = g * vc.constRow(0);
+    vc.row(2) = g * vc.constRow(1);
+    vc.row(3) = kc * (vA * vA - DSPVector(1.f));
+    return vc;
+  }
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -441,6 +649,23 @@ class Bell
     }
     return vy;
   }
+
+  // filter the input vector vx with coefficients from vcoeffs() at each sample.
+  inline DSPVector operator()(const DSPVector vx, const DSPVectorArray<4>& vc)
+  {
+    DSPVector vy;
+    for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float v3 = v0 - ic2eq;
+      float v1 = vc.constRow(0)[n] * ic1eq + vc.constRow(1)[n] * v3;
+      float v2 = ic2eq + vc.constRow(1)[n] * ic1eq + vc.constRow(2)[n] * v3;
+      ic1eq = 2 * v1 - ic1eq;
+      ic2eq = 2 * v2 - ic2eq;
+      vy[n] = v0 + vc.constRow(3)[n] * v1;
+    }
+    return vy;
+  }
 };
 
 // A one pole filter. see https://ccrma.stanford.edu/~jos/fp/One_Pole.html
@@ -805,11 +1030,12 @@ struct ADSR
 };
 
 
-// IntegerDelay delays a signal a whole number of samples.
+// IntegerDelay delays a signal a whole number of samples. Where the buffer is
+// mirrored in memory, each DSPVector is written and read with a single copy.
 
 class IntegerDelay
 {
-  std::vector<float> mBuffer;
+  MirroredBuffer<float> mBuffer;
   int mIntDelayInSamples{0};
   uintptr_t mWriteIndex{0};
   uintptr_t mLengthMask{0};
@@ -832,22 +1058,41 @@ class IntegerDelay
   {
     int dMax = static_cast<int>(floorf(d));
     int newSize = 1 << bitsToContain(dMax + kFloatsPerDSPVector);
-    mBuffer.resize(newSize);
-    mLengthMask = newSize - 1;
+
+    // mirrored memory may be larger than requested, which only allows longer
+    // delays. If allocation fails, the previous buffer is kept.
+    size_t size = mBuffer.resize(newSize);
+    if (!size) return;
+    mLengthMask = size - 1;
     mWriteIndex = 0;
     clear();
   }
 
-  inline void clear() { std::fill(mBuffer.begin(), mBuffer.end(), 0.f); }
+  inline void clear() { std::fill(mBuffer.data(), mBuffer.data() + mBuffer.size(), 0.f); }
 
   inline DSPVector operator()(const DSPVector vx)
   {
+    float* srcBuf = mBuffer.data();
+    if (mBuffer.isMirrored())
+    {
+      const float* pSrc = vx.getConstBuffer();
+      std::copy(pSrc, pSrc + kFloatsPerDSPVector, srcBuf + mWriteIndex);
+
+      DSPVector vy;
+      uintptr_t readStart = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
+      std::copy(srcBuf + readStart, srcBuf + readStart + kFloatsPerDSPVector, vy.getBuffer());
+
+      mWriteIndex += kFloatsPerDSPVector;
+      mWriteIndex &= mLengthMask;
+      return vy;
+    }
+
     // write
     uintptr_t writeEnd = mWriteIndex + kFloatsPerDSPVector;
     if (writeEnd <= mLengthMask + 1)
     {
       const float* srcStart = vx.getConstBuffer();
-      std::copy(srcStart, srcStart + kFloatsPerDSPVector, mBuffer.data() + mWriteIndex);
+      std::copy(srcStart, srcStart + kFloatsPerDSPVector, srcBuf + mWriteIndex);
     }
     else
     {
@@ -855,15 +1100,14 @@ class IntegerDelay
       const float* srcStart = vx.getConstBuffer();
       const float* srcSplice = srcStart + kFloatsPerDSPVector - excess;
       const float* srcEnd = srcStart + kFloatsPerDSPVector;
-      std::copy(srcStart, srcSplice, mBuffer.data() + mWriteIndex);
-      std::copy(srcSplice, srcEnd, mBuffer.data());
+      std::copy(srcStart, srcSplice, srcBuf + mWriteIndex);
+      std::copy(srcSplice, srcEnd, srcBuf);
     }
 
     // read
     DSPVector vy;
     uintptr_t readStart = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
     uintptr_t readEnd = readStart + kFloatsPerDSPVector;
-    float* srcBuf = mBuffer.data();
     if (readEnd <= mLengthMask + 1)
     {
       std::copy(srcBuf + readStart, srcBuf + readEnd, vy.getBuffer());
@@ -890,13 +1134,13 @@ class IntegerDelay
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       // write
-      mBuffer[mWriteIndex] = x[n];
+      mBuffer.data()[mWriteIndex] = x[n];
 
       // read
       mIntDelayInSamples = static_cast<int>(delay[n]);
       uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
 
-      y[n] = mBuffer[readIndex];
+      y[n] = mBuffer.data()[readIndex];
       mWriteIndex++;
       mWriteIndex &= mLengthMask;
     }
@@ -909,11 +1153,11 @@ class IntegerDelay
     // write
     // note that, for performance, there is no bounds checking. If you crash
     // here, you probably didn't allocate enough delay memory.
-    mBuffer[mWriteIndex] = x;
+    mBuffer.data()[mWriteIndex] = x;
 
     // read
     uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
-    float y = mBuffer[readIndex];
+    float y = mBuffer.data()[readIndex];
 
     // update index
     mWriteIndex++;
@@ -960,6 +1204,12 @@ class Allpass1
     return y;
   }
 
+  // true if the state of b differs from ours by at most the tolerance.
+  inline bool stateIsNear(const Allpass1& b, float tolerance) const
+  {
+    return (fabsf(x1 - b.x1) <= tolerance) && (fabsf(y1 - b.y1) <= tolerance);
+  }
+
   inline DSPVector operator()(const DSPVector vx)
   {
     DSPVector vy;
@@ -997,11 +1247,12 @@ class FractionalDelay
     mAllpassSection.clear();
   }
 
-  inline void setDelayInSamples(float d)
+  // split the delay d into a whole number of samples and the coefficient of
+  // an allpass section for the remainder.
+  static inline void splitDelay(float d, int& delayInt, float& allpassCoeff)
   {
-    mDelayInSamples = d;
     float fDelayInt = floorf(d);
-    int delayInt = static_cast<int>(fDelayInt);
+    delayInt = static_cast<int>(fDelayInt);
     float delayFrac = d - fDelayInt;
 
     // constrain D to [0.618 - 1.618] if possible
@@ -1010,8 +1261,15 @@ class FractionalDelay
       delayFrac += 1.f;
       delayInt -= 1;
     }
+    allpassCoeff = Allpass1::coeffs(delayFrac);
+  }
+
+  inline void setDelayInSamples(float d)
+  {
+    mDelayInSamples = d;
+    int delayInt;
+    splitDelay(d, delayInt, mAllpassSection.mCoeff);
     mIntegerDelay.setDelayInSamples(delayInt);
-    mAllpassSection.mCoeff = Allpass1::coeffs(delayFrac);
   }
 
   inline void setMaxDelayInSamples(float d) { mIntegerDelay.setMaxDelayInSamples(floorf(d)); }
@@ -1054,12 +1312,15 @@ class FractionalDelay
 // Crossfading two allpass-interpolated delays allows modulating the delay
 // time without clicks. See "A Lossless, Click-free, Pitchbend-able Delay Line
 // Loop Interpolation Scheme", Van Duyne, Jaffe, Scandalis, Stilson, ICMC 1997.
+// While the delay time is constant, PitchbendableDelay runs only one of its
+// two delays.
 
 namespace PitchbendableDelayConsts
 {
 // period in samples of allpass fade cycle. must be a power of 2 less than or
-// equal to kFloatsPerDSPVector. 32 sounds good.
-constexpr int kFadePeriod{32};
+// equal to kFloatsPerDSPVector. 32 sounds good, so we use that unless the
+// vector is shorter.
+constexpr int kFadePeriod{kFloatsPerDSPVector < 32 ? (int)kFloatsPerDSPVector : 32};
 constexpr int fadeRamp(int n) { return n % kFadePeriod; }
 constexpr int ticks1(int n) { return fadeRamp(n) == kFadePeriod / 2; }
 constexpr int ticks2(int n) { return fadeRamp(n) == 0; }
@@ -1072,7 +1333,7 @@ constexpr float fadeFn(int n)
 
 // generate vectors of ticks indicating when delays can change
 // equality operators on vectors return 0 or 0xFFFFFFFF
-// note: mDelay1's delay time will be 0 when the object is created and before
+// note: the first delay's time will be 0 when the object is created and before
 // the first half fade period. so there is a warmup time of one half fade
 // period: any input before this will be attenuated.
 //
@@ -1082,34 +1343,311 @@ constexpr DSPVectorInt test1(fadeRamp);
 constexpr DSPVectorInt kvDelay1Changes(ticks1);
 constexpr DSPVectorInt kvDelay2Changes(ticks2);
 constexpr DSPVector kvFade(fadeFn);
+
+// the heads' allpass states converge by a factor of the coefficient each
+// sample. With delay fractions in [0.618 - 1.618] the coefficient is at most
+// this, and they converge well within a fade period. Shorter delays need
+// larger coefficients, so the states are compared instead.
+constexpr float kMaxConvergingCoeff{0.24f};
+constexpr float kStateTolerance{1e-7f};
 };  // namespace PitchbendableDelayConsts
 
 class PitchbendableDelay
 {
-  FractionalDelay mDelay1, mDelay2;
+  // a fractional delay reading from the shared buffer.
+  struct ReadHead
+  {
+    // no delay time is negative, so a new head never appears to have reached
+    // the delay time before it has been set.
+    float delayInSamples{-1.f};
+    int delayInt{0};
+    Allpass1 allpass{0.f};
+
+    inline void setDelayInSamples(float d)
+    {
+      delayInSamples = d;
+      FractionalDelay::splitDelay(d, delayInt, allpass.mCoeff);
+    }
+  };
+
+  // both heads read the same input, so it is written once to one buffer.
+  MirroredBuffer<float> mBuffer;
+  uintptr_t mWriteIndex{0};
+  uintptr_t mLengthMask{0};
+  ReadHead mHead1, mHead2;
+
+  // true while only mHead1 is running.
+  bool mStatic{false};
+
+  inline float read(ReadHead& head, int n)
+  {
+    float x = mBuffer.data()[(mWriteIndex + n - head.delayInt) & mLengthMask];
+    return head.allpass.processSample(x);
+  }
 
  public:
   PitchbendableDelay() = default;
 
   inline void setMaxDelayInSamples(float d)
   {
-    mDelay1.setMaxDelayInSamples(d);
-    mDelay2.setMaxDelayInSamples(d);
+    int dMax = static_cast<int>(floorf(d));
+    int newSize = 1 << bitsToContain(dMax + kFloatsPerDSPVector);
+
+    // if allocation fails, the previous buffer is kept.
+    size_t size = mBuffer.resize(newSize);
+    if (!size) return;
+    mLengthMask = size - 1;
+    mWriteIndex = 0;
   }
 
   inline void clear()
   {
-    mDelay1.clear();
-    mDelay2.clear();
+    std::fill(mBuffer.data(), mBuffer.data() + mBuffer.size(), 0.f);
+    mHead1.allpass.clear();
+    mHead2.allpass.clear();
   }
 
   inline DSPVector operator()(const DSPVector vInput, const DSPVector vDelayInSamples)
   {
     using namespace PitchbendableDelayConsts;
 
-    // run the fractional delays and crossfade the results.
-    return lerp(mDelay1(vInput, vDelayInSamples, kvDelay1Changes),
-                mDelay2(vInput, vDelayInSamples, kvDelay2Changes), kvFade);
+    // write the input. Delays of less than a vector read from it below.
+    const float* pSrc = vInput.getConstBuffer();
+    float* pBuf = mBuffer.data();
+    uintptr_t firstPart = mBuffer.isMirrored()
+                              ? kFloatsPerDSPVector
+                              : std::min<uintptr_t>(mLengthMask + 1 - mWriteIndex,
+                                                    kFloatsPerDSPVector);
+    std::copy(pSrc, pSrc + firstPart, pBuf + mWriteIndex);
+    std::copy(pSrc + firstPart, pSrc + kFloatsPerDSPVector, pBuf);
+
+    // when the delay time is constant and both heads have reached it and
+    // converged, the heads give the same output, so run only the first.
+    float d = mHead1.delayInSamples;
+    bool isStatic = (mHead2.delayInSamples == d);
+    for (size_t n = 0; isStatic && (n < kFloatsPerDSPVector); ++n)
+    {
+      isStatic = (vDelayInSamples[n] == d);
+    }
+    if (isStatic && !mStatic && (fabsf(mHead1.allpass.mCoeff) > kMaxConvergingCoeff))
+    {
+      isStatic = mHead1.allpass.stateIsNear(mHead2.allpass, kStateTolerance);
+    }
+
+    DSPVector vy;
+    if (isStatic)
+    {
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        vy[n] = read(mHead1, n);
+      }
+    }
+    else
+    {
+      // when modulation starts, the second head continues from the state of
+      // the first, so the handoff is seamless.
+      if (mStatic)
+      {
+        mHead2.allpass = mHead1.allpass;
+      }
+
+      // run both heads, changing the delay time of each only while its output
+      // is faded out, and crossfade the results.
+      for (size_t n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        if (kvDelay1Changes[n] != 0)
+        {
+          mHead1.setDelayInSamples(vDelayInSamples[n]);
+        }
+        if (kvDelay2Changes[n] != 0)
+        {
+          mHead2.setDelayInSamples(vDelayInSamples[n]);
+        }
+        float y1 = read(mHead1, n);
+        float y2 = read(mHead2, n);
+        vy[n] = y1 + kvFade[n] * (y2 - y1);
+      }
+    }
+    mStatic = isStatic;
+
+    mWriteIndex += kFloatsPerDSPVector;
+    mWriteIndex &= mLengthMask;
+    return vy;
+  }
+};
+
+// MultiTapDelay writes its input once to a single buffer, and reads TAPS
+// outputs from it, each with its own delay time in samples for every sample.
+// The taps are interpolated with INTERP: linear between two samples, or cubic
+// (Hermite) or third-order Lagrange between four. Delays are limited to the
+// range [getMinDelayInSamples(), getMaxDelayInSamples()].
+
+enum class TapInterpolation
+{
+  linear,
+  cubic,
+  lagrange
+};
+
+template <size_t TAPS, TapInterpolation INTERP = TapInterpolation::linear>
+class MultiTapDelay
+{
+  // the number of points read for each output. The four point interpolators
+  // read one sample newer than the delay, so need a delay of at least one.
+  static constexpr int kPoints = (INTERP == TapInterpolation::linear) ? 2 : 4;
+  static constexpr int kMinDelay = (INTERP == TapInterpolation::linear) ? 0 : 1;
+
+  MirroredBuffer<float> mBuffer;
+  uintptr_t mWriteIndex{0};
+  uintptr_t mLengthMask{0};
+  float mMaxDelay{0.f};
+
+  inline void write(const DSPVector& vx)
+  {
+    const float* pSrc = vx.getConstBuffer();
+    float* pBuf = mBuffer.data();
+    uintptr_t writeEnd = mWriteIndex + kFloatsPerDSPVector;
+    if (mBuffer.isMirrored() || (writeEnd <= mLengthMask + 1))
+    {
+      std::copy(pSrc, pSrc + kFloatsPerDSPVector, pBuf + mWriteIndex);
+    }
+    else
+    {
+      uintptr_t firstPart = mLengthMask + 1 - mWriteIndex;
+      std::copy(pSrc, pSrc + firstPart, pBuf + mWriteIndex);
+      std::copy(pSrc + firstPart, pSrc + kFloatsPerDSPVector, pBuf);
+    }
+  }
+
+  // gather the points around the delayed samples for one SIMD vector of
+  // outputs, starting at time n in the current DSPVector. In each lane,
+  // points[k] gets the sample kPoints / 2 - k samples older than the whole
+  // part of the delay.
+  inline void gather(uintptr_t n, const int32_t* pDelayInt, SIMDVectorFloat* points)
+  {
+    const float* pBuf = mBuffer.data();
+
+    // the index of the oldest point in the first lane.
+    uintptr_t start = mWriteIndex + n - kPoints / 2;
+    if (mBuffer.isMirrored())
+    {
+      // the points for each lane are contiguous, so load them together and
+      // transpose them into lanes.
+      SIMDVectorFloat rows[kFloatsPerSIMDVector];
+      for (int l = 0; l < kFloatsPerSIMDVector; ++l)
+      {
+        rows[l] = vecLoadUnaligned(pBuf + ((start + l - pDelayInt[l]) & mLengthMask));
+      }
+      vecTranspose(rows);
+      for (int k = 0; k < kPoints; ++k)
+      {
+        points[k] = rows[k];
+      }
+    }
+    else
+    {
+      float* pPoints = reinterpret_cast<float*>(points);
+      for (int l = 0; l < kFloatsPerSIMDVector; ++l)
+      {
+        uintptr_t i = start + l - pDelayInt[l];
+        for (int k = 0; k < kPoints; ++k)
+        {
+          pPoints[k * kFloatsPerSIMDVector + l] = pBuf[(i + k) & mLengthMask];
+        }
+      }
+    }
+  }
+
+  // interpolate the points at the fractions f of a sample past the whole
+  // delays.
+  static inline SIMDVectorFloat interpolate(const SIMDVectorFloat* points, SIMDVectorFloat f)
+  {
+    if constexpr (INTERP == TapInterpolation::linear)
+    {
+      return vecAdd(points[1], vecMul(f, vecSub(points[0], points[1])));
+    }
+    else
+    {
+      SIMDVectorFloat p2 = points[0], p1 = points[1], p0 = points[2], pm1 = points[3];
+      SIMDVectorFloat half = vecSet1(0.5f);
+      if constexpr (INTERP == TapInterpolation::cubic)
+      {
+        // as in herp().
+        SIMDVectorFloat c = vecMul(vecSub(p1, pm1), half);
+        SIMDVectorFloat v = vecSub(p0, p1);
+        SIMDVectorFloat w = vecAdd(c, v);
+        SIMDVectorFloat a = vecAdd(vecAdd(w, v), vecMul(vecSub(p2, p0), half));
+        SIMDVectorFloat b = vecAdd(w, a);
+        SIMDVectorFloat y = vecSub(vecMul(a, f), b);
+        y = vecAdd(vecMul(y, f), c);
+        return vecAdd(vecMul(y, f), p0);
+      }
+      else
+      {
+        // the Lagrange polynomial through the points at -1, 0, 1 and 2.
+        SIMDVectorFloat one = vecSet1(1.f);
+        SIMDVectorFloat fp1 = vecAdd(f, one);
+        SIMDVectorFloat fm1 = vecSub(f, one);
+        SIMDVectorFloat fm2 = vecSub(fm1, one);
+        SIMDVectorFloat fp1f = vecMul(fp1, f);
+        SIMDVectorFloat fm1fm2 = vecMul(fm1, fm2);
+        SIMDVectorFloat y0 = vecSub(vecMul(vecMul(p0, fp1), fm1fm2), vecMul(vecMul(p1, fp1f), fm2));
+        SIMDVectorFloat y1 = vecSub(vecMul(vecMul(p2, fp1f), fm1), vecMul(vecMul(pm1, f), fm1fm2));
+        return vecAdd(vecMul(y0, half), vecMul(y1, vecSet1(1.f / 6.f)));
+      }
+    }
+  }
+
+ public:
+  MultiTapDelay() = default;
+  MultiTapDelay(float d) { setMaxDelayInSamples(d); }
+
+  // allocate enough memory for delays up to d samples. Not real-time safe.
+  void setMaxDelayInSamples(float d)
+  {
+    // the buffer holds the current vector and the oldest interpolation point.
+    int dMax = static_cast<int>(ceilf(d));
+    int newSize = 1 << bitsToContain(dMax + kFloatsPerDSPVector + 2);
+    size_t size = mBuffer.resize(newSize);
+    if (!size) return;
+    mLengthMask = size - 1;
+    mMaxDelay = static_cast<float>(size - kFloatsPerDSPVector - 2);
+    mWriteIndex = 0;
+  }
+
+  static constexpr float getMinDelayInSamples() { return kMinDelay; }
+  float getMaxDelayInSamples() const { return mMaxDelay; }
+
+  inline void clear() { std::fill(mBuffer.data(), mBuffer.data() + mBuffer.size(), 0.f); }
+
+  // write the input vx and return the taps, where row j of the result is the
+  // input delayed by the times in row j of vDelays.
+  inline DSPVectorArray<TAPS> operator()(const DSPVector& vx, const DSPVectorArray<TAPS>& vDelays)
+  {
+    // the newest input is written first, so that delays shorter than a vector
+    // can read it.
+    write(vx);
+
+    DSPVectorArray<TAPS> vy;
+    const float* pDelays = vDelays.getConstBuffer();
+    float* py = vy.getBuffer();
+    SIMDVectorFloat minDelay = vecSet1(kMinDelay);
+    SIMDVectorFloat maxDelay = vecSet1(mMaxDelay);
+    for (size_t i = 0; i < kFloatsPerDSPVector * TAPS; i += kFloatsPerSIMDVector)
+    {
+      // split the delays into whole and fractional parts.
+      SIMDVectorFloat delay = vecClamp(vecLoad(pDelays + i), minDelay, maxDelay);
+      SIMDVectorInt delayInt = vecFloatToIntTruncate(delay);
+      SIMDVectorFloat f = vecSub(delay, vecIntToFloat(delayInt));
+
+      SIMDVectorFloat points[kFloatsPerSIMDVector];
+      gather(i & (kFloatsPerDSPVector - 1), reinterpret_cast<const int32_t*>(&delayInt), points);
+      vecStore(py + i, interpolate(points, f));
+    }
+
+    mWriteIndex += kFloatsPerDSPVector;
+    mWriteIndex &= mLengthMask;
+    return vy;
   }
 };
 
@@ -1163,29 +1701,220 @@ class Allpass
 };
 
 // FDN
-// A general Feedback Delay Network with N delay lines connected in an NxN
-// matrix.
-// TODO DELAY_TYPE parameter for modulation?
+// A general Feedback Delay Network with SIZE delay lines of type DELAY_TYPE
+// connected in a SIZE x SIZE orthogonal feedback matrix, with OUTPUTS output
+// taps. The feedback matrix is chosen by MATRIX:
+//   householder: the identity matrix minus a constant 2/SIZE, which costs
+//     O(SIZE) operations per sample.
+//   hadamard: a Walsh-Hadamard matrix, scaled by 1/sqrt(SIZE), which mixes
+//     all of the lines more densely in O(SIZE log SIZE) operations per sample
+//     with a fast Walsh-Hadamard transform. SIZE must be a power of two.
+// The delay lines and matrix operate on all the samples in a DSPVector at
+// once. Each line has a one-pole loss filter and a feedback gain, and these
+// run across the lines, with one line in each SIMD lane.
+
+enum class FDNMatrix
+{
+  householder,
+  hadamard
+};
 
-template <int SIZE>
+template <int SIZE, typename DELAY_TYPE = IntegerDelay, int OUTPUTS = 2,
+          FDNMatrix MATRIX = FDNMatrix::householder>
 class FDN
 {
-  std::array<IntegerDelay, SIZE> mDelays;
-  std::array<OnePole, SIZE> mFilters;
-  std::array<DSPVector, SIZE> mDelayInputVectors{{{DSPVector(0.f)}}};
+  static_assert((MATRIX != FDNMatrix::hadamard) || ((SIZE & (SIZE - 1)) == 0),
+                "FDN: the Hadamard matrix needs a power of two size");
+
+  using LineVectors = DSPVectorArray<SIZE>;
+
+  std::array<DELAY_TYPE, SIZE> mDelays;
+  LineVectors mDelayInputs{0.f};
+  LineVectors mDelayOutputs{0.f};
+
+  // the loss filters, with one line in each float so that groups of lines
+  // can be loaded into SIMD vectors.
+  std::array<float, SIZE> mFilterA0, mFilterB1, mFilterState{};
+
+  // mix the rows of y with the feedback matrix, in place. The scale of the
+  // Hadamard matrix is applied in filterRows().
+  static inline void mixRows(LineVectors& y)
+  {
+    float* py = y.getBuffer();
+    if constexpr (MATRIX == FDNMatrix::householder)
+    {
+      for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat sum = vecZeros();
+        for (int n = 0; n < SIZE; ++n)
+        {
+          sum = vecAdd(sum, vecLoad(py + n * kFloatsPerDSPVector + t));
+        }
+        sum = vecMul(sum, vecSet1(2.0f / SIZE));
+        for (int n = 0; n < SIZE; ++n)
+        {
+          float* p = py + n * kFloatsPerDSPVector + t;
+          vecStore(p, vecSub(vecLoad(p), sum));
+        }
+      }
+    }
+    else
+    {
+      // each stage of the transform adds and subtracts pairs of rows.
+      for (int h = 1; h < SIZE; h *= 2)
+      {
+        for (int i = 0; i < SIZE; i += 2 * h)
+        {
+          for (int j = i; j < i + h; ++j)
+          {
+            float* pa = py + j * kFloatsPerDSPVector;
+            float* pb = py + (j + h) * kFloatsPerDSPVector;
+            for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+            {
+              SIMDVectorFloat a = vecLoad(pa + t);
+              SIMDVectorFloat b = vecLoad(pb + t);
+              vecStore(pa + t, vecAdd(a, b));
+              vecStore(pb + t, vecSub(a, b));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // run the loss filters on the rows of y in place, then apply the feedback
+  // gains and add the input x.
+  inline void filterRows(LineVectors& y, const DSPVector& x)
+  {
+    // the filters are linear, so the matrix scale can be applied with the gains.
+    const float kMatrixScale = (MATRIX == FDNMatrix::hadamard) ? 1.f / sqrtf(SIZE) : 1.f;
+    float* py = y.getBuffer();
+    const float* px = x.getConstBuffer();
+
+    // groups of kFloatsPerSIMDVector lines, transposing square blocks of lines
+    // and samples so that each SIMD vector has one time of each line.
+    constexpr int kGroupedLines = SIZE - SIZE % kFloatsPerSIMDVector;
+    for (int g = 0; g < kGroupedLines; g += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat a0 = vecLoadUnaligned(mFilterA0.data() + g);
+      SIMDVectorFloat b1 = vecLoadUnaligned(mFilterB1.data() + g);
+      SIMDVectorFloat gain =
+          vecMul(vecLoadUnaligned(mFeedbackGains.data() + g), vecSet1(kMatrixScale));
+      SIMDVectorFloat y1 = vecLoadUnaligned(mFilterState.data() + g);
+      float* pGroup = py + g * kFloatsPerDSPVector;
+
+      SIMDVectorFloat block[kFloatsPerSIMDVector];
+      for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+      {
+        for (int l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          block[l] = vecLoad(pGroup + l * kFloatsPerDSPVector + t);
+        }
+        vecTranspose(block);
+        for (int l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          y1 = vecAdd(vecMul(a0, block[l]), vecMul(b1, y1));
+          block[l] = vecMul(y1, gain);
+        }
+        vecTranspose(block);
+        SIMDVectorFloat vx = vecLoad(px + t);
+        for (int l = 0; l < kFloatsPerSIMDVector; ++l)
+        {
+          vecStore(pGroup + l * kFloatsPerDSPVector + t, vecAdd(block[l], vx));
+        }
+      }
+      vecStoreUnaligned(mFilterState.data() + g, y1);
+    }
+
+    // any remaining lines, one at a time.
+    for (int n = kGroupedLines; n < SIZE; ++n)
+    {
+      float a0 = mFilterA0[n], b1 = mFilterB1[n];
+      float gain = mFeedbackGains[n] * kMatrixScale;
+      float y1 = mFilterState[n];
+      float* pLine = py + n * kFloatsPerDSPVector;
+      for (size_t t = 0; t < kFloatsPerDSPVector; ++t)
+      {
+        y1 = a0 * pLine[t] + b1 * y1;
+        pLine[t] = y1 * gain + px[t];
+      }
+      mFilterState[n] = y1;
+    }
+  }
+
+  // sum the delay outputs to the output taps.
+  inline DSPVectorArray<OUTPUTS> sumOutputs() const
+  {
+    DSPVectorArray<OUTPUTS> vy;
+    const float* px = mDelayOutputs.getConstBuffer();
+    for (int j = 0; j < OUTPUTS; ++j)
+    {
+      float* py = vy.getRowData(j);
+      for (size_t t = 0; t < kFloatsPerDSPVector; t += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat sum = vecZeros();
+        for (int n = 0; n < SIZE; ++n)
+        {
+          SIMDVectorFloat x = vecLoad(px + n * kFloatsPerDSPVector + t);
+          sum = vecAdd(sum, vecMul(x, vecSet1(mOutputGains[j][n])));
+        }
+        vecStore(py + t, sum);
+      }
+    }
+    return vy;
+  }
+
+  inline DSPVectorArray<OUTPUTS> mixAndFeedBack(const DSPVector& x)
+  {
+    DSPVectorArray<OUTPUTS> vy = sumOutputs();
+    mDelayInputs = mDelayOutputs;
+    mixRows(mDelayInputs);
+    filterRows(mDelayInputs, x);
+    return vy;
+  }
 
  public:
   // feedback gains array is public—just copy values to set.
   std::array<float, SIZE> mFeedbackGains{{0}};
 
+  // the gain from each delay line to each output tap, also public. By default
+  // the lines are dealt out to the outputs in turn, so that with two outputs,
+  // the odd lines go to output 0 and the even lines to output 1.
+  std::array<std::array<float, SIZE>, OUTPUTS> mOutputGains{};
+
+  FDN()
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      mOutputGains[(n + 1) % OUTPUTS][n] = 1.f;
+    }
+
+    // the filters pass their inputs through until the cutoffs are set.
+    auto c = ml::OnePole::passthru();
+    mFilterA0.fill(c.a0);
+    mFilterB1.fill(c.b1);
+  }
+
+  // allocate the delay lines for modulated delay times up to d samples.
+  void setMaxDelayInSamples(float d)
+  {
+    for (auto& delay : mDelays)
+    {
+      delay.setMaxDelayInSamples(d);
+    }
+  }
+
+  // set constant delay times, with a DELAY_TYPE such as IntegerDelay or
+  // FractionalDelay, allocating each line to fit. The minimum delay time is
+  // kFloatsPerDSPVector.
   void setDelaysInSamples(std::array<float, SIZE> times)
   {
     for (int n = 0; n < SIZE; ++n)
     {
       // we have one DSPVector feedback latency, so compensate delay times for
       // that.
-      int len = times[n] - kFloatsPerDSPVector;
-      len = max(1, len);
+      float len = std::max(1.f, times[n] - kFloatsPerDSPVector);
+      mDelays[n].setMaxDelayInSamples(len);
       mDelays[n].setDelayInSamples(len);
     }
   }
@@ -1194,55 +1923,47 @@ class FDN
   {
     for (int n = 0; n < SIZE; ++n)
     {
-      mFilters[n].mCoeffs = ml::OnePole::coeffs(omegas[n]);
+      auto c = ml::OnePole::coeffs(omegas[n]);
+      mFilterA0[n] = c.a0;
+      mFilterB1[n] = c.b1;
     }
   }
 
-  // stereo output function
-  // TODO generalize n-channel output function somehow
-  DSPVectorArray<2> operator()(const DSPVector x)
+  void clear()
   {
-    // run delays, getting DSPVector for each delay
-    for (int n = 0; n < SIZE; ++n)
+    for (auto& delay : mDelays)
     {
-      mDelayInputVectors[n] = mDelays[n](mDelayInputVectors[n]);
-    }
-
-    // get output sum
-    DSPVector sumR, sumL;
-    for (int n = 0; n < (SIZE & (~1)); ++n)
-    {
-      if (n & 1)
-      {
-        sumL += mDelayInputVectors[n];
-      }
-      else
-      {
-        sumR += mDelayInputVectors[n];
-      }
+      delay.clear();
     }
+    mDelayInputs = 0.f;
+    mDelayOutputs = 0.f;
+    mFilterState.fill(0.f);
+  }
 
-    // inputs = input gains*input sample + filters(M*delay outputs)
-    // The feedback matrix M is a unit-gain Householder matrix, which is just
-    // the identity matrix minus a constant k, where k = 2/size. Since
-    // multiplying this can be simplified so much, you just see a few operations
-    // here, not a general matrix multiply.
-
-    DSPVector sumOfDelays;
+  // process the input x with constant delay times.
+  DSPVectorArray<OUTPUTS> operator()(const DSPVector x)
+  {
     for (int n = 0; n < SIZE; ++n)
     {
-      sumOfDelays += mDelayInputVectors[n];
+      DSPVector y = mDelays[n](DSPVector(mDelayInputs.getRowDataConst(n)));
+      store(y, mDelayOutputs.getRowData(n));
     }
-    sumOfDelays *= DSPVector(2.0f / SIZE);
+    return mixAndFeedBack(x);
+  }
 
+  // process the input x with the delay time of line n in samples on row n of
+  // vDelayTimes, with a DELAY_TYPE such as PitchbendableDelay. The minimum
+  // delay time is kFloatsPerDSPVector.
+  DSPVectorArray<OUTPUTS> operator()(const DSPVector x, const LineVectors& vDelayTimes)
+  {
+    DSPVector vLatency(kFloatsPerDSPVector);
     for (int n = 0; n < SIZE; ++n)
     {
-      mDelayInputVectors[n] -= (sumOfDelays);
-      mDelayInputVectors[n] = mFilters[n](mDelayInputVectors[n]) * DSPVector(mFeedbackGains[n]);
-      mDelayInputVectors[n] += x;
+      DSPVector vDelay(vDelayTimes.getRowDataConst(n));
+      DSPVector y = mDelays[n](DSPVector(mDelayInputs.getRowDataConst(n)), vDelay - vLatency);
+      store(y, mDelayOutputs.getRowData(n));
     }
-
-    return concatRows(sumL, sumR);
+    return mixAndFeedBack(x);
   }
 };
 
@@ -1253,68 +1974,108 @@ class FDN
 class HalfBandFilter
 {
  public:
-  inline DSPVector upsampleFirstHalf(const DSPVector vx)
+  // allpass coefficients. order=4, rejection=70dB, transition band=0.1.
+  static constexpr float kA0{0.07986642623635751f}, kA1{0.5453536510711322f},
+      kB0{0.28382934487410993f}, kB1{0.8344118914807379f};
+
+  // the group delay at low frequencies, in samples at the higher rate, for
+  // either upsampling or downsampling. Each branch runs at the lower rate
+  // through allpasses (a + z^-1) / (1 + a z^-1), which each delay by
+  // (1 - a) / (1 + a) of its samples, and the branches are offset by one
+  // sample at the higher rate.
+  static constexpr float kGroupDelay = (1.f - kA0) / (1.f + kA0) + (1.f - kA1) / (1.f + kA1) +
+                                       (1.f - kB0) / (1.f + kB0) + (1.f - kB1) / (1.f + kB1) +
+                                       0.5f;
+
+  // upsample the kFloatsPerDSPVector samples at px to twice as many at py.
+  // px may be the same as py + kFloatsPerDSPVector, so that a cascade can work
+  // in place.
+  inline void upsample(const float* px, float* py) { upsample(px, py, kFloatsPerDSPVector); }
+
+  // upsample the input vector vx, returning the first half of the output in
+  // row 0 and the second half in row 1.
+  inline DSPVectorArray<2> upsample(const DSPVector& vx)
+  {
+    DSPVectorArray<2> vy;
+    upsample(vx.getConstBuffer(), vy.getBuffer());
+    return vy;
+  }
+
+  inline DSPVector upsampleFirstHalf(const DSPVector& vx)
   {
     DSPVector vy;
-    int i2 = 0;
-    for (int i = 0; i < kFloatsPerDSPVector / 2; ++i)
-    {
-      vy[i2++] = apa1.processSample(apa0.processSample(vx[i]));
-      vy[i2++] = apb1.processSample(apb0.processSample(vx[i]));
-    }
+    upsample(vx.getConstBuffer(), vy.getBuffer(), kFloatsPerDSPVector / 2);
     return vy;
   }
 
-  inline DSPVector upsampleSecondHalf(const DSPVector vx)
+  inline DSPVector upsampleSecondHalf(const DSPVector& vx)
   {
     DSPVector vy;
-    int i2 = 0;
-    for (int i = kFloatsPerDSPVector / 2; i < kFloatsPerDSPVector; ++i)
-    {
-      vy[i2++] = apa1.processSample(apa0.processSample(vx[i]));
-      vy[i2++] = apb1.processSample(apb0.processSample(vx[i]));
-    }
+    upsample(vx.getConstBuffer() + kFloatsPerDSPVector / 2, vy.getBuffer(),
+             kFloatsPerDSPVector / 2);
     return vy;
   }
 
-  inline DSPVector downsample(const DSPVector vx1, const DSPVector vx2)
+  // downsample the 2 * kFloatsPerDSPVector samples at px to half as many at
+  // py. py may be the same as px.
+  inline void downsample(const float* px, float* py)
   {
-    DSPVector vy;
-    int i2 = 0;
-    for (int i = 0; i < kFloatsPerDSPVector / 2; ++i)
-    {
-      float a0 = apa1.processSample(apa0.processSample(vx1[i2]));
-      float b0 = apb1.processSample(apb0.processSample(vx1[i2 + 1]));
-      vy[i] = (a0 + b1) * 0.5f;
-      b1 = b0;
-      i2 += 2;
-    }
-    i2 = 0;
-    for (int i = kFloatsPerDSPVector / 2; i < kFloatsPerDSPVector; ++i)
+    // copy the state to locals, which the compiler can keep in registers
+    // because the output cannot alias them.
+    Allpass1 a0{apa0}, a1{apa1}, b0{apb0}, b1{apb1};
+    float bPrev = _b1;
+    for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
     {
-      float a0 = apa1.processSample(apa0.processSample(vx2[i2]));
-      float b0 = apb1.processSample(apb0.processSample(vx2[i2 + 1]));
-      vy[i] = (a0 + b1) * 0.5f;
-      b1 = b0;
-      i2 += 2;
+      float a = a1.processSample(a0.processSample(px[2 * i]));
+      float b = b1.processSample(b0.processSample(px[2 * i + 1]));
+      py[i] = (a + bPrev) * 0.5f;
+      bPrev = b;
     }
+    apa0 = a0;
+    apa1 = a1;
+    apb0 = b0;
+    apb1 = b1;
+    _b1 = bPrev;
+  }
+
+  inline DSPVector downsample(const DSPVector& vx1, const DSPVector& vx2)
+  {
+    DSPVectorArray<2> vx;
+    vx.row(0) = vx1;
+    vx.row(1) = vx2;
+    DSPVector vy;
+    downsample(vx.getConstBuffer(), vy.getBuffer());
     return vy;
   }
-  
+
   void clear()
   {
     apa0.clear();
     apa1.clear();
     apb0.clear();
     apb1.clear();
-    b1 = 0;
+    _b1 = 0;
   }
 
  private:
-  // order=4, rejection=70dB, transition band=0.1.
-  Allpass1 apa0{0.07986642623635751f}, apa1{0.5453536510711322f}, apb0{0.28382934487410993f},
-      apb1{0.8344118914807379f};
-  float b1{0};
+  // upsample n samples at px to 2n samples at py.
+  inline void upsample(const float* px, float* py, int n)
+  {
+    Allpass1 a0{apa0}, a1{apa1}, b0{apb0}, b1{apb1};
+    for (int i = 0; i < n; ++i)
+    {
+      float x = px[i];
+      py[2 * i] = a1.processSample(a0.processSample(x));
+      py[2 * i + 1] = b1.processSample(b0.processSample(x));
+    }
+    apa0 = a0;
+    apa1 = a1;
+    apb0 = b0;
+    apb1 = b1;
+  }
+
+  Allpass1 apa0{kA0}, apa1{kA1}, apb0{kB0}, apb1{kB1};
+  float _b1{0};
 };
 
 // Downsampler
@@ -1374,12 +2135,9 @@ class Downsampler
         mask <<= 1;
         bool b1 = _counter & mask;
 
-        // run filter
-        HalfBandFilter* f = &(_filters[h]);
-        DSPVector vSrc1(bufferPtr(h * 2));
-        DSPVector vSrc2(bufferPtr(h * 2 + 1));
-        DSPVector vDest = f->downsample(vSrc1, vSrc2);
-        store(vDest, bufferPtr(h * 2 + 2 + b1));
+        // run filter from the pair of buffers for this octave to one of the
+        // pair for the next.
+        _filters[h].downsample(bufferPtr(h * 2), bufferPtr(h * 2 + 2 + b1));
       }
 
       // advance and wrap counter. If it's back to 0, we have output
@@ -1456,14 +2214,10 @@ struct Upsampler
       int srcStart = _numBuffers - sourceBufs;
       int destStart = _numBuffers - destBufs;
 
+      // each source buffer is read before it is overwritten.
       for(int i=0; i < sourceBufs; ++i)
       {
-        DSPVector src, dest1, dest2;
-        load(src, bufferPtr(srcStart + i));
-        dest1 = _filters[j].upsampleFirstHalf(src);
-        dest2 = _filters[j].upsampleSecondHalf(src);
-        store(dest1, bufferPtr(destStart + (i*2)));
-        store(dest2, bufferPtr(destStart + (i*2) + 1));
+        _filters[j].upsample(bufferPtr(srcStart + i), bufferPtr(destStart + (i*2)));
       }
     }
     readIdx_ = 0;
@@ -1472,16 +2226,7 @@ struct Upsampler
   // after a write, 1 << octaves reads are available.
   DSPVector read()
   {
-    DSPVector result;
-    load(result, bufferPtr(readIdx_++));
-    
-    // TEMP
-    if(!validate(result))
-    {
-      std::cout << "bad!\n";
-      
-    }
-    return result;
+    return DSPVector(bufferPtr(readIdx_++));
   }
   
   void clear()
@@ -9,19 +9,33 @@
 #pragma once
 
 #include <functional>
+#include <type_traits>
 
+#include "MLDSPFFT.h"
 #include "MLDSPFilters.h"
+#include "MLDSPUtils.h"
 
 namespace ml
 {
 // ----------------------------------------------------------------
 // basic higher-order functions
+//
+// Each map() takes its function as a template parameter, so that lambdas and
+// function objects can be inlined into the loop. Overloads taking
+// std::function are kept for compatibility, but each call through them is an
+// indirect call that can't be inlined or vectorized.
+
+// enable a template if F can be called with Args and returns something
+// convertible to R.
+template <typename F, typename R, typename... Args>
+using EnableIfCallable =
+    typename std::enable_if<std::is_invocable_r<R, F, Args...>::value, int>::type;
 
 // Evaluate a function (void)->(float), store at each element of the
 // DSPVectorArray and return the result. x is a dummy argument just used to
 // infer the vector size.
-template <size_t ROWS>
-inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<ROWS> x)
+template <typename F, size_t ROWS, EnableIfCallable<F, float> = 0>
+inline DSPVectorArray<ROWS> map(F&& f, const DSPVectorArray<ROWS>& x)
 {
   DSPVectorArray<ROWS> y;
   for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
@@ -33,6 +47,73 @@ inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<R
 
 // Apply a function (float)->(float) to each element of the DSPVectorArray x and
 // return the result.
+template <typename F, size_t ROWS, EnableIfCallable<F, float, float> = 0>
+inline DSPVectorArray<ROWS> map(F&& f, const DSPVectorArray<ROWS>& x)
+{
+  DSPVectorArray<ROWS> y;
+  const float* px = x.getConstBuffer();
+  float* py = y.getBuffer();
+  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  {
+    py[n] = f(px[n]);
+  }
+  return y;
+}
+
+// Apply a function (int)->(float) to each element of the DSPVectorArrayInt x
+// and return the result.
+template <typename F, size_t ROWS, EnableIfCallable<F, float, int> = 0>
+inline DSPVectorArray<ROWS> map(F&& f, const DSPVectorArrayInt<ROWS>& x)
+{
+  DSPVectorArray<ROWS> y;
+  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  {
+    y[n] = f(x[n]);
+  }
+  return y;
+}
+
+// Apply a function (DSPVector)->(DSPVector) to each row of the DSPVectorArray x
+// and return the result.
+template <typename F, size_t ROWS, EnableIfCallable<F, DSPVector, const DSPVector> = 0>
+inline DSPVectorArray<ROWS> map(F&& f, const DSPVectorArray<ROWS>& x)
+{
+  DSPVectorArray<ROWS> y;
+  for (int j = 0; j < ROWS; ++j)
+  {
+    y.row(j) = f(x.constRow(j));
+  }
+  return y;
+}
+
+// Apply a function (DSPVector, int row)->(DSPVector) to each row of the
+// DSPVectorArray x and return the result.
+template <typename F, size_t ROWS, EnableIfCallable<F, DSPVector, const DSPVector, int> = 0>
+inline DSPVectorArray<ROWS> map(F&& f, const DSPVectorArray<ROWS>& x)
+{
+  DSPVectorArray<ROWS> y;
+  for (int j = 0; j < ROWS; ++j)
+  {
+    y.row(j) = f(x.constRow(j), j);
+  }
+  return y;
+}
+
+// std::function versions of the above.
+
+// (void)->(float)
+template <size_t ROWS>
+inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<ROWS> x)
+{
+  DSPVectorArray<ROWS> y;
+  for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
+  {
+    y[n] = f();
+  }
+  return y;
+}
+
+// (float)->(float)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<float(float)> f, const DSPVectorArray<ROWS> x)
 {
@@ -44,8 +125,7 @@ inline DSPVectorArray<ROWS> map(std::function<float(float)> f, const DSPVectorAr
   return y;
 }
 
-// Apply a function (int)->(float) to each element of the DSPVectorArrayInt x
-// and return the result.
+// (int)->(float)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<float(int)> f, const DSPVectorArrayInt<ROWS> x)
 {
@@ -57,8 +137,7 @@ inline DSPVectorArray<ROWS> map(std::function<float(int)> f, const DSPVectorArra
   return y;
 }
 
-// Apply a function (DSPVector)->(DSPVector) to each row of the DSPVectorArray x
-// and return the result.
+// (DSPVector)->(DSPVector)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector)> f,
                                 const DSPVectorArray<ROWS> x)
@@ -71,8 +150,7 @@ inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector)> f,
   return y;
 }
 
-// Apply a function (DSPVector, int row)->(DSPVector) to each row of the
-// DSPVectorArray x and return the result.
+// (DSPVector, int row)->(DSPVector)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector, int)> f,
                                 const DSPVectorArray<ROWS> x)
@@ -124,16 +202,16 @@ class Upsample2xFunction
 
  public:
   // operator() takes two arguments: a process function and an input
-  // DSPVectorArray.
-  inline outputType operator()(ProcessFn fn, inputType vx)
+  // DSPVectorArray. The process function can be any callable object.
+  template <typename F>
+  inline outputType operator()(F&& fn, inputType vx)
   {
     // upsample each row of input to 2x buffers
     for (int j = 0; j < IN_ROWS; ++j)
     {
-      DSPVector x1a = mUppers[j].upsampleFirstHalf(vx.constRow(j));
-      DSPVector x1b = mUppers[j].upsampleSecondHalf(vx.constRow(j));
-      mUpsampledInput1.row(j) = x1a;
-      mUpsampledInput2.row(j) = x1b;
+      auto x2 = mUppers[j].upsample(vx.constRow(j));
+      mUpsampledInput1.row(j) = x2.constRow(0);
+      mUpsampledInput2.row(j) = x2.constRow(1);
     }
 
     // process upsampled input
@@ -150,6 +228,12 @@ class Upsample2xFunction
     return vy;
   }
 
+  // std::function version, kept for compatibility
+  inline outputType operator()(ProcessFn fn, inputType vx)
+  {
+    return operator()<ProcessFn&>(fn, vx);
+  }
+
  private:
   std::array<HalfBandFilter, IN_ROWS> mUppers;
   std::array<HalfBandFilter, OUT_ROWS> mDowners;
@@ -177,8 +261,10 @@ class Downsample2xFunction
  public:
   // operator() takes two arguments: a process function and an input
   // DSPVectorArray. The optional argument DSPVectorArray<0>() allows passing
-  // only one argument in the case of a generator with 0 input rows.
-  inline DSPVectorArray<OUT_ROWS> operator()(ProcessFn fn,
+  // only one argument in the case of a generator with 0 input rows. The
+  // process function can be any callable object.
+  template <typename F>
+  inline DSPVectorArray<OUT_ROWS> operator()(F&& fn,
                                              const DSPVectorArray<IN_ROWS> vx = DSPVectorArray<0>())
   {
     DSPVectorArray<OUT_ROWS> vy;
@@ -196,11 +282,10 @@ class Downsample2xFunction
       // upsample each processed row to output
       for (int j = 0; j < OUT_ROWS; ++j)
       {
-        // first half is returned
-        vy.row(j) = mUppers[j].upsampleFirstHalf(mDownsampledOutput.constRow(j));
-
-        // second half is buffered
-        mOutputBuffer.row(j) = mUppers[j].upsampleSecondHalf(mDownsampledOutput.constRow(j));
+        // first half is returned, second half is buffered
+        auto y2 = mUppers[j].upsample(mDownsampledOutput.constRow(j));
+        vy.row(j) = y2.constRow(0);
+        mOutputBuffer.row(j) = y2.constRow(1);
       }
     }
     else
@@ -214,6 +299,13 @@ class Downsample2xFunction
     return vy;
   }
 
+  // std::function version, kept for compatibility
+  inline DSPVectorArray<OUT_ROWS> operator()(ProcessFn fn,
+                                             const DSPVectorArray<IN_ROWS> vx = DSPVectorArray<0>())
+  {
+    return operator()<ProcessFn&>(fn, vx);
+  }
+
  private:
   std::array<HalfBandFilter, IN_ROWS> mDowners;
   std::array<HalfBandFilter, OUT_ROWS> mUppers;
@@ -224,25 +316,288 @@ class Downsample2xFunction
   bool mPhase{false};
 };
 
-// OverlapAddFunction TODO
-/*
-template<int LENGTH, int DIVISIONS, int IN_ROWS, int OUT_ROWS>
-class OverlapAddFunction
+// OversampleFunction is a function object that given a process function f,
+// upsamples each row of the input x by FACTOR, applies f to each of the
+// FACTOR DSPVectorArrays of upsampled input in turn, downsamples each row of
+// the results and returns them. FACTOR must be a power of two. Each octave of
+// resampling runs a HalfBandFilter in place in a fixed buffer, so nothing is
+// allocated after construction.
+
+template <int FACTOR, int IN_ROWS, int OUT_ROWS>
+class OversampleFunction
 {
-        typedef std::function<DSPVectorArray<OUT_ROWS>(const
-DSPVectorArray<IN_ROWS>)> ProcessFn;
+  static_assert(FACTOR > 0 && (FACTOR & (FACTOR - 1)) == 0, "FACTOR must be a power of two");
+
+  static constexpr int kOctaves = static_cast<int>(bitsToContain(FACTOR));
+  static constexpr int kLength = kFloatsPerDSPVector;
+
+  using inputType = DSPVectorArray<IN_ROWS>;
+  using outputType = DSPVectorArray<OUT_ROWS>;
+
+ public:
+  // the delay at low frequencies of the upsampling and downsampling filters
+  // together, in samples at the original rate. Octave k of each cascade runs
+  // at 2^(k + 1) times the original rate.
+  static constexpr float getLatency()
+  {
+    return 2.f * HalfBandFilter::kGroupDelay * (1.f - 1.f / FACTOR);
+  }
+
+  // operator() takes two arguments: a process function and an input
+  // DSPVectorArray. The process function can be any callable object taking a
+  // DSPVectorArray<IN_ROWS> and returning a DSPVectorArray<OUT_ROWS>.
+  template <typename F>
+  inline outputType operator()(F&& fn, const inputType& vx)
+  {
+    // upsample each row, one octave at a time. Octave k reads 2^k vectors
+    // from the end of the buffer and writes twice as many ending at the end.
+    for (int j = 0; j < IN_ROWS; ++j)
+    {
+      float* pBuf = mUpsampled[j].getBuffer();
+      const float* pSrc = vx.getRowDataConst(j);
+      std::copy(pSrc, pSrc + kLength, pBuf + (FACTOR - 1) * kLength);
+      for (int k = 0; k < kOctaves; ++k)
+      {
+        int srcStart = FACTOR - (1 << k);
+        int destStart = FACTOR - (2 << k);
+        for (int i = 0; i < (1 << k); ++i)
+        {
+          // each source vector is read before it is overwritten.
+          mUppers[j][k].upsample(pBuf + (srcStart + i) * kLength,
+                                 pBuf + (destStart + i * 2) * kLength);
+        }
+      }
+    }
+
+    // process each vector of upsampled input. Rows are moved as floats,
+    // because row() would access the arrays through a different type.
+    for (int i = 0; i < FACTOR; ++i)
+    {
+      inputType x;
+      for (int j = 0; j < IN_ROWS; ++j)
+      {
+        const float* pSrc = mUpsampled[j].getRowDataConst(i);
+        std::copy(pSrc, pSrc + kLength, x.getRowData(j));
+      }
+      outputType y = fn(x);
+      for (int j = 0; j < OUT_ROWS; ++j)
+      {
+        const float* pSrc = y.getRowDataConst(j);
+        std::copy(pSrc, pSrc + kLength, mProcessed[j].getRowData(i));
+      }
+    }
 
-public:
-        inline DSPVectorArray<OUT_ROWS> operator()(ProcessFn fn, const
-DSPVectorArray<IN_ROWS> vx)
+    // downsample each row, one octave at a time, in place from the start of
+    // the buffer.
+    outputType vy;
+    for (int j = 0; j < OUT_ROWS; ++j)
+    {
+      float* pBuf = mProcessed[j].getBuffer();
+      for (int k = kOctaves - 1; k >= 0; --k)
+      {
+        for (int i = 0; i < (1 << k); ++i)
         {
+          mDowners[j][k].downsample(pBuf + (i * 2) * kLength, pBuf + i * kLength);
         }
+      }
+      const float* pSrc = mProcessed[j].getConstBuffer();
+      std::copy(pSrc, pSrc + kLength, vy.getRowData(j));
+    }
+    return vy;
+  }
 
-private:
-        //Matrix mHistory;
-        const DSPVector& mWindow;
+  void clear()
+  {
+    for (auto& row : mUppers)
+    {
+      for (auto& f : row) f.clear();
+    }
+    for (auto& row : mDowners)
+    {
+      for (auto& f : row) f.clear();
+    }
+  }
+
+ private:
+  std::array<std::array<HalfBandFilter, kOctaves>, IN_ROWS> mUppers;
+  std::array<std::array<HalfBandFilter, kOctaves>, OUT_ROWS> mDowners;
+  std::array<DSPVectorArray<FACTOR>, IN_ROWS> mUpsampled;
+  std::array<DSPVectorArray<FACTOR>, OUT_ROWS> mProcessed;
+};
+
+// OverlapAddFunction is a function object that given a frame function f,
+// cuts each row of the input x into frames of LENGTH samples, DIVISIONS
+// frames per LENGTH, so that DIVISIONS = 4 gives 75% overlap. Each frame is
+// multiplied by the analysis window and passed to f, and each frame f writes
+// is multiplied by the synthesis window and overlap-added to the output.
+//
+// f is called as f(const InputFrames& in, OutputFrames& out), where the frame
+// of input row j is in rows j * kFrameRows to (j + 1) * kFrameRows - 1 of in,
+// and likewise for out. f must write every sample of out. The windows,
+// buffers and frames are all allocated on construction, so operator() does
+// not allocate.
+//
+// The synthesis window is the analysis window divided by the sum of the
+// squares of the overlapping windows, so that if f copies in to out, the
+// output is the input delayed by getLatency() samples.
+
+template <int LENGTH, int DIVISIONS, int IN_ROWS, int OUT_ROWS>
+class OverlapAddFunction
+{
+  static_assert(LENGTH % kFloatsPerDSPVector == 0,
+                "LENGTH must be a multiple of kFloatsPerDSPVector");
+  static_assert(LENGTH % DIVISIONS == 0, "LENGTH must be divisible by DIVISIONS");
+  static_assert(IN_ROWS > 0, "OverlapAddFunction needs at least one input row");
+
+ public:
+  static constexpr int kFrameRows = LENGTH / kFloatsPerDSPVector;
+  static constexpr int kHop = LENGTH / DIVISIONS;
+  static constexpr int kOverlap = LENGTH - kHop;
+
+  using InputFrames = DSPVectorArray<IN_ROWS * kFrameRows>;
+  using OutputFrames = DSPVectorArray<OUT_ROWS * kFrameRows>;
+
+  // make the windows from windowShape, a projection from [0, 1] onto the
+  // window.
+  explicit OverlapAddFunction(Projection windowShape = dspwindows::raisedCosine)
+  {
+    // make a periodic window, so that the overlapped windows sum evenly.
+    float* pAnalysis = mAnalysisWindow.getBuffer();
+    float* pSynthesis = mSynthesisWindow.getBuffer();
+    auto domainToUnity = projections::linear({0.f, (float)LENGTH}, {0.f, 1.f});
+    mapIndices(pAnalysis, LENGTH, compose(windowShape, domainToUnity));
+    for (int n = 0; n < LENGTH; ++n)
+    {
+      float sumOfSquares{0.f};
+      for (int m = n % kHop; m < LENGTH; m += kHop)
+      {
+        sumOfSquares += pAnalysis[m] * pAnalysis[m];
+      }
+      pSynthesis[n] = (sumOfSquares > 0.f) ? pAnalysis[n] / sumOfSquares : 0.f;
+    }
+
+    // start the inputs with enough silence that the first frame is read after
+    // one hop of input, and the outputs with one hop of silence so that
+    // output is always available.
+    for (auto& b : mInputBuffers)
+    {
+      b.resize(LENGTH * 2);
+      b.write(mInputFrames.getConstBuffer(), kOverlap);
+    }
+    for (auto& b : mOutputBuffers)
+    {
+      b.resize(LENGTH * 4);
+      b.write(mOutputFrames.getConstBuffer(), kHop);
+    }
+  }
+
+  // the delay from input to output, in samples.
+  static constexpr int getLatency() { return LENGTH; }
+
+  template <typename F>
+  inline DSPVectorArray<OUT_ROWS> operator()(F&& fn, const DSPVectorArray<IN_ROWS>& x)
+  {
+    for (int j = 0; j < IN_ROWS; ++j)
+    {
+      mInputBuffers[j].write(x.getRowDataConst(j), kFloatsPerDSPVector);
+    }
+
+    while (mInputBuffers[0].getReadAvailable() >= LENGTH)
+    {
+      for (int j = 0; j < IN_ROWS; ++j)
+      {
+        float* pFrame = mInputFrames.getRowData(j * kFrameRows);
+        mInputBuffers[j].readWithOverlap(pFrame, LENGTH, kOverlap);
+        multiply(pFrame, mAnalysisWindow.getConstBuffer());
+      }
+
+      fn(static_cast<const InputFrames&>(mInputFrames), mOutputFrames);
+
+      for (int j = 0; j < OUT_ROWS; ++j)
+      {
+        float* pFrame = mOutputFrames.getRowData(j * kFrameRows);
+        multiply(pFrame, mSynthesisWindow.getConstBuffer());
+        mOutputBuffers[j].writeWithOverlapAdd(pFrame, LENGTH, kOverlap);
+      }
+    }
+
+    DSPVectorArray<OUT_ROWS> vy;
+    for (int j = 0; j < OUT_ROWS; ++j)
+    {
+      mOutputBuffers[j].read(vy.getRowData(j), kFloatsPerDSPVector);
+    }
+    return vy;
+  }
+
+ private:
+  // multiply the LENGTH samples at px by the window at pw.
+  static inline void multiply(float* px, const float* pw)
+  {
+    for (int n = 0; n < LENGTH; n += kFloatsPerSIMDVector)
+    {
+      vecStore(px + n, vecMul(vecLoad(px + n), vecLoad(pw + n)));
+    }
+  }
+
+  DSPVectorArray<kFrameRows> mAnalysisWindow, mSynthesisWindow;
+  std::array<DSPBuffer, IN_ROWS> mInputBuffers;
+  std::array<DSPBuffer, OUT_ROWS> mOutputBuffers;
+  InputFrames mInputFrames;
+  OutputFrames mOutputFrames;
+};
+
+// SpectralFunction is a function object that given a spectral function f,
+// applies f to the spectrum of each frame of the input x, by short-time
+// Fourier analysis and resynthesis with an OverlapAddFunction.
+//
+// f is called as f(const InputSpectra& in, OutputSpectra& out), with the
+// packed spectrum of each row of the input in the same rows of in as its
+// frame in OverlapAddFunction, and likewise for out. See MLDSPFFT.h for the
+// packed format. f must write every bin of out.
+
+template <int LENGTH, int DIVISIONS, int IN_ROWS, int OUT_ROWS>
+class SpectralFunction
+{
+  using OverlapAdd = OverlapAddFunction<LENGTH, DIVISIONS, IN_ROWS, OUT_ROWS>;
+  static constexpr int kFrameRows = OverlapAdd::kFrameRows;
+
+ public:
+  using InputSpectra = typename OverlapAdd::InputFrames;
+  using OutputSpectra = typename OverlapAdd::OutputFrames;
+
+  explicit SpectralFunction(Projection windowShape = dspwindows::raisedCosine)
+      : mOverlapAdd(windowShape)
+  {
+  }
+
+  // the delay from input to output, in samples.
+  static constexpr int getLatency() { return OverlapAdd::getLatency(); }
+
+  template <typename F>
+  inline DSPVectorArray<OUT_ROWS> operator()(F&& fn, const DSPVectorArray<IN_ROWS>& x)
+  {
+    auto frameFn = [&](const InputSpectra& in, OutputSpectra& out) {
+      for (int j = 0; j < IN_ROWS; ++j)
+      {
+        mFFT.forward(in.getRowDataConst(j * kFrameRows),
+                     mInputSpectra.getRowData(j * kFrameRows));
+      }
+      fn(static_cast<const InputSpectra&>(mInputSpectra), mOutputSpectra);
+      for (int j = 0; j < OUT_ROWS; ++j)
+      {
+        mFFT.inverse(mOutputSpectra.getRowDataConst(j * kFrameRows),
+                     out.getRowData(j * kFrameRows));
+      }
+    };
+    return mOverlapAdd(frameFn, x);
+  }
+
+ private:
+  OverlapAdd mOverlapAdd;
+  FFT<kFrameRows> mFFT;
+  InputSpectra mInputSpectra;
+  OutputSpectra mOutputSpectra;
 };
-*/
 
 // FeedbackDelayFunction
 // Wraps a function in a pitchbendable delay with feedback per row.
@@ -260,7 +615,8 @@ class FeedbackDelayFunction
  public:
   float feedbackGain{1.f};
 
-  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
+  template <typename F>
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, F&& fn,
                                          const DSPVector vDelayTime)
   {
     DSPVectorArray<ROWS> vFnOutput;
@@ -273,6 +629,13 @@ class FeedbackDelayFunction
     return vFnOutput;
   }
 
+  // std::function version, kept for compatibility
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
+                                         const DSPVector vDelayTime)
+  {
+    return operator()<ProcessFn&>(vx, fn, vDelayTime);
+  }
+
  private:
   std::array<PitchbendableDelay, ROWS> mDelays;
   DSPVectorArray<ROWS> vy1;
@@ -296,7 +659,8 @@ class FeedbackDelayFunctionWithTap
  public:
   float feedbackGain{1.f};
 
-  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
+  template <typename F>
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, F&& fn,
                                          const DSPVector vDelayTime)
   {
     DSPVectorArray<ROWS> vFeedback;
@@ -310,6 +674,13 @@ class FeedbackDelayFunctionWithTap
     return vOutputTap;
   }
 
+  // std::function version, kept for compatibility
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
+                                         const DSPVector vDelayTime)
+  {
+    return operator()<ProcessFn&>(vx, fn, vDelayTime);
+  }
+
  private:
   std::array<PitchbendableDelay, ROWS> mDelays;
   DSPVectorArray<ROWS> vy1;
@@ -54,9 +54,7 @@ class ImpulseGen
 {
   // pick odd table size to get sample-centered sinc and window
   static constexpr int kTableSize{17};
-  DSPVector _table;
-  static_assert(kTableSize < kFloatsPerDSPVector,
-                "ImpulseGen: table size must be < the DSP vector size.");
+  std::array<float, kTableSize> _table;
 
   int _outputCounter;
   float _omega{0.f};
@@ -64,17 +62,24 @@ class ImpulseGen
  public:
   ImpulseGen()
   {
-    // make windowed sinc table
-    DSPVector windowVec;
-    makeWindow(windowVec.getBuffer(), kTableSize, dspwindows::blackman);
+    // make normalized windowed sinc table. The table is kept separate from
+    // DSPVector so that it does not limit the DSP vector size.
+    std::array<float, kTableSize> window;
+    makeWindow(window.data(), kTableSize, dspwindows::blackman);
     const float omega = 0.25f;
-    auto sincFn{[&](int i)
-                {
-                  float pi_x = ml::kTwoPi * omega * i;
-                  return (i == 0) ? 1.f : sinf(pi_x) / pi_x;
-                }};
-    DSPVector sincVec = map(sincFn, columnIndexInt() - DSPVectorInt((kTableSize - 1) / 2));
-    _table = normalize(sincVec * windowVec);
+    float tableSum{0.f};
+    for (int i = 0; i < kTableSize; ++i)
+    {
+      int x = i - (kTableSize - 1) / 2;
+      float pi_x = ml::kTwoPi * omega * x;
+      float sinc = (x == 0) ? 1.f : sinf(pi_x) / pi_x;
+      _table[i] = sinc * window[i];
+      tableSum += _table[i];
+    }
+    for (auto& t : _table)
+    {
+      t /= tableSum;
+    }
   }
   ~ImpulseGen() {}
 
@@ -4,14 +4,26 @@
 
 #pragma once
 
-// Here is the DSP vector size, an important constant.
-constexpr size_t kFloatsPerDSPVectorBits = 6;
+// Here is the DSP vector size, an important constant. It can be set at build
+// time by defining ML_DSP_VECTOR_BITS. Supported values are 4 through 8, for
+// vectors of 16 through 256 samples. The default is 64 samples.
+#ifndef ML_DSP_VECTOR_BITS
+#define ML_DSP_VECTOR_BITS 6
+#endif
+
+constexpr size_t kFloatsPerDSPVectorBits = ML_DSP_VECTOR_BITS;
 constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
+static_assert((kFloatsPerDSPVectorBits >= 4) && (kFloatsPerDSPVectorBits <= 8),
+              "ML_DSP_VECTOR_BITS must be between 4 and 8.");
 
 // Load definitions for low-level SIMD math.
 // These must define SIMDVectorFloat, SIMDVectorInt, their sizes, and a bunch of
-// operations on them. We are currently only using 4-element vectors on both SSE
-// and NEON.
+// operations on them. SSE and NEON use 4-element vectors. When the compiler
+// targets AVX2 (-mavx2 or /arch:AVX2), 8-element vectors are used instead.
+// Define ML_NO_AVX to force the SSE implementation on AVX2 targets.
+//
+// The SIMD width changes the layout of every DSPVector, so it is chosen at
+// compile time rather than dispatched at runtime.
 
 #if (defined __ARM_NEON) || (defined __ARM_NEON__)
 
@@ -20,6 +32,12 @@ constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
 #define ML_SSE_TO_NEON
 #include "MLDSPMathNEON.h"
 
+#elif (defined __AVX2__) && !(defined ML_NO_AVX)
+
+// AVX2
+
+#include "MLDSPMathAVX.h"
+
 #else
 
 // SSE2
@@ -28,6 +46,9 @@ constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
 
 #endif
 
+// Kernels with selectable accuracy, built from the primitives above.
+#include "MLDSPMathTiered.h"
+
 // A C++11 implementation of std::integer_sequence from C++14
 // Copyright Jonathan Wakely 2012-2013
 // Distributed under the Boost Software License, Version 1.0.
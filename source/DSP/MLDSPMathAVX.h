@@ -0,0 +1,891 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathAVX.h
+// AVX2 implementations of madronalib SIMD primitives. This provides the same
+// vec* vocabulary as MLDSPMathSSE.h on 8-element vectors, so every DSPVector op
+// runs in half as many SIMD iterations. Selected at compile time in MLDSPMath.h
+// when the compiler targets AVX2 (-mavx2, /arch:AVX2).
+//
+// The 4-lane helpers vecMask0 - vecMaskF, vecBroadcast3, vecShiftLeft / Right
+// and vecShiftElementsLeft / Right are SSE-specific and are not provided here.
+
+// cephes-derived approximate math functions adapted from code by Julien
+// Pommier, licensed as follows:
+/*
+ Copyright (C) 2007  Julien Pommier
+
+ This software is provided 'as-is', without any express or implied
+ warranty.  In no event will the authors be held liable for any damages
+ arising from the use of this software.
+
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it
+ freely, subject to the following restrictions:
+
+ 1. The origin of this software must not be misrepresented; you must not
+ claim that you wrote the original software. If you use this software
+ in a product, an acknowledgment in the product documentation would be
+ appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be
+ misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+
+ (this is the zlib license)
+ */
+
+#include "MLPlatform.h"
+
+#include <immintrin.h>
+
+#include <float.h>
+
+#pragma once
+
+#ifdef _MSC_VER /* visual c++ */
+#define ALIGN32_BEG __declspec(align(32))
+#define ALIGN32_END
+#else /* gcc or icc */
+#define ALIGN32_BEG
+#define ALIGN32_END __attribute__((aligned(32)))
+#endif
+
+// AVX types
+typedef __m256 SIMDVectorFloat;
+typedef __m256i SIMDVectorInt;
+
+// AVX casts
+#define VecF2I _mm256_castps_si256
+#define VecI2F _mm256_castsi256_ps
+
+constexpr int kFloatsPerSIMDVectorBits = 3;
+constexpr int kFloatsPerSIMDVector = 1 << kFloatsPerSIMDVectorBits;
+constexpr int kSIMDVectorsPerDSPVector = kFloatsPerDSPVector / kFloatsPerSIMDVector;
+constexpr int kBytesPerSIMDVector = kFloatsPerSIMDVector * sizeof(float);
+constexpr int kSIMDVectorMask = ~(kBytesPerSIMDVector - 1);
+
+constexpr int kIntsPerSIMDVectorBits = 3;
+constexpr int kIntsPerSIMDVector = 1 << kIntsPerSIMDVectorBits;
+
+inline bool isSIMDAligned(float* p)
+{
+  uintptr_t pM = (uintptr_t)p;
+  return ((pM & kSIMDVectorMask) == 0);
+}
+
+// primitive AVX operations
+#define vecAdd _mm256_add_ps
+#define vecSub _mm256_sub_ps
+#define vecMul _mm256_mul_ps
+#define vecDiv _mm256_div_ps
+#define vecDivApprox(x1, x2) (_mm256_mul_ps(x1, _mm256_rcp_ps(x2)))
+#define vecMin _mm256_min_ps
+#define vecMax _mm256_max_ps
+
+#define vecSqrt _mm256_sqrt_ps
+#define vecSqrtApprox(x) (vecMul(x, vecRSqrt(x)))
+#define vecRSqrt _mm256_rsqrt_ps
+#define vecAbs(x) (_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x))
+
+#define vecSign(x)                                                                            \
+  (_mm256_and_ps(_mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)), \
+                 _mm256_cmp_ps(_mm256_set1_ps(-0.0f), x, _CMP_NEQ_UQ)))
+
+#define vecSignBit(x) (_mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)))
+#define vecClamp(x1, x2, x3) _mm256_min_ps(_mm256_max_ps(x1, x2), x3)
+#define vecWithin(x1, x2, x3) \
+  _mm256_and_ps(_mm256_cmp_ps(x1, x2, _CMP_GE_OQ), _mm256_cmp_ps(x1, x3, _CMP_LT_OQ))
+
+#define vecEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_EQ_OQ)
+#define vecNotEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_NEQ_UQ)
+#define vecGreaterThan(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_GT_OQ)
+#define vecGreaterThanOrEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_GE_OQ)
+#define vecLessThan(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_LT_OQ)
+#define vecLessThanOrEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_LE_OQ)
+
+#define vecSet1 _mm256_set1_ps
+
+// low-level store and load a vector to/from a float*.
+// the pointer must be aligned or the program will crash!
+#define vecStore _mm256_store_ps
+#define vecLoad _mm256_load_ps
+
+#define vecStoreUnaligned _mm256_storeu_ps
+#define vecLoadUnaligned _mm256_loadu_ps
+
+#define vecAnd _mm256_and_ps
+#define vecOr _mm256_or_ps
+#define vecXor _mm256_xor_ps
+
+// true if any lane of the comparison mask x is set.
+#define vecAnyTrue(x) (_mm256_movemask_ps(x) != 0)
+
+#define vecZeros _mm256_setzero_ps
+#define vecOnes vecEqual(vecZeros(), vecZeros())
+
+#define vecFloatToIntRound _mm256_cvtps_epi32
+#define vecFloatToIntTruncate _mm256_cvttps_epi32
+#define vecIntToFloat _mm256_cvtepi32_ps
+
+// _mm256_cvtepi32_ps approximation for unsigned int data
+// this loses a bit of precision
+inline SIMDVectorFloat vecUnsignedIntToFloat(SIMDVectorInt v)
+{
+  __m256i v_hi = _mm256_srli_epi32(v, 1);
+  __m256 v_hi_flt = _mm256_cvtepi32_ps(v_hi);
+  return _mm256_add_ps(v_hi_flt, v_hi_flt);
+}
+
+#define vecAddInt _mm256_add_epi32
+#define vecSubInt _mm256_sub_epi32
+#define vecSet1Int _mm256_set1_epi32
+
+// shift each int32 element by an immediate number of bits
+#define vecShiftLeftInt _mm256_slli_epi32
+#define vecShiftRightInt _mm256_srli_epi32
+
+typedef union
+{
+  SIMDVectorFloat v;
+  float f[8];
+} SIMDVectorFloatUnion;
+
+typedef union
+{
+  SIMDVectorInt v;
+  uint32_t i[8];
+} SIMDVectorIntUnion;
+
+inline SIMDVectorInt vecSetInt1(uint32_t a) { return _mm256_set1_epi32(a); }
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorFloat v)
+{
+  SIMDVectorFloatUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+  {
+    out << u.f[i];
+    if (i < kFloatsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
+{
+  SIMDVectorIntUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kIntsPerSIMDVector; ++i)
+  {
+    out << u.i[i];
+    if (i < kIntsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+// ----------------------------------------------------------------
+#pragma mark select
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return _mm256_blendv_ps(b, a, VecI2F(conditionMask));
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorFloat conditionMask)
+{
+  return _mm256_blendv_ps(b, a, conditionMask);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return _mm256_blendv_epi8(b, a, conditionMask);
+}
+
+// ----------------------------------------------------------------
+// horizontal operations returning float
+
+inline float vecSumH(SIMDVectorFloat v)
+{
+  __m128 vs = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_add_ps(vs, _mm_movehl_ps(vs, vs));
+  __m128 tmp1 = _mm_add_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+inline float vecMaxH(SIMDVectorFloat v)
+{
+  __m128 vs = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_max_ps(vs, _mm_movehl_ps(vs, vs));
+  __m128 tmp1 = _mm_max_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+inline float vecMinH(SIMDVectorFloat v)
+{
+  __m128 vs = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_min_ps(vs, _mm_movehl_ps(vs, vs));
+  __m128 tmp1 = _mm_min_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+/* declare some AVX constants */
+#define _PS256_CONST(Name, Val) \
+  static const ALIGN32_BEG float _ps256_##Name[8] ALIGN32_END = {Val, Val, Val, Val, \
+                                                                  Val, Val, Val, Val}
+#define _PI32_CONST256(Name, Val) \
+  static const ALIGN32_BEG int _pi32_256_##Name[8] ALIGN32_END = {Val, Val, Val, Val, \
+                                                                   Val, Val, Val, Val}
+#define _PS256_CONST_TYPE(Name, Type, Val) \
+  static const ALIGN32_BEG Type _ps256_##Name[8] ALIGN32_END = {Val, Val, Val, Val, \
+                                                                 Val, Val, Val, Val}
+
+_PS256_CONST(1, 1.0f);
+_PS256_CONST(0p5, 0.5f);
+
+/* the smallest non denormalized float number */
+_PS256_CONST_TYPE(min_norm_pos, int, 0x00800000);
+_PS256_CONST_TYPE(mant_mask, int, 0x7f800000);
+_PS256_CONST_TYPE(inv_mant_mask, int, ~0x7f800000);
+
+_PS256_CONST_TYPE(sign_mask, int, (int)0x80000000);
+_PS256_CONST_TYPE(inv_sign_mask, int, ~0x80000000);
+
+_PI32_CONST256(1, 1);
+_PI32_CONST256(inv1, ~1);
+_PI32_CONST256(2, 2);
+_PI32_CONST256(4, 4);
+_PI32_CONST256(0x7f, 0x7f);
+
+_PS256_CONST(cephes_SQRTHF, 0.707106781186547524f);
+_PS256_CONST(cephes_log_p0, 7.0376836292E-2f);
+_PS256_CONST(cephes_log_p1, -1.1514610310E-1f);
+_PS256_CONST(cephes_log_p2, 1.1676998740E-1f);
+_PS256_CONST(cephes_log_p3, -1.2420140846E-1f);
+_PS256_CONST(cephes_log_p4, +1.4249322787E-1f);
+_PS256_CONST(cephes_log_p5, -1.6668057665E-1f);
+_PS256_CONST(cephes_log_p6, +2.0000714765E-1f);
+_PS256_CONST(cephes_log_p7, -2.4999993993E-1f);
+_PS256_CONST(cephes_log_p8, +3.3333331174E-1f);
+_PS256_CONST(cephes_log_q1, -2.12194440e-4f);
+_PS256_CONST(cephes_log_q2, 0.693359375f);
+
+/* natural logarithm computed for 8 simultaneous float
+ return NaN for x <= 0
+ */
+inline SIMDVectorFloat vecLog(SIMDVectorFloat x)
+{
+  SIMDVectorInt imm0;
+  SIMDVectorFloat one = *(SIMDVectorFloat*)_ps256_1;
+  SIMDVectorFloat invalid_mask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OQ);
+
+  x = _mm256_max_ps(x, *(SIMDVectorFloat*)_ps256_min_norm_pos); /* cut off denormalized stuff */
+
+  imm0 = _mm256_srli_epi32(VecF2I(x), 23);
+
+  /* keep only the fractional part */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps256_inv_mant_mask);
+  x = _mm256_or_ps(x, *(SIMDVectorFloat*)_ps256_0p5);
+
+  imm0 = _mm256_sub_epi32(imm0, *(SIMDVectorInt*)_pi32_256_0x7f);
+  SIMDVectorFloat e = _mm256_cvtepi32_ps(imm0);
+
+  e = _mm256_add_ps(e, one);
+
+  /* part2:
+   if( x < SQRTHF ) {
+   e -= 1;
+   x = x + x - 1.0;
+   } else { x = x - 1.0; }
+   */
+  SIMDVectorFloat mask = _mm256_cmp_ps(x, *(SIMDVectorFloat*)_ps256_cephes_SQRTHF, _CMP_LT_OQ);
+  SIMDVectorFloat tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  SIMDVectorFloat y = *(SIMDVectorFloat*)_ps256_cephes_log_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p5);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p6);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p7);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_log_p8);
+  y = _mm256_mul_ps(y, x);
+
+  y = _mm256_mul_ps(y, z);
+
+  tmp = _mm256_mul_ps(e, *(SIMDVectorFloat*)_ps256_cephes_log_q1);
+  y = _mm256_add_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(e, *(SIMDVectorFloat*)_ps256_cephes_log_q2);
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, tmp);
+  x = _mm256_or_ps(x, invalid_mask);  // negative arg will be NAN
+  return x;
+}
+
+_PS256_CONST(exp_hi, 88.3762626647949f);
+_PS256_CONST(exp_lo, -88.3762626647949f);
+
+_PS256_CONST(cephes_LOG2EF, 1.44269504088896341f);
+_PS256_CONST(cephes_exp_C1, 0.693359375f);
+_PS256_CONST(cephes_exp_C2, -2.12194440e-4f);
+
+_PS256_CONST(cephes_exp_p0, 1.9875691500E-4f);
+_PS256_CONST(cephes_exp_p1, 1.3981999507E-3f);
+_PS256_CONST(cephes_exp_p2, 8.3334519073E-3f);
+_PS256_CONST(cephes_exp_p3, 4.1665795894E-2f);
+_PS256_CONST(cephes_exp_p4, 1.6666665459E-1f);
+_PS256_CONST(cephes_exp_p5, 5.0000001201E-1f);
+
+inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
+{
+  SIMDVectorFloat tmp = _mm256_setzero_ps(), fx;
+  SIMDVectorInt imm0;
+  SIMDVectorFloat one = *(SIMDVectorFloat*)_ps256_1;
+
+  x = _mm256_min_ps(x, *(SIMDVectorFloat*)_ps256_exp_hi);
+  x = _mm256_max_ps(x, *(SIMDVectorFloat*)_ps256_exp_lo);
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  fx = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps256_cephes_LOG2EF);
+  fx = _mm256_add_ps(fx, *(SIMDVectorFloat*)_ps256_0p5);
+
+  /* floor with the same truncate and correct steps as the SSE version */
+  imm0 = _mm256_cvttps_epi32(fx);
+  tmp = _mm256_cvtepi32_ps(imm0);
+
+  /* if greater, substract 1 */
+  SIMDVectorFloat mask = _mm256_cmp_ps(tmp, fx, _CMP_GT_OQ);
+  mask = _mm256_and_ps(mask, one);
+  fx = _mm256_sub_ps(tmp, mask);
+
+  tmp = _mm256_mul_ps(fx, *(SIMDVectorFloat*)_ps256_cephes_exp_C1);
+  SIMDVectorFloat z = _mm256_mul_ps(fx, *(SIMDVectorFloat*)_ps256_cephes_exp_C2);
+  x = _mm256_sub_ps(x, tmp);
+  x = _mm256_sub_ps(x, z);
+  z = _mm256_mul_ps(x, x);
+
+  SIMDVectorFloat y = *(SIMDVectorFloat*)_ps256_cephes_exp_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_exp_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_exp_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_exp_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_exp_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_cephes_exp_p5);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, x);
+  y = _mm256_add_ps(y, one);
+
+  /* build 2^n */
+  imm0 = _mm256_cvttps_epi32(fx);
+  imm0 = _mm256_add_epi32(imm0, *(SIMDVectorInt*)_pi32_256_0x7f);
+  imm0 = _mm256_slli_epi32(imm0, 23);
+  SIMDVectorFloat pow2n = VecI2F(imm0);
+
+  y = _mm256_mul_ps(y, pow2n);
+  return y;
+}
+
+_PS256_CONST(minus_cephes_DP1, -0.78515625f);
+_PS256_CONST(minus_cephes_DP2, -2.4187564849853515625e-4f);
+_PS256_CONST(minus_cephes_DP3, -3.77489497744594108e-8f);
+_PS256_CONST(sincof_p0, -1.9515295891E-4f);
+_PS256_CONST(sincof_p1, 8.3321608736E-3f);
+_PS256_CONST(sincof_p2, -1.6666654611E-1f);
+_PS256_CONST(coscof_p0, 2.443315711809948E-005f);
+_PS256_CONST(coscof_p1, -1.388731625493765E-003f);
+_PS256_CONST(coscof_p2, 4.166664568298827E-002f);
+_PS256_CONST(cephes_FOPI, 1.27323954473516f);  // 4 / M_PI
+
+// see the notes on the SSE version of vecSin in MLDSPMathSSE.h.
+inline SIMDVectorFloat vecSin(SIMDVectorFloat x)
+{
+  SIMDVectorFloat xmm1, xmm2 = _mm256_setzero_ps(), xmm3, sign_bit, y;
+  SIMDVectorInt imm0, imm2;
+
+  sign_bit = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps256_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit = _mm256_and_ps(sign_bit, *(SIMDVectorFloat*)_ps256_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps256_cephes_FOPI);
+
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(SIMDVectorInt*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+
+  /* get the swap sign flag */
+  imm0 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  /* get the polynom selection mask
+   there is one polynom for 0 <= x <= Pi/4
+   and another one for Pi/4<x<=Pi/2
+   Both branches will be computed.
+   */
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+
+  SIMDVectorFloat swap_sign_bit = VecI2F(imm0);
+  SIMDVectorFloat poly_mask = VecI2F(imm2);
+  sign_bit = _mm256_xor_ps(sign_bit, swap_sign_bit);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(SIMDVectorFloat*)_ps256_coscof_p0;
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y, y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+  return y;
+}
+
+/* almost the same as vecSin */
+inline SIMDVectorFloat vecCos(SIMDVectorFloat x)
+{
+  SIMDVectorFloat xmm1, xmm2 = _mm256_setzero_ps(), xmm3, y;
+  SIMDVectorInt imm0, imm2;
+
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps256_inv_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps256_cephes_FOPI);
+
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(SIMDVectorInt*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+  imm2 = _mm256_sub_epi32(imm2, *(SIMDVectorInt*)_pi32_256_2);
+
+  /* get the swap sign flag */
+  imm0 = _mm256_andnot_si256(imm2, *(SIMDVectorInt*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  /* get the polynom selection mask */
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+
+  SIMDVectorFloat sign_bit = VecI2F(imm0);
+  SIMDVectorFloat poly_mask = VecI2F(imm2);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(SIMDVectorFloat*)_ps256_coscof_p0;
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y, y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+
+  return y;
+}
+
+// sine and cosine computed together for about the cost of one of them.
+inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
+{
+  SIMDVectorFloat xmm1, xmm2, xmm3 = _mm256_setzero_ps(), sign_bit_sin, y;
+  SIMDVectorInt imm0, imm2, imm4;
+
+  sign_bit_sin = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(SIMDVectorFloat*)_ps256_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit_sin = _mm256_and_ps(sign_bit_sin, *(SIMDVectorFloat*)_ps256_sign_mask);
+
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(SIMDVectorFloat*)_ps256_cephes_FOPI);
+
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(SIMDVectorInt*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+
+  imm4 = imm2;
+
+  /* get the swap sign flag for the sine */
+  imm0 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  SIMDVectorFloat swap_sign_bit_sin = VecI2F(imm0);
+
+  /* get the polynom selection mask for the sine*/
+  imm2 = _mm256_and_si256(imm2, *(SIMDVectorInt*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+  SIMDVectorFloat poly_mask = VecI2F(imm2);
+
+  /* The magic pass: "Extended precision modular arithmetic"
+   x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP1;
+  xmm2 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP2;
+  xmm3 = *(SIMDVectorFloat*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  imm4 = _mm256_sub_epi32(imm4, *(SIMDVectorInt*)_pi32_256_2);
+  imm4 = _mm256_andnot_si256(imm4, *(SIMDVectorInt*)_pi32_256_4);
+  imm4 = _mm256_slli_epi32(imm4, 29);
+  SIMDVectorFloat sign_bit_cos = VecI2F(imm4);
+
+  sign_bit_sin = _mm256_xor_ps(sign_bit_sin, swap_sign_bit_sin);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  SIMDVectorFloat z = _mm256_mul_ps(x, x);
+  y = *(SIMDVectorFloat*)_ps256_coscof_p0;
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  SIMDVectorFloat tmp = _mm256_mul_ps(z, *(SIMDVectorFloat*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(SIMDVectorFloat*)_ps256_1);
+
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+  SIMDVectorFloat y2 = *(SIMDVectorFloat*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(SIMDVectorFloat*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */
+  xmm3 = poly_mask;
+  SIMDVectorFloat ysin2 = _mm256_and_ps(xmm3, y2);
+  SIMDVectorFloat ysin1 = _mm256_andnot_ps(xmm3, y);
+  y2 = _mm256_sub_ps(y2, ysin2);
+  y = _mm256_sub_ps(y, ysin1);
+
+  xmm1 = _mm256_add_ps(ysin1, ysin2);
+  xmm2 = _mm256_add_ps(y, y2);
+
+  /* update the sign */
+  *s = _mm256_xor_ps(xmm1, sign_bit_sin);
+  *c = _mm256_xor_ps(xmm2, sign_bit_cos);
+}
+
+#define STATIC_M256_CONST(name, val) \
+  static constexpr __m256 name = {val, val, val, val, val, val, val, val}
+
+// backend-neutral name for a constant SIMDVectorFloat
+#define STATIC_SIMD_CONST STATIC_M256_CONST
+
+// fast polynomial approximations. See MLDSPMathSSE.h for sources.
+
+STATIC_M256_CONST(kSinC1Vec, 0.99997937679290771484375f);
+STATIC_M256_CONST(kSinC2Vec, -0.166624367237091064453125f);
+STATIC_M256_CONST(kSinC3Vec, 8.30897875130176544189453125e-3f);
+STATIC_M256_CONST(kSinC4Vec, -1.92649182281456887722015380859375e-4f);
+STATIC_M256_CONST(kSinC5Vec, 2.147840177713078446686267852783203125e-6f);
+
+inline SIMDVectorFloat vecSinApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = _mm256_mul_ps(x, x);
+  return _mm256_mul_ps(
+      x, _mm256_add_ps(
+             kSinC1Vec,
+             _mm256_mul_ps(
+                 x2, _mm256_add_ps(
+                         kSinC2Vec,
+                         _mm256_mul_ps(
+                             x2, _mm256_add_ps(
+                                     kSinC3Vec,
+                                     _mm256_mul_ps(x2, _mm256_add_ps(
+                                                           kSinC4Vec,
+                                                           _mm256_mul_ps(x2, kSinC5Vec)))))))));
+}
+
+STATIC_M256_CONST(kCosC1Vec, 0.999959766864776611328125f);
+STATIC_M256_CONST(kCosC2Vec, -0.4997930824756622314453125f);
+STATIC_M256_CONST(kCosC3Vec, 4.1496001183986663818359375e-2f);
+STATIC_M256_CONST(kCosC4Vec, -1.33926304988563060760498046875e-3f);
+STATIC_M256_CONST(kCosC5Vec, 1.8791708498611114919185638427734375e-5f);
+
+inline SIMDVectorFloat vecCosApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = _mm256_mul_ps(x, x);
+  return _mm256_add_ps(
+      kCosC1Vec,
+      _mm256_mul_ps(
+          x2, _mm256_add_ps(
+                  kCosC2Vec,
+                  _mm256_mul_ps(
+                      x2, _mm256_add_ps(
+                              kCosC3Vec,
+                              _mm256_mul_ps(x2, _mm256_add_ps(kCosC4Vec,
+                                                              _mm256_mul_ps(x2, kCosC5Vec))))))));
+}
+
+STATIC_M256_CONST(kExpC1Vec, 2139095040.f);
+STATIC_M256_CONST(kExpC2Vec, 12102203.1615614f);
+STATIC_M256_CONST(kExpC3Vec, 1065353216.f);
+STATIC_M256_CONST(kExpC4Vec, 0.510397365625862338668154f);
+STATIC_M256_CONST(kExpC5Vec, 0.310670891004095530771135f);
+STATIC_M256_CONST(kExpC6Vec, 0.168143436463395944830000f);
+STATIC_M256_CONST(kExpC7Vec, -2.88093587581985443087955e-3f);
+STATIC_M256_CONST(kExpC8Vec, 1.3671023382430374383648148e-2f);
+
+inline SIMDVectorFloat vecExpApprox(SIMDVectorFloat x)
+{
+  const SIMDVectorFloat kZeroVec = _mm256_setzero_ps();
+
+  SIMDVectorFloat val2, val3, val4;
+  SIMDVectorInt val4i;
+
+  val2 = _mm256_add_ps(_mm256_mul_ps(x, kExpC2Vec), kExpC3Vec);
+  val3 = _mm256_min_ps(val2, kExpC1Vec);
+  val4 = _mm256_max_ps(val3, kZeroVec);
+  val4i = _mm256_cvttps_epi32(val4);
+
+  SIMDVectorFloat xu = _mm256_and_ps(VecI2F(val4i), VecI2F(_mm256_set1_epi32(0x7F800000)));
+  SIMDVectorFloat b = _mm256_or_ps(_mm256_and_ps(VecI2F(val4i), VecI2F(_mm256_set1_epi32(0x7FFFFF))),
+                                   VecI2F(_mm256_set1_epi32(0x3F800000)));
+
+  return _mm256_mul_ps(
+      xu, (_mm256_add_ps(
+              kExpC4Vec,
+              _mm256_mul_ps(
+                  b, _mm256_add_ps(
+                         kExpC5Vec,
+                         _mm256_mul_ps(
+                             b, _mm256_add_ps(
+                                    kExpC6Vec,
+                                    _mm256_mul_ps(b, _mm256_add_ps(kExpC7Vec,
+                                                                   _mm256_mul_ps(b, kExpC8Vec))))))))));
+}
+
+STATIC_M256_CONST(kLogC1Vec, -89.970756366f);
+STATIC_M256_CONST(kLogC2Vec, 3.529304993f);
+STATIC_M256_CONST(kLogC3Vec, -2.461222105f);
+STATIC_M256_CONST(kLogC4Vec, 1.130626167f);
+STATIC_M256_CONST(kLogC5Vec, -0.288739945f);
+STATIC_M256_CONST(kLogC6Vec, 3.110401639e-2f);
+STATIC_M256_CONST(kLogC7Vec, 0.69314718055995f);
+
+inline SIMDVectorFloat vecLogApprox(SIMDVectorFloat val)
+{
+  SIMDVectorInt valAsInt = VecF2I(val);
+  SIMDVectorInt expi = _mm256_srli_epi32(valAsInt, 23);
+  SIMDVectorFloat addcst =
+      vecSelect(kLogC1Vec, _mm256_set1_ps(FLT_MIN),
+                _mm256_cmp_ps(val, _mm256_setzero_ps(), _CMP_GT_OQ));
+  SIMDVectorInt valAsIntMasked =
+      VecF2I(_mm256_or_ps(_mm256_and_ps(VecI2F(valAsInt), VecI2F(_mm256_set1_epi32(0x7FFFFF))),
+                          VecI2F(_mm256_set1_epi32(0x3F800000))));
+  SIMDVectorFloat x = VecI2F(valAsIntMasked);
+
+  SIMDVectorFloat poly = _mm256_mul_ps(
+      x, _mm256_add_ps(
+             kLogC2Vec,
+             _mm256_mul_ps(
+                 x, _mm256_add_ps(
+                        kLogC3Vec,
+                        _mm256_mul_ps(
+                            x, _mm256_add_ps(
+                                   kLogC4Vec,
+                                   _mm256_mul_ps(x, _mm256_add_ps(kLogC5Vec,
+                                                                  _mm256_mul_ps(x, kLogC6Vec)))))))));
+
+  SIMDVectorFloat addCstResult =
+      _mm256_add_ps(addcst, _mm256_mul_ps(kLogC7Vec, _mm256_cvtepi32_ps(expi)));
+  return _mm256_add_ps(poly, addCstResult);
+}
+
+inline SIMDVectorFloat vecIntPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = _mm256_cvttps_epi32(val);  // convert with truncate
+  return (_mm256_cvtepi32_ps(vi));
+}
+
+inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = _mm256_cvttps_epi32(val);  // convert with truncate
+  SIMDVectorFloat intPart = _mm256_cvtepi32_ps(vi);
+  return _mm256_sub_ps(val, intPart);
+}
+
+// Given vectors [ ?, ?, ?, ?, ?, ?, ?, 7 ], [ 8, 9, 10, 11, 12, 13, 14, 15 ]
+// Returns [ 7, 8, 9, 10, 11, 12, 13, 14 ]
+inline SIMDVectorFloat vecShuffleRight(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  SIMDVectorFloat rotated = _mm256_permutevar8x32_ps(v2, _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6));
+  SIMDVectorFloat last = _mm256_permutevar8x32_ps(v1, _mm256_set1_epi32(7));
+  return _mm256_blend_ps(rotated, last, 0x01);
+}
+
+// Given vectors [ 0, 1, 2, 3, 4, 5, 6, 7 ], [ 8, ?, ?, ?, ?, ?, ?, ? ]
+// Returns [ 1, 2, 3, 4, 5, 6, 7, 8 ]
+inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  SIMDVectorFloat rotated = _mm256_permutevar8x32_ps(v1, _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0));
+  SIMDVectorFloat first = _mm256_permutevar8x32_ps(v2, _mm256_setzero_si256());
+  return _mm256_blend_ps(rotated, first, 0x80);
+}
+
+// Transpose the square matrix of kFloatsPerSIMDVector rows in place.
+inline void vecTranspose(SIMDVectorFloat* rows)
+{
+  // interleave pairs of rows, then pairs of pairs, then swap 128-bit halves.
+  __m256 t[8], u[8];
+  for (int i = 0; i < 4; ++i)
+  {
+    t[2 * i] = _mm256_unpacklo_ps(rows[2 * i], rows[2 * i + 1]);
+    t[2 * i + 1] = _mm256_unpackhi_ps(rows[2 * i], rows[2 * i + 1]);
+  }
+  for (int i = 0; i < 2; ++i)
+  {
+    u[4 * i] = _mm256_shuffle_ps(t[4 * i], t[4 * i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+    u[4 * i + 1] = _mm256_shuffle_ps(t[4 * i], t[4 * i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+    u[4 * i + 2] = _mm256_shuffle_ps(t[4 * i + 1], t[4 * i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+    u[4 * i + 3] = _mm256_shuffle_ps(t[4 * i + 1], t[4 * i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    rows[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+    rows[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+  }
+}
+
+// define infix operators for MSVC.
+#ifdef WIN32
+
+inline SIMDVectorFloat operator*(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecMul(a, b);
+}
+
+inline SIMDVectorFloat operator+(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecAdd(a, b);
+}
+
+inline SIMDVectorFloat operator-(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecSub(a, b);
+}
+
+inline SIMDVectorFloat operator/(const SIMDVectorFloat& a, const SIMDVectorFloat& b)
+{
+  return vecDiv(a, b);
+}
+
+inline SIMDVectorInt operator|(const SIMDVectorInt& a, const SIMDVectorInt& b)
+{
+  return _mm256_or_si256(a, b);
+}
+inline SIMDVectorInt operator&(const SIMDVectorInt& a, const SIMDVectorInt& b)
+{
+  return _mm256_and_si256(a, b);
+}
+
+#endif
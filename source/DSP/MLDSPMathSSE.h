@@ -115,6 +115,10 @@ _mm_cmpneq_ps(_mm_set_ps1(-0.0f), x)))
 
 #define vecAnd _mm_and_ps
 #define vecOr _mm_or_ps
+#define vecXor _mm_xor_ps
+
+// true if any lane of the comparison mask x is set.
+#define vecAnyTrue(x) (_mm_movemask_ps(x) != 0)
 
 #define vecZeros _mm_setzero_ps
 #define vecOnes vecEqual(vecZeros, vecZeros)
@@ -139,6 +143,10 @@ inline SIMDVectorFloat vecUnsignedIntToFloat(SIMDVectorInt v)
 #define vecSubInt _mm_sub_epi32
 #define vecSet1Int _mm_set1_epi32
 
+// shift each int32 element by an immediate number of bits
+#define vecShiftLeftInt _mm_slli_epi32
+#define vecShiftRightInt _mm_srli_epi32
+
 typedef union
 {
   SIMDVectorFloat v;
@@ -731,6 +739,9 @@ inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
 
 #define STATIC_M128_CONST(name, val) static constexpr __m128 name = {val, val, val, val};
 
+// backend-neutral name for a constant SIMDVectorFloat
+#define STATIC_SIMD_CONST STATIC_M128_CONST
+
 // fast polynomial approximations
 // from scalar code by Jacques-Henri Jourdan <jourgun@gmail.com>
 // sin and cos valid from -pi to pi
@@ -890,6 +901,12 @@ inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
   return _mm_shuffle_ps(v1, _mm_shuffle_ps(v1, v2, SHUFFLE(0, 0, 3, 3)), SHUFFLE(3, 0, 2, 1));
 }
 
+// Transpose the square matrix of kFloatsPerSIMDVector rows in place.
+inline void vecTranspose(SIMDVectorFloat* rows)
+{
+  _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+}
+
 // define infix operators for native SSE / MSVC.
 #ifndef ML_SSE_TO_NEON
 #ifdef WIN32
@@ -0,0 +1,274 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathTiered.h
+// Transcendental kernels with a selectable accuracy, built from the vec*
+// primitives so that they work with every SIMD backend.
+//
+// Accuracy::low gives at least 3 decimal digits, Accuracy::medium at least 5,
+// and Accuracy::full is within a few ULPs of single precision. The low and
+// medium polynomials were fit for minimum relative error over each reduced
+// range. The full tier uses the cephes-derived kernels for sin, cos, exp and
+// log, and cephes tanhf coefficients for tanh.
+//
+// Max error in ULPs over the ranges tested in dspOpsTest.cpp, which also
+// reports the time per DSPVector of each kernel:
+//
+//          low     medium  full
+//   sin    2300    21      1.3     [-pi, pi]
+//   cos    2300    22      1.5     [-pi, pi]
+//   exp    1300    40      1       [-20, 20]
+//   log    380     3.3     0.8     [1e-6, 1e6]
+//   tanh   1400    46      1.1     [-10, 10]
+//
+// On an x86_64 test machine with SSE2, low tiers took about half the time of
+// full ones and medium tiers about 60%.
+//
+// pow(x, y) is computed as exp(y * log(x)) with the same tier for each
+// kernel, and is only valid for x > 0. Its relative error grows with the
+// magnitude of y * log(x).
+
+#pragma once
+
+#include <array>
+
+namespace ml
+{
+enum class Accuracy
+{
+  low,
+  medium,
+  full
+};
+
+namespace tieredKernels
+{
+// polynomial coefficients, lowest order first.
+
+// sin(r) = r * P(r^2) on [-pi/2, pi/2]
+constexpr std::array<float, 3> kSinLow{0.99991304f, -0.1660249f, 0.0076286388f};
+constexpr std::array<float, 4> kSinMedium{0.9999992f, -0.16665682f, 0.008313258f,
+                                          -0.00018524351f};
+
+// exp(r) = P(r) on [-ln(2)/2, ln(2)/2]
+constexpr std::array<float, 4> kExpLow{0.99992806f, 1.0001642f, 0.50496334f, 0.16566846f};
+constexpr std::array<float, 5> kExpMedium{0.9999993f, 0.9999634f, 0.5000436f, 0.16790909f,
+                                          0.041458614f};
+
+// log(m) = s * P(s^2), s = (m - 1) / (m + 1), m in [sqrt(1/2), sqrt(2)]
+constexpr std::array<float, 2> kLogLow{1.9999553f, 0.6786951f};
+constexpr std::array<float, 3> kLogMedium{2.0000002f, 0.6665219f, 0.4129748f};
+
+// tanh(x) = x * P(x^2) on [-0.625, 0.625]
+constexpr std::array<float, 3> kTanhLow{0.99992526f, -0.32971275f, 0.106843576f};
+constexpr std::array<float, 4> kTanhMedium{0.99999726f, -0.3330999f, 0.13020621f, -0.040117398f};
+constexpr std::array<float, 6> kTanhFull{1.0f,
+                                         -3.33332819422E-1f,
+                                         1.33314422036E-1f,
+                                         -5.37397155531E-2f,
+                                         2.06390887954E-2f,
+                                         -5.70498872745E-3f};
+constexpr float kTanhPolyMax{0.625f};
+
+// constants split into a high part with few significant bits and a low part,
+// so that n * high is exact for the range reductions.
+constexpr float kPiHi{3.140625f};
+constexpr float kPiLo{9.67653589793e-4f};
+constexpr float kHalfPiHi{1.5703125f};
+constexpr float kHalfPiLo{4.83826794897e-4f};
+constexpr float kLn2Hi{0.693359375f};
+constexpr float kLn2Lo{-2.12194440e-4f};
+constexpr float kOneOverPi{0.318309886183790671538f};
+constexpr float kLog2e{1.44269504088896341f};
+constexpr float kSqrt2{1.41421356237309504880f};
+
+// exp input range where 2^round(x * log2(e)) is a normal float
+constexpr float kExpMax{88.3762626647949f};
+constexpr float kExpMin{-87.3365478515625f};
+
+// Horner evaluation of a polynomial with coefficients c, lowest order first.
+template <size_t N>
+inline SIMDVectorFloat vecPolynomial(SIMDVectorFloat x, const std::array<float, N>& c)
+{
+  SIMDVectorFloat y = vecSet1(c[N - 1]);
+  for (int i = N - 2; i >= 0; --i)
+  {
+    y = vecAdd(vecMul(y, x), vecSet1(c[i]));
+  }
+  return y;
+}
+
+// r * P(r^2) for r in [-pi/2, pi/2], at the accuracy A.
+template <Accuracy A>
+inline SIMDVectorFloat vecSinReduced(SIMDVectorFloat r)
+{
+  SIMDVectorFloat r2 = vecMul(r, r);
+  if constexpr (A == Accuracy::low)
+  {
+    return vecMul(r, vecPolynomial(r2, kSinLow));
+  }
+  else
+  {
+    return vecMul(r, vecPolynomial(r2, kSinMedium));
+  }
+}
+
+// x * P(x^2) for x in [-0.625, 0.625], at the accuracy A.
+template <Accuracy A>
+inline SIMDVectorFloat vecTanhSmall(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = vecMul(x, x);
+  if constexpr (A == Accuracy::low)
+  {
+    return vecMul(x, vecPolynomial(x2, kTanhLow));
+  }
+  else if constexpr (A == Accuracy::medium)
+  {
+    return vecMul(x, vecPolynomial(x2, kTanhMedium));
+  }
+  else
+  {
+    return vecMul(x, vecPolynomial(x2, kTanhFull));
+  }
+}
+
+}  // namespace tieredKernels
+
+// sin(x). The low and medium tiers reduce x to [-pi/2, pi/2] and are accurate
+// for |x| < 2^16.
+template <Accuracy A>
+inline SIMDVectorFloat vecSinTiered(SIMDVectorFloat x)
+{
+  using namespace tieredKernels;
+  if constexpr (A == Accuracy::full)
+  {
+    return vecSin(x);
+  }
+  else
+  {
+    // x = n*pi + r, sin(x) = (-1)^n sin(r)
+    SIMDVectorInt n = vecFloatToIntRound(vecMul(x, vecSet1(kOneOverPi)));
+    SIMDVectorFloat fn = vecIntToFloat(n);
+    SIMDVectorFloat r = vecSub(vecSub(x, vecMul(fn, vecSet1(kPiHi))), vecMul(fn, vecSet1(kPiLo)));
+    SIMDVectorFloat signFlip = VecI2F(vecShiftLeftInt(n, 31));
+    return vecXor(vecSinReduced<A>(r), signFlip);
+  }
+}
+
+// cos(x). The low and medium tiers are accurate for |x| < 2^16.
+template <Accuracy A>
+inline SIMDVectorFloat vecCosTiered(SIMDVectorFloat x)
+{
+  using namespace tieredKernels;
+  if constexpr (A == Accuracy::full)
+  {
+    return vecCos(x);
+  }
+  else
+  {
+    // x = n*pi/2 + r with n odd. cos(x) = -sin(r) if n = 1 mod 4, sin(r) if n = 3 mod 4.
+    SIMDVectorFloat q = vecSub(vecMul(x, vecSet1(kOneOverPi)), vecSet1(0.5f));
+    SIMDVectorInt n = vecAddInt(vecShiftLeftInt(vecFloatToIntRound(q), 1), vecSet1Int(1));
+    SIMDVectorFloat fn = vecIntToFloat(n);
+    SIMDVectorFloat r =
+        vecSub(vecSub(x, vecMul(fn, vecSet1(kHalfPiHi))), vecMul(fn, vecSet1(kHalfPiLo)));
+    SIMDVectorInt signBits = vecShiftLeftInt(vecAddInt(n, vecSet1Int(1)), 30);
+    SIMDVectorFloat signFlip = vecAnd(VecI2F(signBits), vecSet1(-0.0f));
+    return vecXor(vecSinReduced<A>(r), signFlip);
+  }
+}
+
+// exp(x). Results are clamped to the range of normal floats.
+template <Accuracy A>
+inline SIMDVectorFloat vecExpTiered(SIMDVectorFloat x)
+{
+  using namespace tieredKernels;
+  if constexpr (A == Accuracy::full)
+  {
+    return vecExp(x);
+  }
+  else
+  {
+    // x = k*ln(2) + r, exp(x) = 2^k * exp(r)
+    x = vecClamp(x, vecSet1(kExpMin), vecSet1(kExpMax));
+    SIMDVectorInt k = vecFloatToIntRound(vecMul(x, vecSet1(kLog2e)));
+    SIMDVectorFloat fk = vecIntToFloat(k);
+    SIMDVectorFloat r = vecSub(vecSub(x, vecMul(fk, vecSet1(kLn2Hi))), vecMul(fk, vecSet1(kLn2Lo)));
+    SIMDVectorFloat p;
+    if constexpr (A == Accuracy::low)
+    {
+      p = vecPolynomial(r, kExpLow);
+    }
+    else
+    {
+      p = vecPolynomial(r, kExpMedium);
+    }
+    SIMDVectorFloat scale = VecI2F(vecShiftLeftInt(vecAddInt(k, vecSet1Int(127)), 23));
+    return vecMul(p, scale);
+  }
+}
+
+// natural log(x). Returns NaN for x <= 0.
+template <Accuracy A>
+inline SIMDVectorFloat vecLogTiered(SIMDVectorFloat x)
+{
+  using namespace tieredKernels;
+  if constexpr (A == Accuracy::full)
+  {
+    return vecLog(x);
+  }
+  else
+  {
+    SIMDVectorFloat invalid = vecLessThanOrEqual(x, vecZeros());
+    x = vecMax(x, vecSet1(FLT_MIN));
+
+    // x = m * 2^e, m in [1, 2)
+    SIMDVectorInt bits = VecF2I(x);
+    SIMDVectorInt e = vecSubInt(vecShiftRightInt(bits, 23), vecSet1Int(127));
+    SIMDVectorFloat m = vecOr(vecAnd(x, VecI2F(vecSet1Int(0x007FFFFF))), vecSet1(1.0f));
+
+    // move m to [sqrt(1/2), sqrt(2))
+    SIMDVectorFloat big = vecGreaterThan(m, vecSet1(kSqrt2));
+    m = vecSelect(vecMul(m, vecSet1(0.5f)), m, big);
+    SIMDVectorFloat fe = vecAdd(vecIntToFloat(e), vecAnd(big, vecSet1(1.0f)));
+
+    // log(m) = 2 atanh(s) = s * P(s^2)
+    SIMDVectorFloat s = vecDiv(vecSub(m, vecSet1(1.0f)), vecAdd(m, vecSet1(1.0f)));
+    SIMDVectorFloat s2 = vecMul(s, s);
+    SIMDVectorFloat logM;
+    if constexpr (A == Accuracy::low)
+    {
+      logM = vecMul(s, vecPolynomial(s2, kLogLow));
+    }
+    else
+    {
+      logM = vecMul(s, vecPolynomial(s2, kLogMedium));
+    }
+    SIMDVectorFloat y =
+        vecAdd(vecMul(fe, vecSet1(kLn2Hi)), vecAdd(vecMul(fe, vecSet1(kLn2Lo)), logM));
+    return vecOr(y, invalid);
+  }
+}
+
+// tanh(x). Uses an odd polynomial near 0 and 1 - 2/(exp(2|x|) + 1) elsewhere.
+template <Accuracy A>
+inline SIMDVectorFloat vecTanhTiered(SIMDVectorFloat x)
+{
+  using namespace tieredKernels;
+  SIMDVectorFloat ax = vecAbs(x);
+  SIMDVectorFloat small = vecLessThan(ax, vecSet1(kTanhPolyMax));
+  SIMDVectorFloat e = vecExpTiered<A>(vecAdd(ax, ax));
+  SIMDVectorFloat t = vecSub(vecSet1(1.0f), vecDiv(vecSet1(2.0f), vecAdd(e, vecSet1(1.0f))));
+  SIMDVectorFloat tSigned = vecOr(t, vecAnd(x, vecSet1(-0.0f)));
+  return vecSelect(vecTanhSmall<A>(x), tSigned, small);
+}
+
+// pow(x, y) for x > 0.
+template <Accuracy A>
+inline SIMDVectorFloat vecPowTiered(SIMDVectorFloat x, SIMDVectorFloat y)
+{
+  return vecExpTiered<A>(vecMul(vecLogTiered<A>(x), y));
+}
+
+}  // namespace ml
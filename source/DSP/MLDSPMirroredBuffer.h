@@ -0,0 +1,165 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMirroredBuffer.h
+// Memory for ring buffers that never need to split an access at the wrap.
+
+#pragma once
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define ML_MIRRORED_MEMORY 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define ML_MIRRORED_MEMORY 0
+#endif
+
+namespace ml
+{
+// MirroredBuffer: memory for a ring buffer, mapped twice in a row where the
+// platform allows, so that data()[i] and data()[i + size()] are the same
+// element. Any access of up to size() elements starting in the first copy is
+// then contiguous, wherever the ring wraps.
+//
+// On Linux the pages are shared from a memfd. Elsewhere, or if mapping fails,
+// the buffer is allocated once and isMirrored() is false, so callers must
+// split their accesses at the end of the buffer as before.
+
+template <class T>
+class MirroredBuffer
+{
+  static_assert(std::is_trivially_copyable<T>::value, "MirroredBuffer needs a trivial type");
+
+ public:
+  MirroredBuffer() = default;
+  MirroredBuffer(const MirroredBuffer& b) { copyFrom(b); }
+  MirroredBuffer& operator=(const MirroredBuffer& b)
+  {
+    if (this != &b) copyFrom(b);
+    return *this;
+  }
+  ~MirroredBuffer() { release(); }
+
+  // allocate at least n elements, where n is a power of two, and zero them.
+  // Mirrored memory is rounded up to a whole number of pages, which keeps the
+  // size a power of two. Returns the new size, or 0 if allocation failed, in
+  // which case the previous memory is kept.
+  size_t resize(size_t n)
+  {
+    if (n == 0)
+    {
+      release();
+      return 0;
+    }
+    MirroredBuffer b;
+    if (!b.allocate(n)) return 0;
+    swap(b);
+    return mSize;
+  }
+
+  T* data() { return mpData; }
+  const T* data() const { return mpData; }
+  size_t size() const { return mSize; }
+  bool isMirrored() const { return mMirrored; }
+
+ private:
+  void copyFrom(const MirroredBuffer& b)
+  {
+    resize(b.mSize);
+    std::copy(b.mpData, b.mpData + std::min(mSize, b.mSize), mpData);
+  }
+
+  bool allocate(size_t n)
+  {
+#if ML_MIRRORED_MEMORY
+    if (allocateMirrored(n)) return true;
+#endif
+    try
+    {
+      mFallback.assign(n, T());
+    }
+    catch (const std::bad_alloc&)
+    {
+      return false;
+    }
+    mpData = mFallback.data();
+    mSize = n;
+    return true;
+  }
+
+  void swap(MirroredBuffer& b)
+  {
+    std::swap(mpData, b.mpData);
+    std::swap(mSize, b.mSize);
+    std::swap(mMirrored, b.mMirrored);
+    mFallback.swap(b.mFallback);
+  }
+
+#if ML_MIRRORED_MEMORY
+  bool allocateMirrored(size_t n)
+  {
+    size_t pageBytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t bytes = (n * sizeof(T) + pageBytes - 1) / pageBytes * pageBytes;
+    if (bytes % sizeof(T)) return false;
+
+    int fd = memfd_create("ml_mirrored_buffer", MFD_CLOEXEC);
+    if (fd < 0) return false;
+
+    // reserve space for both copies, then map the file over each half.
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0)
+    {
+      base = mmap(nullptr, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (base != MAP_FAILED)
+      {
+        char* p = static_cast<char*>(base);
+        int prot = PROT_READ | PROT_WRITE;
+        int flags = MAP_SHARED | MAP_FIXED;
+        if ((mmap(p, bytes, prot, flags, fd, 0) == MAP_FAILED) ||
+            (mmap(p + bytes, bytes, prot, flags, fd, 0) == MAP_FAILED))
+        {
+          munmap(base, bytes * 2);
+          base = MAP_FAILED;
+        }
+      }
+    }
+
+    // the mappings keep the memory alive after the file is closed.
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    // new pages of a memfd are zeroed.
+    mpData = static_cast<T*>(base);
+    mSize = bytes / sizeof(T);
+    mMirrored = true;
+    return true;
+  }
+#endif
+
+  void release()
+  {
+#if ML_MIRRORED_MEMORY
+    if (mMirrored)
+    {
+      munmap(mpData, mSize * sizeof(T) * 2);
+    }
+#endif
+    std::vector<T>().swap(mFallback);
+    mpData = nullptr;
+    mSize = 0;
+    mMirrored = false;
+  }
+
+  T* mpData{nullptr};
+  size_t mSize{0};
+  bool mMirrored{false};
+  std::vector<T> mFallback;
+};
+
+}  // namespace ml
@@ -91,6 +91,10 @@ inline T* DSPVectorAlignPointer(const T* p)
 
 namespace ml
 {
+// lazy expressions, defined in MLDSPExpressions.h.
+template <size_t ROWS, typename E>
+class DSPVectorExpression;
+
 template <size_t ROWS>
 class DSPVectorArray
 {
@@ -186,6 +190,21 @@ class DSPVectorArray
   DSPVectorArray(const DSPVectorArray& x1) noexcept = default;
   DSPVectorArray& operator=(const DSPVectorArray& x1) noexcept = default;
 
+  // construct or assign from a lazy expression, computing all of its
+  // operations in one loop. See MLDSPExpressions.h.
+  template <typename E>
+  DSPVectorArray(const DSPVectorExpression<ROWS, E>& x)
+  {
+    x.evaluate(getBuffer());
+  }
+
+  template <typename E>
+  inline DSPVectorArray& operator=(const DSPVectorExpression<ROWS, E>& x)
+  {
+    x.evaluate(getBuffer());
+    return *this;
+  }
+
   // equality by value
   bool operator==(const DSPVectorArray& x1) const
   {
@@ -602,8 +621,8 @@ DEFINE_OP1(log, (vecLog(x)));
 DEFINE_OP1(exp, (vecExp(x)));
 
 // lazy log2 and exp2 from natural log / exp
-STATIC_M128_CONST(kLogTwoVec, 0.69314718055994529f);
-STATIC_M128_CONST(kLogTwoRVec, 1.4426950408889634f);
+STATIC_SIMD_CONST(kLogTwoVec, 0.69314718055994529f);
+STATIC_SIMD_CONST(kLogTwoRVec, 1.4426950408889634f);
 DEFINE_OP1(log2, (vecMul(vecLog(x), kLogTwoRVec)));
 DEFINE_OP1(exp2, (vecExp(vecMul(kLogTwoVec, x))));
 
@@ -617,6 +636,72 @@ DEFINE_OP1(logApprox, (vecLogApprox(x)));
 DEFINE_OP1(log2Approx, (vecMul(vecLogApprox(x), kLogTwoRVec)));
 DEFINE_OP1(exp2Approx, (vecExpApprox(vecMul(kLogTwoVec, x))));
 
+// ----------------------------------------------------------------
+// unary vector operators (float) -> float with a selectable accuracy.
+// Call with the accuracy as a template argument: sin<Accuracy::low>(x).
+// See MLDSPMathTiered.h for the error of each tier.
+
+#define DEFINE_OP1_TIERED(opName, opComputation)                       \
+  template <Accuracy A, size_t ROWS>                                   \
+  inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1) \
+  {                                                                    \
+    DSPVectorArray<ROWS> vy;                                           \
+    const float* px1 = vx1.getConstBuffer();                           \
+    float* py1 = vy.getBuffer();                                       \
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)          \
+    {                                                                  \
+      SIMDVectorFloat x = vecLoad(px1);                                \
+      vecStore(py1, (opComputation));                                  \
+      px1 += kFloatsPerSIMDVector;                                     \
+      py1 += kFloatsPerSIMDVector;                                     \
+    }                                                                  \
+    return vy;                                                         \
+  }
+
+DEFINE_OP1_TIERED(sin, (vecSinTiered<A>(x)));
+DEFINE_OP1_TIERED(cos, (vecCosTiered<A>(x)));
+DEFINE_OP1_TIERED(exp, (vecExpTiered<A>(x)));
+DEFINE_OP1_TIERED(log, (vecLogTiered<A>(x)));
+DEFINE_OP1_TIERED(tanh, (vecTanhTiered<A>(x)));
+
+// ----------------------------------------------------------------
+// saturators
+
+// tanh from a [7/6] Pade approximant, with the input clamped to where it
+// reaches 1. Max error about 1e-4.
+inline SIMDVectorFloat vecTanhApprox(SIMDVectorFloat x)
+{
+  x = vecClamp(x, vecSet1(-4.97f), vecSet1(4.97f));
+  SIMDVectorFloat x2 = vecMul(x, x);
+  SIMDVectorFloat n = vecAdd(vecMul(x2, vecAdd(x2, vecSet1(378.f))), vecSet1(17325.f));
+  n = vecMul(x, vecAdd(vecMul(x2, n), vecSet1(135135.f)));
+  SIMDVectorFloat d = vecAdd(vecMul(x2, vecSet1(28.f)), vecSet1(3150.f));
+  d = vecAdd(vecMul(x2, vecAdd(vecMul(x2, d), vecSet1(62370.f))), vecSet1(135135.f));
+  return vecDiv(n, d);
+}
+
+// cubic soft clip: 1.5x - 0.5x^3 for x in [-1, 1], and sign(x) outside.
+// The slope is 1.5 at 0 and 0 at the clip points.
+inline SIMDVectorFloat vecSoftclip(SIMDVectorFloat x)
+{
+  x = vecClamp(x, vecSet1(-1.f), vecSet1(1.f));
+  return vecMul(x, vecSub(vecSet1(1.5f), vecMul(vecSet1(0.5f), vecMul(x, x))));
+}
+
+// cubic soft clip with separate limits for negative and positive inputs.
+// lo should be < 0 and hi > 0.
+inline SIMDVectorFloat vecAsymmetricSoftclip(SIMDVectorFloat x, SIMDVectorFloat lo,
+                                             SIMDVectorFloat hi)
+{
+  SIMDVectorFloat k = vecSelect(hi, vecSub(vecZeros(), lo), vecGreaterThan(x, vecZeros()));
+  return vecMul(k, vecSoftclip(vecDiv(x, k)));
+}
+
+DEFINE_OP1(tanh, (vecTanhTiered<Accuracy::full>(x)));
+DEFINE_OP1(tanhApprox, (vecTanhApprox(x)));
+DEFINE_OP1(softclip, (vecSoftclip(x)));
+DEFINE_OP1(hardclip, (vecClamp(x, vecSet1(-1.f), vecSet1(1.f))));
+
 // ----------------------------------------------------------------
 // binary vector operators (float, float) -> float
 
@@ -652,6 +737,24 @@ DEFINE_OP2(powApprox, (vecExpApprox(vecMul(vecLogApprox(x1), x2))));
 DEFINE_OP2(min, (vecMin(x1, x2)));
 DEFINE_OP2(max, (vecMax(x1, x2)));
 
+// pow with a selectable accuracy: pow<Accuracy::medium>(x, y)
+template <Accuracy A, size_t ROWS>
+inline DSPVectorArray<ROWS> pow(const DSPVectorArray<ROWS>& vx1, const DSPVectorArray<ROWS>& vx2)
+{
+  DSPVectorArray<ROWS> vy;
+  const float* px1 = vx1.getConstBuffer();
+  const float* px2 = vx2.getConstBuffer();
+  float* py1 = vy.getBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+  {
+    vecStore(py1, vecPowTiered<A>(vecLoad(px1), vecLoad(px2)));
+    px1 += kFloatsPerSIMDVector;
+    px2 += kFloatsPerSIMDVector;
+    py1 += kFloatsPerSIMDVector;
+  }
+  return vy;
+}
+
 // ----------------------------------------------------------------
 // binary vector operators (float, float) -> float
 // from multiple-row and single-row operands
@@ -751,6 +854,9 @@ DEFINE_OP3(inverseLerp, vecDiv(vecSub(x3, x1), vecSub(x2, x1)));  // mix = inver
 DEFINE_OP3(clamp, vecClamp(x1, x2, x3));    // clamp(x, minBound, maxBound)
 DEFINE_OP3(within, vecWithin(x1, x2, x3));  // is x in the open interval [x2, x3) ?
 
+// softclip(x) scaled to the limits lo < 0 < hi. For a hard asymmetric clip use clamp().
+DEFINE_OP3(asymmetricSoftclip, vecAsymmetricSoftclip(x1, x2, x3));  // (x, lo, hi)
+
 // ----------------------------------------------------------------
 // lerp two vectors with scalar float mixture (constant over each vector)
 
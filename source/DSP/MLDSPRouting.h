@@ -76,30 +76,90 @@ DSPVectorArray<ROWS> mix(DSPVectorArray<INPUTS> gains, DSPVectorArray<ROWS> firs
   return mix_n(0, gains, first, args...);
 }
 
+// The selectors below work on one SIMD vector of the selector at a time. Each
+// lane's input or output index is compared with every index to make lane masks,
+// and the masks select or scale the signals, so there is no per-sample branching.
+// Only the fractional part of the selector is used, so negative selectors wrap
+// around like positive ones.
+
+// Blending costs a compare and two logic ops per input, which for many inputs is
+// more than reading each sample from its selected input. Above this number of
+// inputs the multiplexers compute their indexes with SIMD and then copy samples.
+constexpr int kMaxBlendedInputs = 8;
+
+// for each lane of the selector s, the index trunc(frac(s) * n) in [0, n-1], and
+// the fractional part of frac(s) * n in mix.
+inline SIMDVectorFloat vecSelectorIndex(SIMDVectorFloat s, int n, SIMDVectorFloat& mix)
+{
+  SIMDVectorFloat intPart = vecIntPart(s);
+  SIMDVectorFloat floor = vecSub(intPart, vecAnd(vecGreaterThan(intPart, s), vecSet1(1.f)));
+  SIMDVectorFloat real = vecMul(vecSub(s, floor), vecSet1((float)n));
+  SIMDVectorFloat idx = vecMin(vecIntPart(real), vecSet1(n - 1.f));
+  mix = vecSub(real, idx);
+  return idx;
+}
+
+// the next index after idx, wrapping at n.
+inline SIMDVectorFloat vecNextSelectorIndex(SIMDVectorFloat idx, int n)
+{
+  SIMDVectorFloat next = vecAdd(idx, vecSet1(1.f));
+  return vecSelect(vecZeros(), next, vecEqual(next, vecSet1((float)n)));
+}
+
 // multiplex. selector is a signal that controls what mix of the inputs to send to the output.
 // the selector range [0--1) is mapped to cover the range of inputs equally.
 
 template <size_t ROWS, typename... Args>
-DSPVectorArray<ROWS> multiplex(DSPVector selector, DSPVectorArray<ROWS> first, Args... args)
+DSPVectorArray<ROWS> multiplex(const DSPVector& selector, const DSPVectorArray<ROWS>& first,
+                               const Args&... args)
 {
-  DSPVectorArray<ROWS> inputs[]{first, args...};
+  const float* inputs[]{first.getConstBuffer(), args.getConstBuffer()...};
   constexpr int nInputs = sizeof...(Args) + 1;
 
   DSPVectorArray<ROWS> y;
+  const float* pSelector = selector.getConstBuffer();
+  float* py = y.getBuffer();
 
-  // iterate on each sample of input selector
-  for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  if constexpr (nInputs <= kMaxBlendedInputs)
   {
-    // TODO SIMD
-    int selectorIdx = i % kFloatsPerDSPVector;
-    float s = selector[selectorIdx];
+    for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+    {
+      // get input index from 0 - nInputs-1 for each lane
+      SIMDVectorFloat unusedMix;
+      SIMDVectorFloat inputIdx = vecSelectorIndex(vecLoad(pSelector + i), nInputs, unusedMix);
 
-    // get input index from 0 - nInputs-1
-    float inputU = s - truncf(s);
-    size_t inputSafe = inputU * nInputs;
+      for (size_t j = 0; j < ROWS; ++j)
+      {
+        size_t offset = j * kFloatsPerDSPVector + i;
+        SIMDVectorFloat v = vecZeros();
+        for (int k = 0; k < nInputs; ++k)
+        {
+          SIMDVectorFloat mask = vecEqual(inputIdx, vecSet1((float)k));
+          v = vecOr(v, vecAnd(vecLoad(inputs[k] + offset), mask));
+        }
+        vecStore(py + offset, v);
+      }
+    }
+  }
+  else
+  {
+    DSPVectorInt inputIdx;
+    int32_t* pIdx = inputIdx.getBufferInt();
+    for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat unusedMix;
+      SIMDVectorFloat idx = vecSelectorIndex(vecLoad(pSelector + i), nInputs, unusedMix);
+      vecStore(reinterpret_cast<float*>(pIdx + i), VecI2F(vecFloatToIntTruncate(idx)));
+    }
 
-    // read input sample to output
-    y[i] = inputs[inputSafe][i];
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      size_t rowOffset = j * kFloatsPerDSPVector;
+      for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        py[rowOffset + i] = inputs[pIdx[i]][rowOffset + i];
+      }
+    }
   }
   return y;
 }
@@ -108,126 +168,140 @@ DSPVectorArray<ROWS> multiplex(DSPVector selector, DSPVectorArray<ROWS> first, A
 // the selector range [0--1) is mapped so that 1.0 = the last input.
 
 template <size_t ROWS, typename... Args>
-DSPVectorArray<ROWS> multiplexLinear(DSPVector selector, DSPVectorArray<ROWS> first, Args... args)
+DSPVectorArray<ROWS> multiplexLinear(const DSPVector& selector, const DSPVectorArray<ROWS>& first,
+                                     const Args&... args)
 {
-  DSPVectorArray<ROWS> inputs[]{first, args...};
+  const float* inputs[]{first.getConstBuffer(), args.getConstBuffer()...};
   constexpr int nInputs = sizeof...(Args) + 1;
 
   DSPVectorArray<ROWS> y;
+  const float* pSelector = selector.getConstBuffer();
+  float* py = y.getBuffer();
 
-  // iterate on each sample of input selector
-  for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  if constexpr (nInputs <= kMaxBlendedInputs)
+  {
+    for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+    {
+      // get the two input indexes and mix amount for each lane
+      SIMDVectorFloat mix;
+      SIMDVectorFloat input1Idx = vecSelectorIndex(vecLoad(pSelector + i), nInputs, mix);
+      SIMDVectorFloat input2Idx = vecNextSelectorIndex(input1Idx, nInputs);
+
+      for (size_t j = 0; j < ROWS; ++j)
+      {
+        size_t offset = j * kFloatsPerDSPVector + i;
+        SIMDVectorFloat a = vecZeros();
+        SIMDVectorFloat b = vecZeros();
+        for (int k = 0; k < nInputs; ++k)
+        {
+          SIMDVectorFloat vk = vecSet1((float)k);
+          SIMDVectorFloat x = vecLoad(inputs[k] + offset);
+          a = vecOr(a, vecAnd(x, vecEqual(input1Idx, vk)));
+          b = vecOr(b, vecAnd(x, vecEqual(input2Idx, vk)));
+        }
+
+        // interpolate to output
+        vecStore(py + offset, vecAdd(a, vecMul(mix, vecSub(b, a))));
+      }
+    }
+  }
+  else
   {
-    // TODO SIMD
-    int selectorIdx = i % kFloatsPerDSPVector;
-    float s = selector[selectorIdx];
-
-    // get input index from 0 - nInputs-1
-    float inputU = s - truncf(s);
-    float inputReal = inputU * nInputs;
-    float inputInt = truncf(inputReal);
-    float inputFrac = inputReal - inputInt;
-    size_t input1Safe = inputInt;
-    size_t input2Safe = (input1Safe + 1) % nInputs;
-
-    // read input samples and interpolate to output
-    y[i] = lerp(inputs[input1Safe][i], inputs[input2Safe][i], inputFrac);
+    DSPVectorInt input1Idx, input2Idx;
+    DSPVector mix;
+    int32_t* pIdx1 = input1Idx.getBufferInt();
+    int32_t* pIdx2 = input2Idx.getBufferInt();
+    for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat m;
+      SIMDVectorFloat idx1 = vecSelectorIndex(vecLoad(pSelector + i), nInputs, m);
+      SIMDVectorFloat idx2 = vecNextSelectorIndex(idx1, nInputs);
+      vecStore(reinterpret_cast<float*>(pIdx1 + i), VecI2F(vecFloatToIntTruncate(idx1)));
+      vecStore(reinterpret_cast<float*>(pIdx2 + i), VecI2F(vecFloatToIntTruncate(idx2)));
+      vecStore(mix.getBuffer() + i, m);
+    }
+
+    for (size_t j = 0; j < ROWS; ++j)
+    {
+      size_t rowOffset = j * kFloatsPerDSPVector;
+      DSPVector a, b;
+      for (size_t i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        a[i] = inputs[pIdx1[i]][rowOffset + i];
+        b[i] = inputs[pIdx2[i]][rowOffset + i];
+      }
+
+      // interpolate to output
+      y.row(j) = a + mix * (b - a);
+    }
   }
   return y;
 }
 
 // demultiplex the input to the outputs based on the value of the selector at each sample.
+// The selector and input are taken by value, so any output may alias them.
 
 template <size_t ROWS, typename... Args>
-void demultiplex(DSPVector selector, DSPVectorArray<ROWS> input, DSPVectorArray<ROWS>* firstOutput,
-                 Args... args)
+void demultiplex(DSPVector selector, DSPVectorArray<ROWS> input,
+                 DSPVectorArray<ROWS>* firstOutput, Args... args)
 {
-  DSPVectorArray<ROWS>* outputs[]{firstOutput, args...};
+  float* outputs[]{firstOutput->getBuffer(), args->getBuffer()...};
   constexpr int nOutputs = sizeof...(Args) + 1;
 
-  DSPVector outputIntSafe;
+  const float* pSelector = selector.getConstBuffer();
+  const float* pInput = input.getConstBuffer();
 
-  // for each sample, get the output index from the selector
-  for (int i = 0; i < kFloatsPerDSPVector; ++i)
+  for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
   {
-    // TODO SIMD
-    float s = selector[i];
-
-    // get input index from 0 - nInputs-1
-    float outputU = s - truncf(s);
-    size_t outputInt = outputU * nOutputs;
-    outputIntSafe[i] = outputInt;
-  }
+    // get output index from 0 - nOutputs-1 for each lane
+    SIMDVectorFloat unusedMix;
+    SIMDVectorFloat outputIdx = vecSelectorIndex(vecLoad(pSelector + i), nOutputs, unusedMix);
 
-  // for each output, for each sample, if the selected output index at the
-  // sample equals the output, write the input that that output. Else write 0.
-  for (int j = 0; j < nOutputs; ++j)
-  {
-    DSPVectorArray<ROWS>* pOutput = outputs[j];
-    for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+    // write the input to the selected output at each lane, and 0 to the others.
+    for (int k = 0; k < nOutputs; ++k)
     {
-      int selectorIdx = i % kFloatsPerDSPVector;
-      size_t outputInt = outputIntSafe[selectorIdx];
-      (*pOutput)[i] = (outputInt == j) ? input[i] : 0;
+      SIMDVectorFloat mask = vecEqual(outputIdx, vecSet1((float)k));
+      for (size_t j = 0; j < ROWS; ++j)
+      {
+        size_t offset = j * kFloatsPerDSPVector + i;
+        vecStore(outputs[k] + offset, vecAnd(vecLoad(pInput + offset), mask));
+      }
     }
   }
 }
 
 // demultiplex the input to the outputs based on the value of the selector at each sample.
-// deinterpolate linearly to neighboring outputs.
+// deinterpolate linearly to neighboring outputs. Any output may alias the selector or input.
 
 template <size_t ROWS, typename... Args>
 void demultiplexLinear(DSPVector selector, DSPVectorArray<ROWS> input,
                        DSPVectorArray<ROWS>* firstOutput, Args... args)
 {
-  DSPVectorArray<ROWS>* outputs[]{firstOutput, args...};
+  float* outputs[]{firstOutput->getBuffer(), args->getBuffer()...};
   constexpr int nOutputs = sizeof...(Args) + 1;
 
-  DSPVector outputInt1Safe;
-  DSPVector outputInt2Safe;
-  DSPVector outputMix;
-
-  // for each sample, get the two output indexes and mix amount from the selector
-  for (int i = 0; i < kFloatsPerDSPVector; ++i)
-  {
-    // TODO SIMD
-    float s = selector[i];
-
-    // get input index from 0 - nInputs-1
-    float outputU = s - truncf(s);
-    float outputReal = outputU * nOutputs;
-    float outputIntPart = truncf(outputReal);
-    size_t outputInt = outputIntPart;
-    outputMix[i] = outputReal - outputIntPart;
-    outputInt1Safe[i] = outputInt;
-    outputInt2Safe[i] = (outputInt + 1) % nOutputs;
-  }
+  const float* pSelector = selector.getConstBuffer();
+  const float* pInput = input.getConstBuffer();
 
-  // for each output, for each sample, if the selected output index at the
-  // sample equals the output, write the input that that output. Else write 0.
-  for (int j = 0; j < nOutputs; ++j)
+  for (size_t i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
   {
-    DSPVectorArray<ROWS>* pOutput = outputs[j];
-    for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+    // get the two output indexes and mix amount for each lane
+    SIMDVectorFloat mix;
+    SIMDVectorFloat output1Idx = vecSelectorIndex(vecLoad(pSelector + i), nOutputs, mix);
+    SIMDVectorFloat output2Idx = vecNextSelectorIndex(output1Idx, nOutputs);
+    SIMDVectorFloat gain1 = vecSub(vecSet1(1.f), mix);
+
+    // deinterpolate the input to the two selected outputs at each lane, and
+    // write 0 to the others. If both indexes are the same, the first wins.
+    for (int k = 0; k < nOutputs; ++k)
     {
-      int selectorIdx = i % kFloatsPerDSPVector;
-      size_t outputInt1 = outputInt1Safe[selectorIdx];
-      size_t outputInt2 = outputInt2Safe[selectorIdx];
-      float m = outputMix[selectorIdx];
-
-      if (j == outputInt1)
-      {
-        // deinterpolate a
-        (*pOutput)[i] = input[i] * (1.f - m);
-      }
-      else if (j == outputInt2)
-      {
-        // deinterpolate b
-        (*pOutput)[i] = input[i] * m;
-      }
-      else
+      SIMDVectorFloat vk = vecSet1((float)k);
+      SIMDVectorFloat gain = vecSelect(gain1, vecAnd(mix, vecEqual(output2Idx, vk)),
+                                       vecEqual(output1Idx, vk));
+      for (size_t j = 0; j < ROWS; ++j)
       {
-        (*pOutput)[i] = 0;
+        size_t offset = j * kFloatsPerDSPVector + i;
+        vecStore(outputs[k] + offset, vecMul(vecLoad(pInput + offset), gain));
       }
     }
   }
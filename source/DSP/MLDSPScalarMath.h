@@ -30,9 +30,9 @@ constexpr float kMinGain = 0.00001f;  // 10e-5 = -120dB
 typedef float MLSample;
 
 // return the exponent of the smallest power of 2 that is >= x.
-inline size_t bitsToContain(int x)
+constexpr size_t bitsToContain(int x)
 {
-  int exp;
+  int exp{0};
   for (exp = 0; (1 << exp) < x; exp++)
     ;
   return (exp);
@@ -66,22 +66,37 @@ class VectorProcessBuffer
   VectorProcessBuffer(size_t inputs, size_t outputs, size_t maxFrames)
       : _inputVectors(inputs), _outputVectors(outputs), _maxFrames(maxFrames)
   {
+    // between calls, up to one DSPVector of input or output can be left over
+    // in addition to the frames of a single call.
+    int bufferSize = (int)(_maxFrames + kFloatsPerDSPVector);
+
     _inputBuffers.resize(inputs);
     for (int i = 0; i < inputs; ++i)
     {
-      _inputBuffers[i].resize((int)_maxFrames);
+      _inputBuffers[i].resize(bufferSize);
     }
 
+    // start the outputs with one DSPVector of silence. This fixed latency
+    // guarantees a full vector of input is available whenever we need to
+    // process, whatever the sizes of the chunks we are called with.
+    DSPVector silence;
     _outputBuffers.resize(outputs);
     for (int i = 0; i < outputs; ++i)
     {
-      _outputBuffers[i].resize((int)_maxFrames);
+      _outputBuffers[i].resize(bufferSize);
+      _outputBuffers[i].write(silence);
     }
   }
 
+  // the latency in samples from inputs to outputs.
+  static constexpr size_t getLatency() { return kFloatsPerDSPVector; }
+
   ~VectorProcessBuffer() {}
 
-  void process(const float** inputs, float** outputs, int nFrames, ProcessVectorFn processFn,
+  // process nFrames of input to output. processFn can be any callable object
+  // with the signature of ProcessVectorFn.
+  template <typename F>
+  void process(const float** inputs, float** outputs, int nFrames, F&& processFn,
                void* stateData = nullptr)
   {
     size_t nInputs = _inputVectors.size();
@@ -124,6 +139,13 @@ class VectorProcessBuffer
       }
     }
   }
+
+  // std::function version, kept for compatibility
+  void process(const float** inputs, float** outputs, int nFrames, ProcessVectorFn processFn,
+               void* stateData = nullptr)
+  {
+    process<ProcessVectorFn&>(inputs, outputs, nFrames, processFn, stateData);
+  }
 };
 
 // FlushToZeroHandler: turn off denormal math so that (for example) IIR filters don't consume
@@ -238,4 +238,57 @@ Path substitute(Path p, Symbol fromSymbol, Path toPath)
   return r;
 }
 
+#pragma mark PathTable
+
+PathTable::PathTable()
+{
+  clear();
+  theSymbolTable().addDependentTable(this, [this]() { clear(); });
+}
+
+PathTable::~PathTable() { theSymbolTable().removeDependentTable(this); }
+
+void PathTable::clear()
+{
+  // add the null entry, ID 0, which is the empty path.
+  mEntries.clear().hash = pathHash(Path());
+}
+
+uint32_t PathTable::findEntry(const Path& p, uint32_t hash)
+{
+  return mEntries.find(hash, [&](const Entry& entry) { return entry.path == p; });
+}
+
+uint32_t PathTable::addEntry(const Path& p, uint32_t hash)
+{
+  // another thread may have added the path since we looked.
+  auto matches = [&](const Entry& entry) { return entry.path == p; };
+  return mEntries.add(hash, matches, [&](Entry& entry) {
+    entry.path = p;
+    entry.path.setCopy(0);
+    entry.text = pathToText(p);
+    entry.hash = hash;
+  });
+}
+
+uint32_t PathTable::getPathID(const Path& p)
+{
+  if (!p) return 0;
+  uint32_t hash = pathHash(p);
+  uint32_t r = findEntry(p, hash);
+  return r ? r : addEntry(p, hash);
+}
+
+uint32_t PathTable::getPathID(const HashedPath& hp)
+{
+  // compare the text to that of each path with the same hash, so that no
+  // Symbols are made if the path is already in the table. Text that is not in
+  // the canonical form made by pathToText() will not match, and is parsed.
+  uint32_t r = mEntries.find(hp.hash, [&](const Entry& entry) {
+    const TextFragment& text = entry.text;
+    return compareSizedCharArrays(text.getText(), text.lengthInBytes(), hp.pChars, hp.len);
+  });
+  return r ? r : getPathID(Path(TextFragment(hp.pChars, hp.len)));
+}
+
 }  // namespace ml
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <mutex>
 #include <numeric>
+#include <string>
+#include <type_traits>
 
 #include "MLSymbol.h"
 #include "MLTextUtils.h"
@@ -144,9 +147,13 @@ class Path final
   unsigned char mCopy{0};
   unsigned char _dummy{0};
   unsigned char _dummy2{0};
-  // sizeof(Path) = 64
 };
 
+// with 32-bit Symbols, a Path fits in one cache line and is copied with a few
+// vector moves, as it is every time a Message is queued.
+static_assert(sizeof(Path) == 64, "Path should fit in one cache line");
+static_assert(std::is_trivially_copyable<Path>::value, "Path should be trivially copyable");
+
 inline bool operator==(const Path& a, const Path& b)
 {
   auto an = a.getSize();
@@ -210,5 +217,191 @@ inline Path addExtensionToPath(Path p, TextFragment ext)
   return Path(butLast(p), Path(nameWithExtension));
 }
 
+// ----------------------------------------------------------------
+#pragma mark path hashing
+
+// the hash of a Path is made by combining the symbolHash() of each element in
+// order, so that it can be made from a Path's Symbols at runtime or from
+// literal path text at compile time with the same result.
+
+constexpr uint32_t kPathHashSeed = 0x5bd1e995u;
+
+constexpr uint32_t combinePathHash(uint32_t h, uint32_t elementHash)
+{
+  return h ^ (elementHash + 0x9e3779b9u + (h << 6) + (h >> 2));
+}
+
+// call f(start, length) for each element of the path text, skipping empty
+// elements and any past kPathMaxSymbols as Path's parser does. Returns false
+// if f returns false for any element.
+template <typename F>
+constexpr bool forEachPathElement(const char* str, size_t len, const char separator, F&& f)
+{
+  int elements = 0;
+  size_t i = 0;
+  while ((i < len) && (elements < kPathMaxSymbols))
+  {
+    size_t start = i;
+    while ((i < len) && (str[i] != separator))
+    {
+      ++i;
+    }
+    if (i > start)
+    {
+      if (!f(str + start, i - start)) return false;
+      elements++;
+    }
+    ++i;
+  }
+  return true;
+}
+
+constexpr uint32_t pathTextHash(const char* str, size_t len, const char separator = '/')
+{
+  uint32_t h = kPathHashSeed;
+  forEachPathElement(str, len, separator, [&h](const char* pElement, size_t elementLen) {
+    h = combinePathHash(h, symbolHash(pElement, elementLen));
+    return true;
+  });
+  return mixHash(h);
+}
+
+inline uint32_t pathHash(const Path& p)
+{
+  uint32_t h = kPathHashSeed;
+  for (Symbol s : p)
+  {
+    h = combinePathHash(h, s.getHash());
+  }
+  return mixHash(h);
+}
+
+// the text of a path with its hash. The ctors are constexpr, so a HashedPath
+// declared constexpr is made at compile time, and looking up its PathID does
+// no parsing or hashing if the path has been interned before:
+//
+//   constexpr HashedPath kOscPath("voices/voice1/osc");
+//   PathID oscID(kOscPath);
+class HashedPath
+{
+ public:
+  constexpr HashedPath(const char* pC)
+      : len(std::char_traits<char>::length(pC)), hash(pathTextHash(pC, len)), pChars(pC)
+  {
+  }
+
+  constexpr HashedPath(const char* pC, size_t lengthBytes)
+      : len(lengthBytes), hash(pathTextHash(pC, len)), pChars(pC)
+  {
+  }
+
+  const size_t len;
+  const uint32_t hash;
+  const char* pChars;
+};
+
+// ----------------------------------------------------------------
+#pragma mark PathTable
+
+// a PathTable interns whole Paths, giving each distinct Path a 32-bit ID in
+// order of creation. As with the SymbolTable, looking up a Path that is
+// already in the table takes no locks and allocates no memory, and IDs stay
+// valid until the table is cleared. The copy number is not part of a Path's
+// identity in the table. Paths hold Symbols, so the table adds itself to the
+// SymbolTable's dependent tables, and is cleared whenever the SymbolTable is.
+
+// Paths are stored in chunks of 2^kPathChunkBits.
+constexpr size_t kPathChunkBits = 8;
+constexpr size_t kPathChunkSize = 1 << kPathChunkBits;
+constexpr size_t kPathChunkMask = kPathChunkSize - 1;
+
+// the maximum number of chunks, which limits the table to 1M paths.
+constexpr size_t kMaxPathChunks = 1 << 12;
+constexpr size_t kMaxPaths = kMaxPathChunks * kPathChunkSize;
+
+constexpr int kInitialPathHashBits = 10;
+
+class PathTable
+{
+  friend class PathID;
+
+ public:
+  PathTable();
+  ~PathTable();
+
+  // clear all paths from the table. Not thread-safe: no other thread may
+  // use the table during the call, and any existing PathIDs become invalid.
+  void clear();
+  size_t getSize() { return mEntries.size(); }
+
+ protected:
+  // look up a path and return its ID, adding it to the table if needed. ID 0
+  // is the empty path, which is also returned for new paths once the table
+  // holds kMaxPaths.
+  uint32_t getPathID(const Path& p);
+  uint32_t getPathID(const HashedPath& hp);
+
+  inline const Path& getPathByID(uint32_t id) { return mEntries.getEntry(id).path; }
+
+ private:
+  // a path, its text and its hash.
+  struct Entry
+  {
+    Path path;
+    TextFragment text;
+    uint32_t hash{0};
+  };
+
+  uint32_t findEntry(const Path& p, uint32_t hash);
+  uint32_t addEntry(const Path& p, uint32_t hash);
+
+  // the entries in ID/creation order, and their hash index.
+  InternTable<Entry, kPathChunkBits, kMaxPathChunks> mEntries{1 << kInitialPathHashBits};
+};
+
+inline PathTable& thePathTable()
+{
+  static const std::unique_ptr<PathTable> t(new PathTable());
+  return *t;
+}
+
+// ----------------------------------------------------------------
+#pragma mark PathID
+
+// a PathID is the interned form of a Path: one 32-bit ID that can be
+// compared, copied and hashed in constant time. Use it to key maps of
+// parameters or message targets instead of walking a Tree with a Path.
+
+class PathID
+{
+ public:
+  PathID() = default;
+  PathID(const Path& p) : id(thePathTable().getPathID(p)) {}
+  PathID(const HashedPath& hp) : id(thePathTable().getPathID(hp)) {}
+  PathID(const char* pC) : id(thePathTable().getPathID(HashedPath(pC))) {}
+
+  inline bool operator==(const PathID b) const { return (id == b.id); }
+  inline bool operator!=(const PathID b) const { return (id != b.id); }
+  inline bool operator<(const PathID b) const { return (id < b.id); }
+
+  explicit operator bool() const { return id != 0; }
+
+  inline const Path& getPath() const { return thePathTable().getPathByID(id); }
+  uint32_t getID() const { return id; }
+
+ private:
+  uint32_t id{0};
+};
 
 }  // namespace ml
+
+// hashing function for ml::PathID use in unordered STL containers. simply
+// return the ID, which gives each PathID a unique hash.
+namespace std
+{
+template <>
+struct hash<ml::PathID>
+{
+  std::size_t operator()(const ml::PathID& p) const { return p.getID(); }
+};
+}  // namespace std
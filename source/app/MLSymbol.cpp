@@ -4,8 +4,48 @@
 
 #include "MLSymbol.h"
 
+#include <algorithm>
+#include <fstream>
+
+#include "MLPlatform.h"
+
+#if !ML_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace ml
 {
+#pragma mark HashIndex
+
+HashIndex::HashIndex(size_t size) : mMask(size - 1), mSlots(new std::atomic<uint64_t>[size]{}) {}
+
+void HashIndex::insert(uint32_t hash, uint32_t id)
+{
+  size_t i = hash & mMask;
+  while (mSlots[i].load(std::memory_order_relaxed))
+  {
+    i = (i + 1) & mMask;
+  }
+  mSlots[i].store(makeSlot(hash, id), std::memory_order_release);
+}
+
+std::unique_ptr<HashIndex> HashIndex::grow() const
+{
+  auto newIndex = std::make_unique<HashIndex>(size() * 2);
+  for (size_t i = 0; i < size(); ++i)
+  {
+    uint64_t slot = mSlots[i].load(std::memory_order_relaxed);
+    if (slot)
+    {
+      newIndex->insert(slotHash(slot), slotID(slot));
+    }
+  }
+  return newIndex;
+}
+
 #pragma mark SymbolTable
 
 SymbolTable::SymbolTable() { clear(); }
@@ -15,73 +55,62 @@ SymbolTable::~SymbolTable()
   // TODO better protection on delete
   // can this be avoided with more explicit setup / shutdown
   // (RAII in main() )
-  // std::unique_lock<std::mutex> lock(mMutex);
 }
 
 // clear all symbols from the table.
 void SymbolTable::clear()
 {
-  mSize = 0;
-  // std::unique_lock<std::mutex> lock(mMutex);
-
-  mSymbolTextsByID.clear();
-  mSymbolTextsByID.reserve(kDefaultSymbolTableSize);
+  // add the null entry, ID 0, which is the symbol with no text.
+  mEntries.clear().hash = symbolHash(nullptr, 0);
 
-  for (int i = 0; i < kHashTableSize; ++i)
+  for (auto& table : mDependentTables)
   {
-    clearEntry(mHashTable[i]);
+    table.second();
   }
-
-  // add null entry - why?
-  addEntry(HashedCharArray());
 }
 
-// add an entry to the table. The entry must not already exist in the table.
-// this must be the only way of modifying the symbol table.
-SymbolID SymbolTable::addEntry(const HashedCharArray& hsl)
+void SymbolTable::addDependentTable(const void* owner, std::function<void()> clearFn)
 {
-  mSymbolTextsByID.emplace_back(TextFragment(hsl.pChars, static_cast<int>(hsl.len)));
-
-  size_t newID = mSize++;
-  mHashTable[hsl.hash].mIDVector.emplace_back(newID);
-  return newID;
+  mDependentTables.emplace_back(owner, std::move(clearFn));
 }
 
-SymbolID SymbolTable::getSymbolID(const HashedCharArray& hsl)
+void SymbolTable::removeDependentTable(const void* owner)
 {
-  SymbolID r = 0;
+  auto sameOwner = [&](const auto& table) { return table.first == owner; };
+  mDependentTables.erase(
+      std::remove_if(mDependentTables.begin(), mDependentTables.end(), sameOwner),
+      mDependentTables.end());
+}
 
-  // get the vector of symbol IDs matching this hash. It probably has one entry
-  // but may have more.
-  const std::vector<SymbolID>& bin = mHashTable[hsl.hash].mIDVector;
-  {
-    bool found = false;
+bool SymbolTable::hasText(const Entry& entry, const HashedCharArray& hsl)
+{
+  const TextFragment& text = entry.text;
+  return compareSizedCharArrays(text.getText(), text.lengthInBytes(), hsl.pChars, hsl.len);
+}
 
-    std::unique_lock<std::mutex> lock(mHashTable[hsl.hash].mMutex);
+SymbolID SymbolTable::findEntry(const HashedCharArray& hsl)
+{
+  // probe from the slot for the hash until an empty slot is found. There should
+  // be few collisions, and the full hashes are compared before the text, so
+  // probably only the text of the symbol we are looking for will be compared.
+  return mEntries.find(hsl.hash, [&](const Entry& entry) { return hasText(entry, hsl); });
+}
 
-    for (auto ID : bin)
-    {
-      // there should be few collisions, so probably the first ID in the hash
-      // bin will be the symbol we are looking for. Unfortunately to test for
-      // equality we may have to compare the entire string.
-      TextFragment* binFragment = &mSymbolTextsByID[ID];
-      if (compareSizedCharArrays(binFragment->getText(), binFragment->lengthInBytes(), hsl.pChars,
-                                 hsl.len))
-      {
-        r = ID;
-        found = true;
-        break;
-      }
-    }
+SymbolID SymbolTable::addEntry(const HashedCharArray& hsl)
+{
+  // another thread may have added the symbol since we looked.
+  auto matches = [&](const Entry& entry) { return hasText(entry, hsl); };
+  return mEntries.add(hsl.hash, matches, [&](Entry& entry) {
+    entry.text = TextFragment(hsl.pChars, static_cast<int>(hsl.len));
+    entry.hash = hsl.hash;
+  });
+}
 
-    if (!found)
-    {
-      mSymbolTextsByID.emplace_back(TextFragment(hsl.pChars, static_cast<int>(hsl.len)));
-      r = mSize++;
-      mHashTable[hsl.hash].mIDVector.emplace_back(r);
-    }
-  }
-  return r;
+SymbolID SymbolTable::getSymbolID(const HashedCharArray& hsl)
+{
+  if (!hsl.len) return 0;
+  SymbolID r = findEntry(hsl);
+  return r ? r : addEntry(hsl);
 }
 
 SymbolID SymbolTable::getSymbolID(const char* sym) { return getSymbolID(HashedCharArray(sym)); }
@@ -93,46 +122,76 @@ SymbolID SymbolTable::getSymbolID(const char* sym, size_t lengthBytes)
 
 const TextFragment& SymbolTable::getSymbolTextByID(SymbolID symID)
 {
-  return mSymbolTextsByID[symID];
+  return mEntries.getEntry(symID).text;
+}
+
+SymbolTable::Stats SymbolTable::getStats()
+{
+  auto lock = mEntries.lock();
+  const HashIndex& index = mEntries.getIndex();
+  Stats stats{getSize(), index.size(), 0, 0, 0.f, 0};
+
+  std::vector<uint32_t> hashes;
+  size_t totalProbeLength{0};
+  for (size_t i = 0; i < index.size(); ++i)
+  {
+    uint64_t slot = index.getSlot(i);
+    if (!slot) continue;
+    uint32_t hash = HashIndex::slotHash(slot);
+    hashes.push_back(hash);
+    size_t probeLength = ((i - hash) & (index.size() - 1)) + 1;
+    totalProbeLength += probeLength;
+    stats.maxProbeLength = std::max(stats.maxProbeLength, probeLength);
+    if (probeLength > 1)
+    {
+      stats.collisions++;
+    }
+  }
+  if (hashes.size())
+  {
+    stats.meanProbeLength = static_cast<float>(totalProbeLength) / hashes.size();
+  }
+
+  // count each symbol in a run of equal hashes.
+  std::sort(hashes.begin(), hashes.end());
+  for (size_t i = 0; i < hashes.size(); ++i)
+  {
+    bool sameAsPrev = (i > 0) && (hashes[i] == hashes[i - 1]);
+    bool sameAsNext = (i + 1 < hashes.size()) && (hashes[i] == hashes[i + 1]);
+    if (sameAsPrev || sameAsNext)
+    {
+      stats.hashCollisions++;
+    }
+  }
+  return stats;
 }
 
 void SymbolTable::dump()
 {
+  size_t size = getSize();
   std::cout << "---------------------------------------------------------\n";
-  std::cout << mSymbolTextsByID.size() << " symbols:\n";
+  std::cout << size << " symbols:\n";
 
   // print symbols in order of creation.
-  for (int i = 0; i < mSymbolTextsByID.size(); ++i)
+  for (size_t i = 0; i < size; ++i)
   {
-    const TextFragment& sym = mSymbolTextsByID[i];
+    const TextFragment& sym = getSymbolTextByID(i);
     std::cout << "    ID " << i << " = " << sym << "\n";
   }
-  // print nonzero entries in hash table
-  int hash = 0;
-  for (auto& tableEntry : mHashTable)
-  {
-    auto idVec = tableEntry.mIDVector;
-    size_t idVecLen = idVec.size();
-    if (idVecLen > 0)
-    {
-      std::cout << "#" << hash << " ";
-      for (auto id : idVec)
-      {
-        std::cout << id << " " << getSymbolTextByID(id) << " ";
-      }
 
-      std::cout << "\n";
-    }
-    hash++;
-  }
+  // print statistics of the hash index.
+  Stats stats = getStats();
+  std::cout << stats.slots << " slots, " << stats.collisions << " collisions, "
+            << stats.hashCollisions << " hash collisions, probe length mean "
+            << stats.meanProbeLength << " max " << stats.maxProbeLength << "\n";
 }
 
 int SymbolTable::audit()
 {
-  int i = 0;
+  size_t i = 0;
   SymbolID i2{0};
   bool OK = true;
-  size_t size = mSymbolTextsByID.size();
+  size_t size = getSize();
 
   for (i = 0; i < size; ++i)
   {
@@ -161,6 +220,188 @@ int SymbolTable::audit()
   return OK;
 }
 
+#pragma mark images
+
+// the layout of an image: the header is followed by the slots of the hash
+// index, then the offset of the text of each symbol and of the end of the
+// text, then the text of all the symbols without null terminators.
+namespace
+{
+constexpr char kImageMagic[4]{'M', 'L', 'S', 'Y'};
+constexpr uint32_t kImageVersion{1};
+constexpr uint32_t kImageByteOrder{0x01020304};
+
+struct SymbolImageHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t symbols;
+  uint32_t slots;
+  uint32_t textBytes;
+};
+
+size_t imageSize(const SymbolImageHeader& h)
+{
+  return sizeof(SymbolImageHeader) + h.slots * sizeof(uint64_t) +
+         (h.symbols + 1) * sizeof(uint32_t) + h.textBytes;
+}
+}  // namespace
+
+std::vector<uint8_t> SymbolTable::getImage()
+{
+  auto lock = mEntries.lock();
+  const HashIndex& index = mEntries.getIndex();
+  size_t symbols = getSize();
+
+  SymbolImageHeader header{};
+  std::copy(kImageMagic, kImageMagic + 4, header.magic);
+  header.version = kImageVersion;
+  header.byteOrder = kImageByteOrder;
+  header.symbols = static_cast<uint32_t>(symbols);
+  header.slots = static_cast<uint32_t>(index.size());
+  for (size_t i = 0; i < symbols; ++i)
+  {
+    header.textBytes += static_cast<uint32_t>(getSymbolTextByID(i).lengthInBytes());
+  }
+
+  std::vector<uint8_t> image(imageSize(header));
+  uint8_t* p = image.data();
+  std::memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  for (size_t i = 0; i < index.size(); ++i)
+  {
+    uint64_t slot = index.getSlot(i);
+    std::memcpy(p, &slot, sizeof(slot));
+    p += sizeof(slot);
+  }
+  uint32_t offset{0};
+  for (size_t i = 0; i <= symbols; ++i)
+  {
+    std::memcpy(p, &offset, sizeof(offset));
+    p += sizeof(offset);
+    if (i < symbols)
+    {
+      offset += static_cast<uint32_t>(getSymbolTextByID(i).lengthInBytes());
+    }
+  }
+  for (size_t i = 0; i < symbols; ++i)
+  {
+    const TextFragment& text = getSymbolTextByID(i);
+    p = std::copy(text.getText(), text.getText() + text.lengthInBytes(), p);
+  }
+  return image;
+}
+
+bool SymbolTable::saveImage(const char* path)
+{
+  auto image = getImage();
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(image.data()), image.size());
+  return file.good();
+}
+
+bool SymbolTable::loadImage(const uint8_t* pData, size_t size)
+{
+  clear();
+
+  // check that the header matches and the sizes agree.
+  SymbolImageHeader header;
+  if (size < sizeof(header)) return false;
+  std::memcpy(&header, pData, sizeof(header));
+  if (!std::equal(kImageMagic, kImageMagic + 4, header.magic)) return false;
+  if ((header.version != kImageVersion) || (header.byteOrder != kImageByteOrder)) return false;
+  if ((header.symbols < 1) || (header.symbols > kMaxSymbols)) return false;
+  bool slotsPowerOfTwo = !(header.slots & (header.slots - 1));
+  if (!slotsPowerOfTwo || (header.slots < (1 << kInitialSymbolHashBits))) return false;
+  if ((header.slots < 2 * (header.symbols - 1)) || (size != imageSize(header))) return false;
+
+  const uint8_t* pSlots = pData + sizeof(header);
+  const uint8_t* pOffsets = pSlots + header.slots * sizeof(uint64_t);
+  const char* pText = reinterpret_cast<const char*>(pOffsets + (header.symbols + 1) * 4);
+  auto getOffset = [&](size_t i) {
+    uint32_t offset;
+    std::memcpy(&offset, pOffsets + i * sizeof(offset), sizeof(offset));
+    return offset;
+  };
+
+  // copy the text of each symbol into its entry.
+  if ((getOffset(0) != 0) || (getOffset(header.symbols) != header.textBytes))
+  {
+    return false;
+  }
+  for (size_t i = 1; i < header.symbols; ++i)
+  {
+    uint32_t start = getOffset(i);
+    uint32_t end = getOffset(i + 1);
+    if ((end < start) || (end > header.textBytes))
+    {
+      clear();
+      return false;
+    }
+    mEntries.allocateEntry(i).text = TextFragment(pText + start, end - start);
+  }
+
+  // copy the hash index, checking each ID and setting the hash of its entry.
+  // Each ID must appear once, or another would be missing from the index.
+  auto index = std::make_unique<HashIndex>(header.slots);
+  std::vector<bool> seen(header.symbols);
+  size_t usedSlots{0};
+  for (size_t i = 0; i < header.slots; ++i)
+  {
+    uint64_t slot;
+    std::memcpy(&slot, pSlots + i * sizeof(slot), sizeof(slot));
+    if (!slot) continue;
+    uint32_t id = HashIndex::slotID(slot);
+    if ((id == 0) || (id >= header.symbols) || seen[id])
+    {
+      clear();
+      return false;
+    }
+    seen[id] = true;
+    mEntries.getEntry(id).hash = HashIndex::slotHash(slot);
+    index->setSlot(i, slot);
+    usedSlots++;
+  }
+  if (usedSlots != header.symbols - 1)
+  {
+    clear();
+    return false;
+  }
+
+  mEntries.restore(std::move(index), header.symbols);
+  return true;
+}
+
+bool SymbolTable::loadImage(const char* path)
+{
+#if ML_WINDOWS
+  // read the whole file instead.
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  return loadImage(image.data(), image.size());
+#else
+  bool result{false};
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat fileStat;
+  if ((fstat(fd, &fileStat) == 0) && (fileStat.st_size > 0))
+  {
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    void* pData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pData != MAP_FAILED)
+    {
+      result = loadImage(static_cast<const uint8_t*>(pData), size);
+      munmap(pData, size);
+    }
+  }
+  close(fd);
+  return result;
+#endif
+}
+
 std::ostream& operator<<(std::ostream& out, const Symbol r)
 {
   out << r.getTextFragment();
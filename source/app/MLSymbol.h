@@ -24,12 +24,21 @@
 // Symbols must not ever require any heap as long as they are smaller than a
 // certain size. Currently this relies on the "small string optimization"
 // implementation of TextFragment. Currently the size is 16 bytes.
+//
+// Symbols can be made and read from any number of threads. Looking up a symbol
+// that already exists takes no locks. Adding a new symbol takes one mutex for
+// the whole table. The text of each symbol is stored in chunks that are never
+// moved once allocated, so a reference to the text stays valid as the table
+// grows.
 
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
@@ -38,58 +47,55 @@
 
 namespace ml
 {
-constexpr int kHashTableBits = 12;
-constexpr int kHashTableSize = (1 << kHashTableBits);
-constexpr int kHashTableMask = kHashTableSize - 1;
+// the hash index of the symbol table starts with this many slots, and doubles
+// in size whenever it becomes half full.
+constexpr int kInitialSymbolHashBits = 12;
 
-// initial capacity of symbol table. if this number of symbols is exceeded, the
-// capacity of the table will have to be increased, which may result in a glitch
-// if called from the audio thread.
+// the symbol table stores its text in chunks of this many symbols. When a
+// chunk is filled, adding the next symbol allocates a new one, which may result
+// in a glitch if called from the audio thread.
 // TODO these constants that tune different parts of madronalib for space use
 // etc. should all be in one header.
-constexpr int kDefaultSymbolTableSize = 4096;
-
-// very simple hash function from Kernighan & Ritchie.
-// Constexpr version for hashing strings known at compile time.
-template <size_t N>
-constexpr uint32_t krHash2(const char* str)
-{
-  return (N > 1) ? ((krHash2<N - 1>(str + 1)) + *str) * 31u : 0;
-}
+constexpr int kSymbolChunkBits = 10;
+constexpr size_t kSymbolChunkSize = (1 << kSymbolChunkBits);
+constexpr size_t kSymbolChunkMask = kSymbolChunkSize - 1;
 
-template <>
-constexpr uint32_t krHash2<size_t(0)>(const char* str)
-{
-  return 0;
-}
+// the maximum number of chunks, which limits the table to 16M symbols.
+constexpr size_t kMaxSymbolChunks = 1 << 14;
+constexpr size_t kMaxSymbols = kMaxSymbolChunks * kSymbolChunkSize;
 
-template <size_t N>
-constexpr uint32_t krHash1(const char* str)
+// the final mixing step of MurmurHash3, which makes each bit of the result
+// depend on every bit of the input.
+constexpr uint32_t mixHash(uint32_t h)
 {
-  return krHash2<N>(str) & kHashTableMask;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
 }
 
-// non-recursive hash producing equivalent results to krHash1.
-// Non-constexpr version for hashing strings known only at runtime.
-inline uint32_t krHash0(const char* str, const size_t len)
+// 32-bit FNV-1a hash, followed by mixHash() so that the low bits used to index
+// the table depend on every byte of the input. constexpr so that strings known
+// at compile time can be hashed then.
+constexpr uint32_t symbolHash(const char* str, const size_t len)
 {
-  size_t i = len;
-  uint32_t accum = 0;
-  while (i > 0)
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i)
   {
-    i--;
-    accum += str[i];
-    accum *= 31u;
+    h ^= static_cast<uint8_t>(str[i]);
+    h *= 16777619u;
   }
-  return accum & kHashTableMask;
+  return mixHash(h);
 }
 
-inline uint32_t krHash0(const char* str) { return krHash0(str, strlen(str)); }
+inline uint32_t symbolHash(const char* str) { return symbolHash(str, strlen(str)); }
 
 template <size_t N>
 constexpr uint32_t hash(const char (&sym)[N])
 {
-  return krHash1<N>(sym);
+  return symbolHash(sym, N - 1);
 }
 
 class HashedCharArray
@@ -98,16 +104,17 @@ class HashedCharArray
   // template ctor from string literals allows hashing for code like
   // Proc::setParam("foo") to be done at compile time.
   template <size_t N>
-  constexpr HashedCharArray(const char (&sym)[N]) : len(N), hash(krHash1<N>(sym)), pChars(sym)
+  constexpr HashedCharArray(const char (&sym)[N])
+      : len(N - 1), hash(symbolHash(sym, N - 1)), pChars(sym)
   {
   }
 
   // this non-constexpr ctor counts the string length at runtime.
-  HashedCharArray(const char* pC) : len(strlen(pC)), hash(krHash0(pC, len)), pChars(pC) {}
+  HashedCharArray(const char* pC) : len(strlen(pC)), hash(symbolHash(pC, len)), pChars(pC) {}
 
   // this non-constexpr ctor takes a string length parameter at runtime.
   HashedCharArray(const char* pC, size_t lengthBytes)
-      : len(lengthBytes), hash(krHash0(pC, len)), pChars(pC)
+      : len(lengthBytes), hash(symbolHash(pC, len)), pChars(pC)
   {
   }
 
@@ -119,53 +126,283 @@ class HashedCharArray
   const char* pChars;
 };
 
-using SymbolID = size_t;
+// 32-bit IDs keep Symbols, and the Paths made of them, compact. The table's
+// chunks limit it to fewer symbols than that.
+using SymbolID = uint32_t;
+
+// HashIndex: an open-addressed hash index from 32-bit hashes to nonzero 32-bit
+// IDs, probed linearly. Each slot holds a hash in its upper 32 bits and an ID
+// in its lower 32 bits, or 0 if it is empty. The slots are atomic, so that any
+// number of readers can search the index without locks while one writer at a
+// time inserts. An index does not grow by itself: the writer replaces a full
+// one with the result of grow().
+
+class HashIndex
+{
+ public:
+  explicit HashIndex(size_t size);
+
+  size_t size() const { return mMask + 1; }
+
+  // return the first ID with the given hash for which matches(id) is true, or
+  // 0 if there is none.
+  template <typename F>
+  inline uint32_t find(uint32_t hash, F&& matches) const
+  {
+    for (size_t i = hash & mMask;; i = (i + 1) & mMask)
+    {
+      uint64_t slot = mSlots[i].load(std::memory_order_acquire);
+      if (!slot) return 0;
+      if ((slotHash(slot) == hash) && matches(slotID(slot))) return slotID(slot);
+    }
+  }
+
+  // add the ID with the given hash, publishing it to readers. Anything the ID
+  // refers to must be written first.
+  void insert(uint32_t hash, uint32_t id);
+
+  // return an index of twice the size with the same contents.
+  std::unique_ptr<HashIndex> grow() const;
+
+  uint64_t getSlot(size_t i) const { return mSlots[i].load(std::memory_order_acquire); }
+  void setSlot(size_t i, uint64_t slot) { mSlots[i].store(slot, std::memory_order_release); }
+
+  static inline uint64_t makeSlot(uint32_t hash, uint32_t id)
+  {
+    return (static_cast<uint64_t>(hash) << 32) | id;
+  }
+  static inline uint32_t slotHash(uint64_t slot) { return static_cast<uint32_t>(slot >> 32); }
+  static inline uint32_t slotID(uint64_t slot) { return static_cast<uint32_t>(slot); }
+
+ private:
+  const size_t mMask;
+  std::unique_ptr<std::atomic<uint64_t>[]> mSlots;
+};
+
+// InternTable: the storage shared by SymbolTable and PathTable. Entries get
+// IDs in order of creation and are stored in chunks of 2^kChunkBits, which are
+// allocated as needed and never move. A HashIndex finds each entry's ID from
+// its hash. Any number of readers can find entries without locks while one
+// writer at a time adds them. ID 0 is a null entry that is not in the index.
+
+template <typename Entry, size_t kChunkBits, size_t kMaxChunks>
+class InternTable
+{
+ public:
+  static constexpr size_t kChunkSize = size_t(1) << kChunkBits;
+  static constexpr size_t kChunkMask = kChunkSize - 1;
+  static constexpr size_t kMaxEntries = kMaxChunks * kChunkSize;
+
+  explicit InternTable(size_t initialIndexSize) : mInitialIndexSize(initialIndexSize) { clear(); }
+  ~InternTable() { freeChunks(); }
+
+  // remove all entries and return the new null entry. Not thread-safe.
+  Entry& clear()
+  {
+    freeChunks();
+    mIndexes.clear();
+    mIndexes.emplace_back(std::make_unique<HashIndex>(mInitialIndexSize));
+    mIndex.store(mIndexes.back().get());
+    mSize.store(1);
+    return allocateEntry(0);
+  }
+
+  // the number of entries, including the null entry.
+  size_t size() const { return mSize.load(std::memory_order_acquire); }
+
+  inline Entry& getEntry(uint32_t id)
+  {
+    Entry* chunk = mChunks[id >> kChunkBits].load(std::memory_order_acquire);
+    return chunk[id & kChunkMask];
+  }
+
+  // return the ID of the first entry with the given hash for which
+  // matches(entry) is true, or 0 if there is none. Takes no locks.
+  template <typename F>
+  inline uint32_t find(uint32_t hash, F&& matches)
+  {
+    const HashIndex* index = mIndex.load(std::memory_order_acquire);
+    return index->find(hash, [&](uint32_t id) { return matches(getEntry(id)); });
+  }
+
+  // add an entry with the given hash, unless another thread has added one
+  // that matches since we looked, and return its ID. write(entry) fills in
+  // the new entry before its ID is published to readers. Returns 0 if the
+  // table is full.
+  template <typename F, typename W>
+  uint32_t add(uint32_t hash, F&& matches, W&& write)
+  {
+    std::unique_lock<std::mutex> lock(mAddMutex);
+    uint32_t id = find(hash, matches);
+    if (id) return id;
+
+    // the table is full.
+    id = static_cast<uint32_t>(mSize.load(std::memory_order_relaxed));
+    if (id >= kMaxEntries) return 0;
+
+    // keep the index at most half full. A reader may still be probing an
+    // index after it has been replaced, so the replaced ones are kept until
+    // the table is cleared. Their total size is less than that of the current one.
+    if (id * 2 > mIndex.load(std::memory_order_relaxed)->size())
+    {
+      setIndex(mIndex.load(std::memory_order_relaxed)->grow());
+    }
+
+    // write the new entry before publishing its ID to readers.
+    write(allocateEntry(id));
+    mIndex.load(std::memory_order_relaxed)->insert(hash, id);
+    mSize.store(id + 1, std::memory_order_release);
+    return id;
+  }
+
+  // lock out add() while reading the whole index.
+  std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(mAddMutex); }
+  const HashIndex& getIndex() const { return *mIndex.load(std::memory_order_acquire); }
+
+  // restore a table saved elsewhere: after clear(), write each entry with
+  // allocateEntry(), then publish them all with restore(). Not thread-safe.
+  Entry& allocateEntry(uint32_t id)
+  {
+    size_t chunkIdx = id >> kChunkBits;
+    if (!mChunks[chunkIdx].load(std::memory_order_relaxed))
+    {
+      mChunks[chunkIdx].store(new Entry[kChunkSize], std::memory_order_release);
+    }
+    return getEntry(id);
+  }
+
+  void restore(std::unique_ptr<HashIndex> index, size_t size)
+  {
+    setIndex(std::move(index));
+    mSize.store(size, std::memory_order_release);
+  }
+
+ private:
+  void setIndex(std::unique_ptr<HashIndex> index)
+  {
+    mIndex.store(index.get(), std::memory_order_release);
+    mIndexes.emplace_back(std::move(index));
+  }
+
+  void freeChunks()
+  {
+    // chunks are allocated in order, so stop at the first empty one.
+    for (auto& chunk : mChunks)
+    {
+      Entry* pEntries = chunk.load(std::memory_order_relaxed);
+      if (!pEntries) break;
+      delete[] pEntries;
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  const size_t mInitialIndexSize;
+
+  // chunks of entries in ID/creation order.
+  std::array<std::atomic<Entry*>, kMaxChunks> mChunks{};
+
+  // the current hash index, and all the ones made since the table was cleared.
+  std::atomic<HashIndex*> mIndex{nullptr};
+  std::vector<std::unique_ptr<HashIndex>> mIndexes;
+
+  std::atomic<size_t> mSize{0};
+  std::mutex mAddMutex;
+};
 
 class SymbolTable
 {
   friend class Symbol;
 
  public:
+  // statistics of the hash index, for tuning and testing.
+  struct Stats
+  {
+    // the number of symbols, including the null symbol.
+    size_t symbols;
+
+    // the number of slots in the hash index.
+    size_t slots;
+
+    // the number of symbols not found in the first slot probed for them.
+    size_t collisions;
+
+    // the number of symbols with the same 32-bit hash as some other symbol.
+    size_t hashCollisions;
+
+    // the number of slots probed to find a symbol: the mean and the maximum.
+    float meanProbeLength;
+    size_t maxProbeLength;
+  };
+
   SymbolTable();
   ~SymbolTable();
+
+  // clear all symbols from the table, and any tables that depend on them.
+  // Not thread-safe: no other thread may use the tables during the call, and
+  // any existing Symbols become invalid.
   void clear();
-  size_t getSize() { return mSymbolTextsByID.size(); }
+  size_t getSize() { return mEntries.size(); }
+
+  // a table that stores Symbols, like the PathTable, adds a function to clear
+  // it here, so that it is cleared whenever the symbols are. The owner
+  // pointer identifies the function for removeDependentTable().
+  void addDependentTable(const void* owner, std::function<void()> clearFn);
+  void removeDependentTable(const void* owner);
+  Stats getStats();
   void dump(void);
   int audit(void);
 
+  // return a binary image of the symbols in the table and their hash index.
+  // loadImage() can restore the same IDs from the image without hashing or
+  // allocating memory for each symbol.
+  std::vector<uint8_t> getImage();
+
+  // write the image to the file at path. Returns true on success.
+  bool saveImage(const char* path);
+
+  // clear the table and restore the symbols from an image made by getImage()
+  // on a machine with the same byte order. Not thread-safe, like clear(). If
+  // the image is not valid, returns false and leaves the table cleared.
+  bool loadImage(const uint8_t* pData, size_t size);
+
+  // map the file at path into memory and load the image in it.
+  bool loadImage(const char* path);
+
  protected:
   // look up a symbol by name and return its ID. Used in Symbol constructors.
   // if the symbol already exists, this routine must not allocate any heap
-  // memory.
+  // memory or take any locks.
   SymbolID getSymbolID(const HashedCharArray& hsl);
   SymbolID getSymbolID(const char* sym);
   SymbolID getSymbolID(const char* sym, size_t lengthBytes);
 
   const TextFragment& getSymbolTextByID(SymbolID symID);
-  SymbolID addEntry(const HashedCharArray& hsl);
+  uint32_t getSymbolHashByID(SymbolID symID) { return mEntries.getEntry(symID).hash; }
 
  private:
-  // vector of text fragments in ID/creation order
-  std::vector<TextFragment> mSymbolTextsByID;
-
-  // hash table containing indexes to strings for a given hash value.
-  struct TableEntry
+  // the text of one symbol and its hash. Entries are not changed once they
+  // have been added to the hash index.
+  struct Entry
   {
-    std::mutex mMutex;
-    std::vector<SymbolID> mIDVector;
+    TextFragment text;
+    uint32_t hash{0};
   };
 
-  void clearEntry(TableEntry& entry)
-  {
-    std::unique_lock<std::mutex> lock(entry.mMutex);
-    entry.mIDVector.clear();
-  }
+  static bool hasText(const Entry& entry, const HashedCharArray& hsl);
 
-  // since the maximum hash value is known, there will be no need to resize this
-  // array.
-  std::array<TableEntry, kHashTableSize> mHashTable;
+  // return the ID of the symbol, or 0 if it is not in the table.
+  SymbolID findEntry(const HashedCharArray& hsl);
 
-  size_t mSize{0};
+  // add the symbol to the table, if no other thread has added it first, and
+  // return its ID, or 0 if the table is full. This must be the only way of
+  // modifying the symbol table.
+  SymbolID addEntry(const HashedCharArray& hsl);
+
+  // the entries in ID/creation order, and their hash index.
+  InternTable<Entry, kSymbolChunkBits, kMaxSymbolChunks> mEntries{1 << kInitialSymbolHashBits};
+
+  // functions to clear the tables that depend on this one.
+  std::vector<std::pair<const void*, std::function<void()>>> mDependentTables;
 };
 
 inline SymbolTable& theSymbolTable()
@@ -180,7 +417,8 @@ inline SymbolTable& theSymbolTable()
 class Symbol
 {
   // the ID equals the order in which the symbol was created.
-  // 2^31 unique symbols are possible. There is no checking for overflow.
+  // kMaxSymbols unique symbols are possible. Once the table is full, making
+  // a new symbol returns the null symbol.
   SymbolID id;
 
   friend std::ostream& operator<<(std::ostream& out, const Symbol r);
@@ -202,33 +440,25 @@ class Symbol
 
   explicit operator bool() const { return id != 0; }
 
-  friend uint32_t hash(Symbol s);
-
   // search hash table for our id to find our hash.
   // for testing only!
   inline int getHashFromTable() const
   {
-    int hash = 0;
-
-    for (auto& entry : theSymbolTable().mHashTable)
+    auto& index = theSymbolTable().mEntries.getIndex();
+    for (size_t i = 0; i < index.size(); ++i)
     {
-      auto idVec = entry.mIDVector;
-      size_t idVecLen = idVec.size();
-      if (idVecLen > 0)
+      uint64_t slot = index.getSlot(i);
+      if (slot && (HashIndex::slotID(slot) == id))
       {
-        for (auto vid : idVec)
-        {
-          if (vid == id)
-          {
-            return hash;
-          }
-        }
+        return HashIndex::slotHash(slot);
       }
-      hash++;
     }
     return 0;
   }
 
+  // the hash of the symbol's text, as made by symbolHash().
+  inline uint32_t getHash() const { return theSymbolTable().getSymbolHashByID(id); }
+
   // return the symbol's TextFragment in the table.
   // in order to show the strings in XCode's debugger, instead of the unhelpful
   // id, edit the summary format for Symbol within XCode to
@@ -253,7 +483,7 @@ class Symbol
   inline std::string toString() const { return std::string(getUTF8Ptr()); }
 };
 
-inline uint32_t hash(Symbol f) { return krHash0(f.getUTF8Ptr()); }
+inline uint32_t hash(Symbol f) { return f.getHash(); }
 
 inline Symbol operator+(Symbol f1, Symbol f2)
 {